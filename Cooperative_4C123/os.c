@@ -99,11 +99,21 @@ int OS_AddThreads(void(*task0)(void),
 void OS_Launch(uint32_t theTimeSlice){
   STCTRL = 0;                  // disable SysTick during setup
   STCURRENT = 0;               // any write to current clears it
-  SYSPRI3 =(SYSPRI3&0x00FFFFFF)|0xE0000000; // priority 7
+  SYSPRI3 =(SYSPRI3&0x0000FFFF)|0xE0E00000; // priority 7, SysTick and PendSV
   STRELOAD = theTimeSlice - 1; // reload value
   STCTRL = 0x00000007;         // enable, core clock and interrupt arm
   StartOS();                   // start on the first task
 }
+
+//******** SysTick_Handler ***************
+// Time slice interrupt, only requests a thread switch
+// The switch itself runs in PendSV_Handler (osasm.s) at the lowest
+// priority, after every other pending interrupt has finished
+// Inputs: none
+// Outputs: none
+void SysTick_Handler(void){
+  INTCTRL = 0x10000000; // trigger PendSV
+}
 void Scheduler(void){
   RunPt = RunPt->next;    // Round Robin
 }
@@ -113,6 +123,6 @@ void Scheduler(void){
 // Inputs: none
 // Outputs: none
 void OS_Suspend(void){
-  INTCTRL = 0x04000000; // trigger SysTick
+  INTCTRL = 0x10000000; // trigger PendSV
 }
 
@@ -0,0 +1,332 @@
+// BSP.c
+// Linux host version of the board support package functions used by
+// the Lab3 and Lab4 kernels and lab mains
+// Timers run off the simulated clock in CortexM.c. Sensors return
+// repeatable waveforms of simulated time, outputs are discarded.
+
+#include <stdint.h>
+#include "BSP.h"
+#include "CortexM.h"
+#include "Host.h"
+
+#define SENSORTIME 100000     // us for a light or temperature conversion
+#define ADCTIME    8          // us per ADC conversion, at 125K samples/sec
+
+// registers declared in the host tm4c123gh6pm.h
+volatile uint32_t HostGPIOD[13] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF};
+volatile uint32_t HostSYSCTL[2] = {0, 0x3F}; // all GPIO ports ready
+volatile uint32_t HostNVIC[2];
+
+// ------------tri------------
+// Triangle wave of simulated time
+// Input: time in us, period in us, amplitude
+// Output: -amplitude to +amplitude
+int32_t static tri(uint64_t time, uint32_t period, int32_t amplitude){
+  int32_t phase = (int32_t)(time%period);
+  int32_t half = period/2;
+  if(phase > half){
+    phase = period - phase;
+  }
+  return (int32_t)(((int64_t)(2*phase - half)*amplitude)/half);
+}
+
+void BSP_Clock_InitFastest(void){
+}
+
+uint32_t BSP_Clock_GetFreq(void){
+  return HOST_CLOCK;
+}
+
+void BSP_Delay1ms(uint32_t n){
+  Clock_Delay1ms(n);
+}
+
+void BSP_PeriodicTask_Init(void(*task)(void), uint32_t freq, uint8_t priority){
+  Host_TimerStart(HOST_TIMERA, task, 1000000/freq, 1000000/freq, priority);
+}
+
+void BSP_PeriodicTask_Stop(void){
+  Host_TimerStop(HOST_TIMERA);
+}
+
+void BSP_PeriodicTask_InitB(void(*task)(void), uint32_t freq, uint8_t priority){
+  Host_TimerStart(HOST_TIMERB, task, 1000000/freq, 1000000/freq, priority);
+}
+
+void BSP_PeriodicTask_StopB(void){
+  Host_TimerStop(HOST_TIMERB);
+}
+
+void BSP_PeriodicTask_InitC(void(*task)(void), uint32_t freq, uint8_t priority){
+  Host_TimerStart(HOST_TIMERC, task, 1000000/freq, 1000000/freq, priority);
+}
+
+void BSP_PeriodicTask_StopC(void){
+  Host_TimerStop(HOST_TIMERC);
+}
+
+void (*OneShotTask)(void);
+uint8_t OneShotPriority;
+void BSP_OneShotTask_Init(void(*task)(void), uint8_t priority){
+  OneShotTask = task;
+  OneShotPriority = priority;
+}
+
+void BSP_OneShotTask_Start(uint32_t us){
+  Host_TimerStart(HOST_ONESHOT, OneShotTask, us, 0, OneShotPriority);
+}
+
+void BSP_OneShotTask_Stop(void){
+  Host_TimerStop(HOST_ONESHOT);
+}
+
+void BSP_Time_Init(void){
+}
+
+uint32_t BSP_Time_Get(void){
+  return (uint32_t)HostTime;
+}
+
+// The _Input functions spin for the time of their conversions, and
+// the _Start functions arm a one-shot timer that ends them, which
+// runs the BSP_ADC_Notify task. AdcReady[n] is when the conversion
+// of sample sequencer n is done, 0 if none is in progress.
+void (*AdcTask)(uint32_t done);
+uint8_t AdcPriority;
+uint64_t AdcReady[4];
+
+void BSP_ADC_Notify(void(*task)(uint32_t done), uint8_t priority){
+  AdcTask = task;
+  AdcPriority = priority;
+}
+
+void static adcdone2(void){
+  (*AdcTask)(BSP_ADC_ACCELEROMETER);
+}
+
+void static adcdone3(void){
+  (*AdcTask)(BSP_ADC_MICROPHONE);
+}
+
+void static adcstart(int ss, uint32_t conversions, int timer, void(*done)(void)){
+  if(AdcReady[ss]){
+    return;
+  }
+  AdcReady[ss] = HostTime + conversions*ADCTIME;
+  if(AdcTask){
+    Host_TimerStart(timer, done, conversions*ADCTIME, 0, AdcPriority);
+  }
+}
+
+int static adcready(int ss, uint32_t conversions, int timer, void(*done)(void)){
+  if(AdcReady[ss] == 0){
+    adcstart(ss, conversions, timer, done);
+    return 0;
+  }
+  if(HostTime < AdcReady[ss]){
+    return 0;
+  }
+  AdcReady[ss] = 0;
+  return 1;
+}
+
+// a walk at two steps per second, mostly along Z
+void BSP_Accelerometer_Init(void){
+}
+
+void static accelerometer(uint16_t *x, uint16_t *y, uint16_t *z){
+  *x = 512 + tri(HostTime, 500000, 20);
+  *y = 512 - tri(HostTime, 1000000, 20);
+  *z = 700 + tri(HostTime, 500000, 150);
+}
+
+void BSP_Accelerometer_Input(uint16_t *x, uint16_t *y, uint16_t *z){
+  Host_Consume(3*ADCTIME);
+  accelerometer(x, y, z);
+}
+
+void BSP_Accelerometer_Start(void){
+  adcstart(2, 3, HOST_ADC2, adcdone2);
+}
+
+int BSP_Accelerometer_End(uint16_t *x, uint16_t *y, uint16_t *z){
+  if(adcready(2, 3, HOST_ADC2, adcdone2) == 0){
+    return 0;
+  }
+  accelerometer(x, y, z);
+  return 1;
+}
+
+// a 1 kHz tone whose loudness rises and falls every 4 seconds
+void BSP_Microphone_Init(void){
+}
+
+uint16_t static microphone(uint64_t time){
+  return 512 + (tri(time, 1000, 100)*(tri(time, 4000000, 200) + 300))/500;
+}
+
+void BSP_Microphone_Input(uint16_t *mic){
+  Host_Consume(ADCTIME);
+  *mic = microphone(HostTime);
+}
+
+void BSP_Microphone_Start(void){
+  adcstart(3, 1, HOST_ADC3, adcdone3);
+}
+
+int BSP_Microphone_End(uint16_t *mic){
+  if(adcready(3, 1, HOST_ADC3, adcdone3) == 0){
+    return 0;
+  }
+  *mic = microphone(HostTime);
+  return 1;
+}
+
+// the stream fills a whole block per interrupt, each sample taken at
+// its own time in the block as the timer-triggered ADC would
+void (*MicrophoneTask)(uint16_t *block, uint32_t count);
+uint16_t *MicrophoneBuffer;
+uint32_t MicrophoneCount, MicrophoneFreq, MicrophoneNext;
+void static microphoneblock(void){
+  uint16_t *block = &MicrophoneBuffer[MicrophoneCount*MicrophoneNext];
+  uint64_t start = HostTime - (uint64_t)MicrophoneCount*1000000/MicrophoneFreq;
+  uint32_t i;
+  for(i=0; i<MicrophoneCount; i++){
+    block[i] = microphone(start + (uint64_t)i*1000000/MicrophoneFreq);
+  }
+  MicrophoneNext ^= 1;
+  (*MicrophoneTask)(block, MicrophoneCount);
+}
+
+void BSP_Microphone_StartStream(void(*task)(uint16_t *block, uint32_t count),
+  uint16_t *buffer, uint32_t count, uint32_t freq, uint8_t priority){
+  uint32_t period;
+  if((count == 0) || (count > 1024) || (freq == 0) || (freq > 125000)){
+    return;
+  }
+  MicrophoneTask = task;
+  MicrophoneBuffer = buffer;
+  MicrophoneCount = count;
+  MicrophoneFreq = freq;
+  MicrophoneNext = 0;
+  period = (uint32_t)((uint64_t)count*1000000/freq);
+  Host_TimerStart(HOST_MICROPHONE, microphoneblock, period, period, priority);
+}
+
+void BSP_Microphone_StopStream(void){
+  Host_TimerStop(HOST_MICROPHONE);
+}
+
+void BSP_Button1_Init(void){
+}
+
+uint8_t BSP_Button1_Input(void){
+  return 1;                   // never pressed
+}
+
+void BSP_Button2_Init(void){
+}
+
+uint8_t BSP_Button2_Input(void){
+  return 1;                   // never pressed
+}
+
+void BSP_Buzzer_Init(uint16_t duty){
+}
+
+void BSP_Buzzer_Set(uint16_t duty){
+}
+
+void BSP_RGB_Init(uint16_t red, uint16_t green, uint16_t blue){
+}
+
+void BSP_RGB_Set(uint16_t red, uint16_t green, uint16_t blue){
+}
+
+uint64_t LightStart;
+int LightBusy;
+void BSP_LightSensor_Init(void){
+}
+
+void BSP_LightSensor_Start(void){
+  LightStart = HostTime;
+  LightBusy = 1;
+}
+
+int BSP_LightSensor_End(uint32_t *light){
+  if(LightBusy == 0){
+    BSP_LightSensor_Start();
+    return 0;
+  }
+  if(HostTime - LightStart < SENSORTIME){
+    return 0;
+  }
+  LightBusy = 0;
+  *light = 30000 + 100*tri(HostTime, 10000000, 50); // 100*lux
+  return 1;
+}
+
+uint64_t TempStart;
+int TempBusy;
+void BSP_TempSensor_Init(void){
+}
+
+void BSP_TempSensor_Start(void){
+  TempStart = HostTime;
+  TempBusy = 1;
+}
+
+int BSP_TempSensor_End(int32_t *sensorV, int32_t *localT){
+  if(TempBusy == 0){
+    BSP_TempSensor_Start();
+    return 0;
+  }
+  if(HostTime - TempStart < SENSORTIME){
+    return 0;
+  }
+  TempBusy = 0;
+  *sensorV = -2000;           // 100*nV
+  *localT = 2500000 + 1000*tri(HostTime, 20000000, 100); // 100,000*C
+  return 1;
+}
+
+uint16_t BSP_LCD_Color565(uint8_t r, uint8_t g, uint8_t b){
+  return ((b&0xF8)<<8)|((g&0xFC)<<3)|((r&0xF8)>>3);
+}
+
+void BSP_LCD_Init(void){
+}
+
+void BSP_LCD_FillScreen(uint16_t color){
+}
+
+void BSP_LCD_DrawBitmap(int16_t x, int16_t y, const uint16_t *image, int16_t w, int16_t h){
+}
+
+uint32_t BSP_LCD_DrawString(uint16_t x, uint16_t y, char *pt, int16_t textColor){
+  uint32_t count = 0;
+  while(pt[count]){
+    count++;
+  }
+  return count;
+}
+
+void BSP_LCD_Drawaxes(uint16_t axisColor, uint16_t bgColor, char *xLabel,
+  char *yLabel1, uint16_t label1Color, char *yLabel2, uint16_t label2Color,
+  int32_t ymax, int32_t ymin){
+}
+
+void BSP_LCD_PlotPoint(int32_t data1, uint16_t color1){
+}
+
+void BSP_LCD_PlotIncrement(void){
+}
+
+void BSP_LCD_SetCursor(uint32_t newX, uint32_t newY){
+}
+
+void BSP_LCD_OutUDec4(uint32_t n, int16_t textColor){
+}
+
+void BSP_LCD_OutUFix2_1(uint32_t n, int16_t textColor){
+}
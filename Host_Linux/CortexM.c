@@ -0,0 +1,472 @@
+// CortexM.c
+// Simulated Cortex M core for the Linux host port: PRIMASK, SysTick,
+// the BSP timers and PendSV, with nested interrupts, all driven from
+// one simulated clock that counts bus cycles
+// This file and osasm.c are the only ones of the host port compiled
+// without -fsanitize-coverage=trace-pc -finstrument-functions, see Host.h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "CortexM.h"
+#include "Host.h"
+
+void SysTick_Handler(void);    // in os.c
+void Scheduler(void);          // in os.c
+
+volatile uint32_t HostSTCTRL;
+volatile uint32_t HostSTRELOAD;
+volatile uint32_t HostSTCURRENT;
+volatile uint32_t HostINTCTRL;
+volatile uint32_t HostSYSPRI[3];
+volatile uint32_t HostSYSHNDCTRL;
+
+uint64_t HostCycle;            // simulated time in bus cycles
+uint64_t HostTime;             // HostCycle in us
+uint64_t HostCheck;            // HostCycle at which to look for due interrupts again
+uint32_t HostPrimask = 1;      // interrupts are disabled out of reset
+uint32_t HostLevel = HOST_THREAD; // priority of the code running
+uint32_t HostStarted;          // nonzero once StartOS runs the first thread
+uint32_t HostReporting;        // nonzero while Host_Report runs
+uint32_t HostTaskCount[7];
+
+#define PENDSVSET 0x10000000   // INTCTRL bits
+#define PENDSTSET 0x04000000
+#define STCURRENT_UNTOUCHED 0x01000000 // not a 24-bit count, any write changes it
+uint32_t HostSysTickOn;        // SysTick counting when last checked
+uint64_t HostSysTickNext;      // cycle of the next SysTick interrupt
+
+struct hosttimer{
+  void (*task)(void);
+  uint64_t next;               // cycle of the next interrupt
+  uint64_t period;             // cycles, 0 means one shot
+  uint8_t priority;
+  uint8_t armed;
+};
+struct hosttimer HostTimer[HOST_NUMTIMERS];
+
+// CPU time of each source of interrupts, not counting the interrupts
+// nested in it. NestedCycles adds up the whole time of every ISR that
+// returns, so the one it interrupted can take it out of its own.
+#define SYSTICK (HOST_NUMTIMERS)
+#define PENDSV  (HOST_NUMTIMERS+1)
+struct hostisr{
+  uint32_t runs;
+  uint64_t cycles;
+  uint64_t max;
+};
+struct hostisr HostIsr[HOST_NUMTIMERS+2];
+const char * const IsrName[HOST_NUMTIMERS+2] = {
+  "BSP_PeriodicTask", "BSP_PeriodicTaskB", "BSP_PeriodicTaskC",
+  "BSP_OneShotTask", "microphone stream", "ADC SS2 done", "ADC SS3 done",
+  "SysTick", "PendSV"
+};
+uint64_t NestedCycles;
+uint64_t IdleCycles;           // slept in WaitForInterrupt
+uint64_t MaskStart;            // HostCycle when PRIMASK was last set
+
+// Distributions are kept as histograms, one bin per cycle or us, so
+// the percentiles are of the whole run and the maximum is exact
+#define HOST_BINS 65536
+struct histogram{
+  uint32_t bin[HOST_BINS];     // the last one counts everything larger
+  uint64_t count;
+  uint64_t max;
+};
+struct histogram Latency;      // cycles from an interrupt being due to its first instruction
+struct histogram Masked;       // cycles with interrupts disabled, once threads run
+struct histogram RunLength;    // us a thread ran before being switched out
+uint32_t SwitchCount;
+uint32_t PendSVCount;
+uint64_t LastSwitch;
+
+#define MAXCHECKS 8
+int (*Checks[MAXCHECKS])(void);
+uint32_t NumChecks;
+
+void static record(struct histogram *h, uint64_t value){
+  h->bin[(value < HOST_BINS) ? value : HOST_BINS-1]++;
+  h->count++;
+  if(value > h->max){
+    h->max = value;
+  }
+}
+
+// ******** systicksync ************
+// Follow what the kernel wrote to the SysTick registers since last time
+// A write to STCURRENT or enabling the counter starts a full period
+// Inputs:  none
+// Outputs: none
+void static systicksync(void){
+  uint64_t period = (uint64_t)(HostSTRELOAD&0x00FFFFFF)+1;
+  if((HostSTCTRL&0x01) == 0){
+    HostSysTickOn = 0;
+    return;
+  }
+  if((HostSysTickOn == 0)||(HostSTCURRENT != STCURRENT_UNTOUCHED)){
+    HostSysTickNext = HostCycle + period;
+    HostSTCURRENT = STCURRENT_UNTOUCHED;
+    HostSysTickOn = 1;
+  }
+  while(HostSysTickNext + period <= HostCycle){
+    HostSysTickNext += period; // a masked SysTick only pends once
+  }
+}
+
+// ******** nextevent ************
+// Cycle of the earliest armed interrupt more urgent than a priority,
+// SysTick included
+// Inputs:  level, only interrupts of priority below this count
+// Outputs: cycle, UINT64_MAX if none is armed
+uint64_t static nextevent(uint32_t level){
+  uint64_t next = UINT64_MAX;
+  int i;
+  systicksync();
+  if(HostSysTickOn && (HostSTCTRL&0x02) && ((HostSYSPRI[2]>>29) < level)){
+    next = HostSysTickNext;
+  }
+  for(i=0; i<HOST_NUMTIMERS; i++){
+    if(HostTimer[i].armed && (HostTimer[i].priority < level) && (HostTimer[i].next < next)){
+      next = HostTimer[i].next;
+    }
+  }
+  return next;
+}
+
+// ******** recheck ************
+// Set when the basic blocks next need to look for interrupts: at the
+// next us, to keep HostTime current, or earlier if one is due first
+// Inputs:  none
+// Outputs: none
+void static recheck(void){
+  uint64_t next;
+  HostCheck = (HostTime + 1)*HOST_CYCLESPERUS;
+  if(HostPrimask == 0){
+    next = nextevent(HostLevel);
+    if(next < HostCheck){
+      HostCheck = next;
+    }
+  }
+}
+
+void static settime(uint64_t cycle){
+  HostCycle = cycle;
+  HostTime = cycle/HOST_CYCLESPERUS;
+  if((HostTime >= HOST_RUNTIME)&&(HostReporting == 0)){
+    Host_Report();
+  }
+}
+
+void static service(void);
+
+// ******** run ************
+// Use cycles of CPU time in the code running, taking the interrupts
+// that come due on the way
+// Inputs:  cycles
+// Outputs: none
+void static run(uint64_t cycles){
+  uint64_t next, step;
+  while(cycles){
+    next = HostPrimask ? UINT64_MAX : nextevent(HostLevel);
+    step = cycles;
+    if(next < HostCycle + cycles){
+      step = (next > HostCycle) ? next - HostCycle : 0;
+    }
+    settime(HostCycle + step);
+    cycles -= step;
+    service();
+  }
+}
+
+void static mask(void){
+  if(HostPrimask == 0){
+    MaskStart = HostCycle;
+  }
+  HostPrimask = 1;
+}
+
+void static unmask(void){
+  if(HostPrimask && HostStarted){
+    record(&Masked, HostCycle - MaskStart);
+  }
+  HostPrimask = 0;
+}
+
+// ******** account ************
+// Charge the time since start to one source of interrupts
+// Inputs:  source, timer number, SYSTICK or PENDSV
+//          start, HostCycle when it was taken
+//          nested, NestedCycles when it was taken
+// Outputs: none
+void static account(int source, uint64_t start, uint64_t nested){
+  uint64_t all = HostCycle - start;
+  uint64_t own = all - (NestedCycles - nested);
+  NestedCycles = nested + all;
+  HostIsr[source].runs++;
+  HostIsr[source].cycles += own;
+  if(own > HostIsr[source].max){
+    HostIsr[source].max = own;
+  }
+}
+
+// ******** interrupt ************
+// Run one ISR at its priority, so only more urgent ones nest in it
+// Inputs:  source, timer number or SYSTICK
+//          priority, 0 to 7
+//          due, cycle it was due, UINT64_MAX if pended by software
+//          task, the ISR
+// Outputs: none
+void static interrupt(int source, uint32_t priority, uint64_t due, void(*task)(void)){
+  uint32_t level = HostLevel;
+  uint64_t start = HostCycle, nested = NestedCycles;
+  HostLevel = priority;
+  run(HOST_ENTRYCYCLES);
+  if(due != UINT64_MAX){
+    record(&Latency, HostCycle - due);
+  }
+  task();
+  run(HOST_EXITCYCLES);
+  account(source, start, nested);
+  HostLevel = level;
+}
+
+// ******** pendsv ************
+// PendSV_Handler of osasm.s: with interrupts disabled, save the
+// thread, run the Scheduler and switch to the thread it picks, which
+// enables interrupts again
+// Inputs:  none
+// Outputs: none
+void static pendsv(void){
+  uint64_t start = HostCycle, nested = NestedCycles;
+  HostLevel = (HostSYSPRI[2]>>21)&0x07;
+  PendSVCount++;
+  run(HOST_ENTRYCYCLES);
+  mask();                      // CPSID I
+  run(HOST_SWITCHCYCLES);
+  Scheduler();
+  run(HOST_EXITCYCLES);
+  account(PENDSV, start, nested);
+  HostLevel = HOST_THREAD;
+  Host_PendSV();               // returns when this thread runs again
+  unmask();                    // CPSIE I, in the thread switched to
+}
+
+// ******** service ************
+// Take every interrupt that is due and more urgent than the code
+// running, highest priority first, then PendSV once back in a thread
+// Inputs:  none
+// Outputs: none
+void static service(void){
+  struct hosttimer *t;
+  uint32_t systickpri;
+  uint64_t due;
+  int i, systick;
+  while(HostPrimask == 0){
+    systicksync();
+    t = 0;
+    for(i=0; i<HOST_NUMTIMERS; i++){
+      if(HostTimer[i].armed && (HostTimer[i].next <= HostCycle) && (HostTimer[i].priority < HostLevel)){
+        if((t == 0)||(HostTimer[i].priority < t->priority)){
+          t = &HostTimer[i];
+        }
+      }
+    }
+    systickpri = HostSYSPRI[2]>>29;
+    systick = (systickpri < HostLevel) && ((HostINTCTRL&PENDSTSET) ||
+      (HostSysTickOn && (HostSTCTRL&0x02) && (HostSysTickNext <= HostCycle)));
+    if(systick && ((t == 0)||(systickpri <= t->priority))){
+      due = UINT64_MAX;
+      if((HostINTCTRL&PENDSTSET) == 0){
+        due = HostSysTickNext;
+        HostSysTickNext += (uint64_t)(HostSTRELOAD&0x00FFFFFF)+1;
+      }
+      HostINTCTRL &= ~PENDSTSET;
+      interrupt(SYSTICK, systickpri, due, SysTick_Handler);
+    } else if(t){
+      due = t->next;
+      if(t->period){
+        t->next += t->period;
+      } else{
+        t->armed = 0;
+      }
+      interrupt((int)(t - HostTimer), t->priority, due, t->task);
+    } else if((HostLevel == HOST_THREAD)&&(HostINTCTRL&PENDSVSET)){
+      HostINTCTRL &= ~PENDSVSET;
+      pendsv();
+    } else{
+      break;
+    }
+  }
+  recheck();
+}
+
+// Every basic block of the instrumented files calls this
+void __sanitizer_cov_trace_pc(void){
+  if(HostReporting){
+    return;
+  }
+  HostCycle += HOST_BLOCKCYCLES;
+  if(HostCycle >= HostCheck){
+    settime(HostCycle);
+    service();
+  } else if(HostINTCTRL&(PENDSVSET|PENDSTSET)){
+    service();                 // pended by the code just run
+  }
+}
+
+// Every function of the instrumented files calls these on entry and
+// return. A call does not end a basic block, so without them PendSV
+// pended by OS_Suspend would wait for the next branch in the caller,
+// which would run on as if it had been switched out and back already.
+void __cyg_profile_func_enter(void *function, void *site){
+}
+
+void __cyg_profile_func_exit(void *function, void *site){
+  if((HostReporting == 0)&&(HostINTCTRL&(PENDSVSET|PENDSTSET))){
+    service();
+  }
+}
+
+void Host_Consume(uint32_t us){
+  run((uint64_t)us*HOST_CYCLESPERUS);
+}
+
+uint64_t Host_Cycles(void){
+  return HostCycle;
+}
+
+uint64_t Host_MaxMasked(void){
+  return Masked.max;
+}
+
+void Host_TimerStart(int n, void(*task)(void), uint32_t first, uint32_t period, uint8_t priority){
+  HostTimer[n].task = task;
+  HostTimer[n].next = HostCycle + (uint64_t)first*HOST_CYCLESPERUS;
+  HostTimer[n].period = (uint64_t)period*HOST_CYCLESPERUS;
+  HostTimer[n].priority = priority;
+  HostTimer[n].armed = 1;
+  HostCheck = 0;               // look again at the next basic block
+}
+
+void Host_TimerStop(int n){
+  HostTimer[n].armed = 0;
+}
+
+// called by StartOS, before the first thread runs
+void Host_Start(void){
+  HostStarted = 1;
+  MaskStart = HostCycle;       // masked since reset, only StartOS onwards counts
+  LastSwitch = HostCycle;
+  SwitchCount++;
+}
+
+void Host_Switched(void){
+  record(&RunLength, (HostCycle - LastSwitch)/HOST_CYCLESPERUS);
+  SwitchCount++;
+  LastSwitch = HostCycle;
+}
+
+void Host_AtReport(int(*check)(void)){
+  if(NumChecks < MAXCHECKS){
+    Checks[NumChecks] = check;
+    NumChecks++;
+  }
+}
+
+uint64_t static percentile(struct histogram *h, uint32_t percent){
+  uint64_t want = (h->count*percent + 99)/100, sum = 0;
+  uint32_t i;
+  for(i=0; i<HOST_BINS-1; i++){
+    sum += h->bin[i];
+    if(sum >= want){
+      return i;
+    }
+  }
+  return h->max;
+}
+
+void static distribution(char *name, struct histogram *h, char *unit){
+  if(h->count == 0){
+    printf("%-20s no samples\n", name);
+    return;
+  }
+  printf("%-20s p50 %6llu  p90 %6llu  p99 %6llu  max %6llu %s\n", name,
+    (unsigned long long)percentile(h, 50), (unsigned long long)percentile(h, 90),
+    (unsigned long long)percentile(h, 99), (unsigned long long)h->max, unit);
+}
+
+void Host_Report(void){
+  double seconds = (double)HostCycle/HOST_CLOCK;
+  uint64_t isr = 0;
+  int i, failed = 0;
+  HostReporting = 1;
+  printf("simulated time      %.3f s\n", seconds);
+  printf("context switches    %u (%.0f/s), %u PendSV\n", SwitchCount, SwitchCount/seconds, PendSVCount);
+  for(i=0; i<7; i++){
+    if(HostTaskCount[i]){
+      printf("Task%d               %u runs (%.1f/s)\n", i, HostTaskCount[i], HostTaskCount[i]/seconds);
+    }
+  }
+  for(i=0; i<HOST_NUMTIMERS+2; i++){
+    isr += HostIsr[i].cycles;
+  }
+  printf("CPU use             threads %.2f%%  ISRs %.2f%%  idle %.2f%%\n",
+    100.0*(HostCycle - isr - IdleCycles)/HostCycle, 100.0*isr/HostCycle, 100.0*IdleCycles/HostCycle);
+  for(i=0; i<HOST_NUMTIMERS+2; i++){
+    if(HostIsr[i].runs){
+      printf("  %-18s %8u runs, %7.1f cycles average, %6llu most\n", IsrName[i], HostIsr[i].runs,
+        (double)HostIsr[i].cycles/HostIsr[i].runs, (unsigned long long)HostIsr[i].max);
+    }
+  }
+  distribution("interrupt latency", &Latency, "cycles");
+  distribution("interrupts masked", &Masked, "cycles");
+  distribution("thread run length", &RunLength, "us");
+  for(i=0; i<NumChecks; i++){
+    if(Checks[i]()){
+      failed = 1;
+    }
+  }
+  exit(failed);
+}
+
+void DisableInterrupts(void){
+  mask();
+}
+
+void EnableInterrupts(void){
+  unmask();
+  service();
+}
+
+long StartCritical(void){
+  long sr = HostPrimask;
+  mask();
+  return sr;
+}
+
+void EndCritical(long sr){
+  if(sr == 0){
+    unmask();
+    service();
+  }
+}
+
+void WaitForInterrupt(void){
+  uint64_t next = nextevent(HostLevel); // wakes even with PRIMASK set
+  if(next == UINT64_MAX){
+    printf("WaitForInterrupt with no interrupt armed\n");
+    Host_Report();
+  }
+  if(next > HostCycle){
+    IdleCycles += next - HostCycle;
+    settime(next);
+  }
+  service();
+}
+
+void Clock_Delay1ms(uint32_t n){
+  while(n){
+    Host_Consume(1000);
+    n--;
+  }
+}
@@ -0,0 +1,65 @@
+// CortexM.h
+// Cortex M registers used in these labs, Linux host version
+// The kernels include "CortexM.h" by name, so putting this directory
+// ahead of ../inc on the include path runs them against the simulated
+// SysTick and interrupt control registers in CortexM.c
+
+#include <stdint.h>
+
+extern volatile uint32_t HostSTCTRL;
+extern volatile uint32_t HostSTRELOAD;
+extern volatile uint32_t HostSTCURRENT;
+extern volatile uint32_t HostINTCTRL;
+extern volatile uint32_t HostSYSPRI[3];
+extern volatile uint32_t HostSYSHNDCTRL;
+
+#define STCTRL          HostSTCTRL
+#define STRELOAD        HostSTRELOAD
+#define STCURRENT       HostSTCURRENT
+#define INTCTRL         HostINTCTRL
+#define SYSPRI1         HostSYSPRI[0]
+#define SYSPRI2         HostSYSPRI[1]
+#define SYSPRI3         HostSYSPRI[2]
+#define SYSHNDCTRL      HostSYSHNDCTRL
+
+// armcc intrinsic used by the Lab4 scheduler
+#define __clz(x)        ((uint32_t)__builtin_clz(x))
+
+//******DisableInterrupts************
+// masks the simulated interrupts, like setting the I bit in PRIMASK
+// Inputs: none
+// Outputs: none
+void DisableInterrupts(void); // Disable interrupts
+
+//******EnableInterrupts************
+// unmasks the simulated interrupts and runs any that are pending
+// Inputs: none
+// Outputs: none
+void EnableInterrupts(void);  // Enable interrupts
+
+//******StartCritical************
+// StartCritical saves a copy of PRIMASK and disables interrupts
+// Code between StartCritical and EndCritical is run atomically
+// Inputs: none
+// Outputs: copy of the PRIMASK (I bit) before StartCritical called
+long StartCritical(void);
+
+//******EndCritical************
+// EndCritical sets PRIMASK with value passed in
+// Code between StartCritical and EndCritical is run atomically
+// Inputs: PRIMASK (I bit) before StartCritical called
+// Outputs: none
+void EndCritical(long sr);    // restore I bit to previous value
+
+//******WaitForInterrupt************
+// advances simulated time to the next timer event and runs it
+// returns after ISR has been run
+// Inputs: none
+// Outputs: none
+void WaitForInterrupt(void);
+
+// ------------Clock_Delay1ms------------
+// Consume n milliseconds of simulated CPU time.
+// Inputs: n, number of msec to wait
+// Outputs: none
+void Clock_Delay1ms(uint32_t n);
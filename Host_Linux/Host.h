@@ -0,0 +1,112 @@
+// Host.h
+// Simulated clock and interrupt controller of the Linux host port
+// Time only advances when the program runs, so a given binary always
+// produces the same interleaving and the same report.
+// The kernels, labs and BSP are compiled with
+// -fsanitize-coverage=trace-pc, so every basic block they run is
+// charged HOST_BLOCKCYCLES of the simulated clock. BSP_Delay1ms, the
+// ADC conversions and WaitForInterrupt consume time explicitly.
+// Interrupts are taken between basic blocks, as soon as they are due,
+// PRIMASK is clear and their priority is above that of the code
+// running, so they nest. With -finstrument-functions, one pended by
+// writing INTCTRL is also taken as the function that wrote it returns. Entry and exit of each exception cost
+// HOST_ENTRYCYCLES and HOST_EXITCYCLES, and a pended PendSV is taken
+// once no other interrupt is active or pending, with interrupts
+// disabled for HOST_SWITCHCYCLES plus the Scheduler, as in osasm.s.
+// The cycle counts are estimates for the TM4C123 at 0 wait states,
+// not measurements, so the report is good for comparing kernels and
+// finding the worst case, not for absolute times.
+
+#define HOST_CLOCK       80000000 // simulated bus clock in Hz
+#define HOST_CYCLESPERUS (HOST_CLOCK/1000000)
+#define HOST_BLOCKCYCLES 6        // cycles per basic block, about 4 instructions
+#define HOST_ENTRYCYCLES 12       // exception entry, stacking R0-R3,R12,LR,PC,PSR
+#define HOST_EXITCYCLES  12       // exception return, unstacking
+#define HOST_SWITCHCYCLES 40      // PendSV_Handler of osasm.s, not counting Scheduler
+#define HOST_RUNTIME     10000000 // us of simulated time before the report
+#define HOST_THREAD      8        // execution priority of threads, below all interrupts
+
+// timers that can interrupt the kernel, besides SysTick
+#define HOST_TIMERA    0        // BSP_PeriodicTask
+#define HOST_TIMERB    1        // BSP_PeriodicTask_InitB
+#define HOST_TIMERC    2        // BSP_PeriodicTask_InitC
+#define HOST_ONESHOT   3        // BSP_OneShotTask
+#define HOST_MICROPHONE 4       // BSP_Microphone_StartStream, once per block
+#define HOST_ADC2      5        // BSP_Accelerometer_Start conversion done
+#define HOST_ADC3      6        // BSP_Microphone_Start conversion done
+#define HOST_NUMTIMERS 7
+
+extern uint64_t HostTime;       // simulated time in us
+extern uint32_t HostTaskCount[7]; // TExaS_Task0 to TExaS_Task6 calls
+
+// ******** Host_Consume ************
+// Run the current thread or ISR for us of simulated CPU time
+// Interrupts that come due are taken on the way, so the thread may be
+// switched out, in which case the rest of its time is used once it runs again
+// Inputs:  us, microseconds of CPU time
+// Outputs: none
+void Host_Consume(uint32_t us);
+
+// ******** Host_Cycles ************
+// Simulated time in bus cycles, for measurements finer than HostTime
+// Inputs:  none
+// Outputs: cycles since reset
+uint64_t Host_Cycles(void);
+
+// ******** Host_MaxMasked ************
+// Longest time interrupts were disabled since StartOS, for tests that
+// bound the critical sections of a kernel
+// Inputs:  none
+// Outputs: cycles
+uint64_t Host_MaxMasked(void);
+
+// ******** Host_TimerStart ************
+// Arm one of the simulated timers
+// Inputs:  n, HOST_TIMERA to HOST_ADC3
+//          task, ISR to run
+//          first, us until the first interrupt
+//          period, us between interrupts, 0 for one shot
+//          priority, 0 is highest, 7 is lowest (same as SysTick)
+// Outputs: none
+void Host_TimerStart(int n, void(*task)(void), uint32_t first, uint32_t period, uint8_t priority);
+
+// ******** Host_TimerStop ************
+// Disarm one of the simulated timers
+// Inputs:  n, HOST_TIMERA to HOST_ADC3
+// Outputs: none
+void Host_TimerStop(int n);
+
+// ******** Host_PendSV ************
+// Context switch done by PendSV_Handler on the target, see osasm.c
+// Called by CortexM.c with interrupts disabled, after the Scheduler,
+// switches to RunPt and returns once the interrupted thread runs again
+// Inputs:  none
+// Outputs: none
+void Host_PendSV(void);
+
+// ******** Host_Start ************
+// Called by StartOS before the first thread runs, from then on
+// masked time and thread run lengths are measured
+// Inputs:  none
+// Outputs: none
+void Host_Start(void);
+
+// ******** Host_Switched ************
+// Called by osasm.c each time a different thread starts running
+// Inputs:  none
+// Outputs: none
+void Host_Switched(void);
+
+// ******** Host_AtReport ************
+// Add a check run by Host_Report after its own lines, for test mains
+// that know what the run should have done
+// Inputs:  check, prints its results, returns 0 if they are good
+// Outputs: none
+void Host_AtReport(int(*check)(void));
+
+// ******** Host_Report ************
+// Print context switches, throughput, CPU use, ISR times, latency and
+// masked time, run the checks and exit, with status 1 if one failed
+// Inputs:  none
+// Outputs: none (does not return)
+void Host_Report(void);
@@ -0,0 +1,64 @@
+// Profile.h
+// Profile pins of the Linux host port, kept in memory instead of GPIO
+// Same macros as ../inc/Profile.h, Profile_Get still reports them
+
+#include <stdint.h>
+
+extern volatile uint32_t HostProfile[7];
+
+#define PROFILE0  HostProfile[0]
+#define PROFILE0_BIT 0x02
+#define PROFILE1  HostProfile[1]
+#define PROFILE1_BIT 0x04
+#define PROFILE2  HostProfile[2]
+#define PROFILE2_BIT 0x08
+#define PROFILE3  HostProfile[3]
+#define PROFILE3_BIT 0x02
+#define PROFILE4  HostProfile[4]
+#define PROFILE4_BIT 0x01
+#define PROFILE5  HostProfile[5]
+#define PROFILE5_BIT 0x20
+#define PROFILE6  HostProfile[6]
+#define PROFILE6_BIT 0x80
+
+// ------------Profile_Init------------
+// Clear all Profile pins
+// Input: none
+// Output: none
+void Profile_Init(void);
+
+// ------------Profile_Get------------
+// Return the current status of all Profile pins.
+// Profile 0 is in bit 0. Profile 1 is in bit 1, and
+// so on, with the most significant bit set.
+// Input: none
+// Output: 7-bit status of all Profile pins
+uint8_t Profile_Get(void);
+
+#define Profile_Set0() (PROFILE0 = PROFILE0_BIT)
+#define Profile_Clear0() (PROFILE0 = 0x00)
+#define Profile_Toggle0() (PROFILE0 ^= PROFILE0_BIT)
+
+#define Profile_Set1() (PROFILE1 = PROFILE1_BIT)
+#define Profile_Clear1() (PROFILE1 = 0x00)
+#define Profile_Toggle1() (PROFILE1 ^= PROFILE1_BIT)
+
+#define Profile_Set2() (PROFILE2 = PROFILE2_BIT)
+#define Profile_Clear2() (PROFILE2 = 0x00)
+#define Profile_Toggle2() (PROFILE2 ^= PROFILE2_BIT)
+
+#define Profile_Set3() (PROFILE3 = PROFILE3_BIT)
+#define Profile_Clear3() (PROFILE3 = 0x00)
+#define Profile_Toggle3() (PROFILE3 ^= PROFILE3_BIT)
+
+#define Profile_Set4() (PROFILE4 = PROFILE4_BIT)
+#define Profile_Clear4() (PROFILE4 = 0x00)
+#define Profile_Toggle4() (PROFILE4 ^= PROFILE4_BIT)
+
+#define Profile_Set5() (PROFILE5 = PROFILE5_BIT)
+#define Profile_Clear5() (PROFILE5 = 0x00)
+#define Profile_Toggle5() (PROFILE5 ^= PROFILE5_BIT)
+
+#define Profile_Set6() (PROFILE6 = PROFILE6_BIT)
+#define Profile_Clear6() (PROFILE6 = 0x00)
+#define Profile_Toggle6() (PROFILE6 ^= PROFILE6_BIT)
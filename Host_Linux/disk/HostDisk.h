@@ -0,0 +1,33 @@
+// HostDisk.h
+// Counters and faults of the Linux host version of the flash disk,
+// eDisk.c in this directory, which keeps the 128 KB disk in an image
+// file mapped into memory and behaves like the TM4C123 flash: erase
+// sets a 1 KB block to 0xFF, and programming a word can only clear
+// bits.
+// The image is the file named by the environment variable
+// HOSTDISK_IMAGE, created erased if it does not exist, so a disk can
+// be kept from one run to the next and looked at with od or cmp.
+// Without it the disk is in memory only and starts erased.
+// Faults, counted in write steps (words programmed and blocks erased):
+//  - power can be cut on any step: the word being programmed or the
+//    block being erased is left half done, and eDisk jumps to
+//    HostDiskPowerFail instead of returning
+//  - any step can fail, leaving the flash as it was and returning
+//    RES_ERROR, as the flash controller does on an access violation
+//  - a block can wear out after a number of erases, after which
+//    erasing it leaves some bits at 0 and returns RES_ERROR
+
+#define HOSTDISK_BLOCKS 128     // 1 KB erase blocks
+#define HOSTDISK_SIZE   (HOSTDISK_BLOCKS*1024)
+
+extern uint8_t *HostDisk;            // the image, mapped by eDisk_Init or the first call
+extern uint32_t HostDiskErases[HOSTDISK_BLOCKS]; // per block
+extern uint32_t HostDiskWords;       // words programmed
+extern uint32_t HostDiskReads;       // sectors copied by eDisk_ReadSector
+extern uint32_t HostDiskRewrites;    // most times one word was programmed between erases
+extern uint32_t HostDiskBadBits;     // writes that tried to set a bit back to 1
+extern uint32_t HostDiskSteps;       // words programmed and blocks erased
+extern uint32_t HostDiskCutAt;       // step to cut power on, 0 for never
+extern jmp_buf HostDiskPowerFail;    // set with setjmp before HostDiskCutAt
+extern uint32_t HostDiskFailAt;      // step to fail, 0 for never
+extern uint32_t HostDiskEndurance;   // erases a block survives, 0 for no limit
@@ -0,0 +1,273 @@
+// bench.c
+// Speed of the file system on the Linux host, with the host disk in
+// eDisk.c of this directory, in ns of host time
+// Append: three files are appended to round robin, one sector at a
+// time, from a formatted disk until it is full. The cost of each
+// append is averaged over RUNS fills, in groups of GROUP sectors, so
+// any cost that grows as the disk fills shows as a rising column.
+// The second column flushes every FLUSHEVERY appends, which stores
+// the directory and FAT but keeps them in RAM, so it must stay as
+// flat as the first.
+// Size: OS_File_Size of each file of a full disk, which must agree
+// with a walk of its FAT chain after a remount; the bench fails if
+// not, or if a write had to set a bit back to 1.
+// Read: a full disk split one third and two thirds between two files
+// is read back front to back with OS_File_Read, with the cursor of
+// OS_File_ReadNext, and with walkread, which follows the FAT from the
+// start of the file on every read as OS_File_Read did before the
+// index, then reads through the cache as it does now. The contents
+// must match what was appended.
+// Copy: the two loops of eDisk_ReadSector in Lab5_4C123/eDisk.c, four
+// words per pass into an aligned buffer and a byte at a time into an
+// unaligned one, copied here since that file needs the board, against
+// OS_File_Map, which copies nothing. Each mapped sector must hold the
+// bytes OS_File_Read returns.
+// The times are for this machine and include the host disk copying
+// each sector into its image; compare rows and builds, not the board.
+//
+// Build and run from Host_Linux, see the Makefile
+//   make build/bench && build/bench
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+#include "eDisk.h"
+#include "eCache.h"
+#include "eFile.h"
+#include "HostDisk.h"
+
+#define RUNS  2000              // fills of the disk
+#define GROUP 30                // sectors per row
+#define FILES 3
+#define FLUSHEVERY 37
+#define READS 200               // passes over the files
+
+extern uint8_t Directory[256], FAT[256];
+extern int32_t bDirectoryLoaded;
+
+// ******** now ************
+// Host time for the measurements
+// Inputs:  none
+// Outputs: ns since an arbitrary start
+uint64_t static now(void){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec*1000000000 + t.tv_nsec;
+}
+
+uint64_t AppendTime[2][256/GROUP+2]; // ns over all runs, per row, 0 ends
+uint32_t AppendCount[2][256/GROUP+2];
+
+// ******** fill ************
+// Format and append to FILES files in turn until the disk is full
+// Inputs:  flush, 1 to flush every FLUSHEVERY appends
+// Outputs: sectors appended
+uint32_t static fill(int flush){
+  static uint8_t buf[512];
+  uint32_t sectors = 0, n;
+  uint64_t start;
+  OS_File_Format();
+  while(1){
+    start = now();
+    for(n=0; n<GROUP; n++){
+      buf[0] = sectors + n;
+      if(OS_File_Append((sectors + n)%FILES, buf)){
+        break;
+      }
+      if(flush && ((sectors + n)%FLUSHEVERY == FLUSHEVERY-1)){
+        OS_File_Flush();
+      }
+    }
+    AppendTime[flush][sectors/GROUP] += now() - start;
+    AppendCount[flush][sectors/GROUP] += n;
+    sectors = sectors + n;
+    if(n < GROUP){
+      return sectors;
+    }
+  }
+}
+
+// ******** walk ************
+// Sectors of a file, found by following its FAT chain
+// Inputs:  num, file number
+// Outputs: number of sectors
+uint32_t static walk(uint8_t num){
+  uint32_t n = 0;
+  uint8_t sector = Directory[num];
+  while((sector != 255)&&(n < 256)){
+    n++;
+    sector = FAT[sector];
+  }
+  return n;
+}
+
+// ******** walkread ************
+// Read a sector of a file by following its FAT chain from the start
+// Inputs:  num, file number
+//          location, sector in the file
+//          buf, 512 bytes
+// Outputs: 0 if successful, 255 past the end of the file
+uint8_t static walkread(uint8_t num, uint8_t location, uint8_t buf[512]){
+  uint8_t sector = Directory[num];
+  while(location && (sector != 255)){
+    sector = FAT[sector];
+    location--;
+  }
+  if(sector == 255){
+    return 255;
+  }
+  return (eCache_ReadSector(buf, sector) == RES_OK) ? 0 : 255;
+}
+
+// ******** readall ************
+// Read both files front to back READS times with one of three ways
+// Inputs:  how, 0 OS_File_Read, 1 OS_File_ReadNext, 2 walkread
+//          length, sectors in each file
+// Outputs: ns per sector, *bad counts sectors that do not match
+double static readall(int how, const uint32_t length[2], uint32_t *bad){
+  static uint8_t buf[512];
+  FileCursor cursor;
+  uint32_t pass, k, i, sectors = 0;
+  uint8_t result = 0;
+  uint64_t start = now();
+  for(pass=0; pass<READS; pass++){
+    for(k=0; k<2; k++){
+      OS_File_Rewind(&cursor, k);
+      for(i=0; i<length[k]; i++){
+        switch(how){
+        case 0: result = OS_File_Read(k, i, buf); break;
+        case 1: result = OS_File_ReadNext(&cursor, buf); break;
+        case 2: result = walkread(k, i, buf); break;
+        }
+        if(result || (buf[0] != (uint8_t)i) || (buf[1] != k)){
+          (*bad)++;
+        }
+        sectors++;
+      }
+    }
+  }
+  return (double)(now() - start)/sectors;
+}
+
+// ******** wordcopy ************
+// Aligned loop of eDisk_ReadSector in Lab5_4C123/eDisk.c
+void static wordcopy(uint8_t *buff, const uint8_t *ptByte){
+  const uint32_t *ptROM = (const uint32_t *)ptByte;
+  uint32_t *ptRAM = (uint32_t *)buff;
+  uint16_t i;
+  for(i=0;i<WORDSPERSECTOR;i=i+4) {  //copy 4 words per pass
+    ptRAM[i] = ptROM[i];
+    ptRAM[i+1] = ptROM[i+1];
+    ptRAM[i+2] = ptROM[i+2];
+    ptRAM[i+3] = ptROM[i+3];
+  }
+}
+
+// ******** bytecopy ************
+// Unaligned loop of eDisk_ReadSector in Lab5_4C123/eDisk.c
+void static bytecopy(uint8_t *buff, const uint8_t *ptByte){
+  uint16_t i;
+  for(i=0;i<512;i++) {  //copy byte by byte
+    buff[i] = ptByte[i];
+  }
+}
+
+// ******** copyall ************
+// Copy every sector of the disk READS times with one of the loops
+// Inputs:  how, 0 wordcopy, 1 bytecopy
+// Outputs: ns per sector
+double static copyall(int how){
+  static uint32_t aligned[WORDSPERSECTOR+1];
+  uint32_t pass, sector;
+  uint64_t start = now();
+  for(pass=0; pass<READS; pass++){
+    for(sector=0; sector<256; sector++){
+      if(how == 0){
+        wordcopy((uint8_t *)aligned, eDisk_MapSector(sector));
+      } else{
+        bytecopy((uint8_t *)aligned + 1, eDisk_MapSector(sector));
+      }
+      __asm__ volatile("" : : "r"(aligned) : "memory"); // keep the copy
+    }
+  }
+  return (double)(now() - start)/READS/256;
+}
+
+int main(void){
+  static uint8_t buf[512];
+  const uint8_t *mapped;
+  uint32_t sum = 0;
+  uint32_t length[2], bad = 0, differ = 0;
+  double timed[3];
+  uint32_t run, row, sectors = 0, flushed = 0, size[FILES], k, wrong = 0;
+  uint64_t start;
+  for(run=0; run<RUNS; run++){
+    sectors = fill(0);
+    flushed = fill(1);
+  }
+  printf("append, %d files round robin, %d fills of %u sectors, %u with flushes\n",
+    FILES, RUNS, sectors, flushed);
+  printf("  sectors      ns per append   flush every %d\n", FLUSHEVERY);
+  for(row=0; AppendCount[0][row]; row++){
+    printf("  %3u-%3u      %6.0f          %6.0f\n", row*GROUP, row*GROUP + AppendCount[0][row]/RUNS - 1,
+      (double)AppendTime[0][row]/AppendCount[0][row], (double)AppendTime[1][row]/AppendCount[1][row]);
+  }
+
+  OS_File_Flush();
+  start = now();
+  for(run=0; run<RUNS; run++){
+    for(k=0; k<FILES; k++){
+      size[k] = OS_File_Size(k);
+    }
+  }
+  printf("size  %.1f ns per OS_File_Size on a full disk\n", (double)(now() - start)/RUNS/FILES);
+  eCache_Invalidate();          // as after a reset
+  bDirectoryLoaded = 0;
+  for(k=0; k<FILES; k++){
+    if((OS_File_Size(k) != size[k])||(walk(k) != size[k])){
+      wrong++;
+    }
+  }
+  printf("  sizes %u %u %u, %u differ from the FAT after a remount, %u bits set back to 1\n",
+    size[0], size[1], size[2], wrong, HostDiskBadBits);
+
+  OS_File_Format();
+  length[0] = length[1] = 0;
+  for(k=0; ; k++){
+    buf[1] = (k%3 == 0) ? 0 : 1;  // one sector in three to file 0
+    buf[0] = length[buf[1]];
+    if(OS_File_Append(buf[1], buf)){
+      break;
+    }
+    length[buf[1]]++;
+  }
+  OS_File_Flush();
+  timed[0] = readall(0, length, &bad);
+  timed[1] = readall(1, length, &bad);
+  timed[2] = readall(2, length, &bad);
+  printf("read, files of %u and %u sectors, %u sectors wrong\n", length[0], length[1], bad);
+  printf("  %.0f ns per sector OS_File_Read, %.0f ns OS_File_ReadNext, %.0f ns walking the FAT\n",
+    timed[0], timed[1], timed[2]);
+
+  timed[0] = copyall(0);
+  timed[1] = copyall(1);
+  start = now();
+  for(run=0; run<READS; run++){
+    for(k=0; k<length[1]; k++){
+      sum += OS_File_Map(1, k)[0];
+    }
+  }
+  timed[2] = (double)(now() - start)/READS/length[1];
+  for(k=0; k<length[1]; k++){
+    mapped = OS_File_Map(1, k);
+    if((mapped == 0)||OS_File_Read(1, k, buf)||memcmp(mapped, buf, 512)){
+      differ++;
+    }
+  }
+  printf("copy, %.0f ns per sector 4 words per pass, %.0f ns a byte at a time, %.0f ns OS_File_Map\n",
+    timed[0], timed[1], timed[2]);
+  printf("  %u mapped sectors differ from OS_File_Read\n", differ);
+  return (wrong || HostDiskBadBits || (flushed != sectors) || bad || differ) ? 1 : 0;
+}
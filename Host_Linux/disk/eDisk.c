@@ -0,0 +1,197 @@
+// eDisk.c
+// Linux host version of Lab5_4C123/eDisk.c, so eFile.c and eCache.c
+// can run and be measured without the board
+// The disk is a 128 KB image mapped into memory, with the behavior
+// of the TM4C123 flash, see HostDisk.h. Sectors are read in place
+// the way the internal flash is, so eDisk_MapSector works the same.
+//
+// Build from the repository root with the file system and a main,
+// e.g. the wear simulation
+//   gcc -O2 -D__clz=__builtin_clz -ILab5_4C123 -IHost_Linux/disk
+//       Lab5_4C123/eFile.c Lab5_4C123/eCache.c
+//       Host_Linux/disk/eDisk.c Host_Linux/disk/wear.c -o wear
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "eDisk.h"
+#include "HostDisk.h"
+
+uint8_t *HostDisk;
+uint32_t HostDiskErases[HOSTDISK_BLOCKS];
+uint32_t HostDiskWords;
+uint32_t HostDiskReads;
+uint32_t HostDiskRewrites;
+uint32_t HostDiskBadBits;
+uint32_t HostDiskSteps;
+uint32_t HostDiskCutAt;
+jmp_buf HostDiskPowerFail;
+uint32_t HostDiskFailAt;
+uint32_t HostDiskEndurance;
+uint16_t Programs[HOSTDISK_BLOCKS*256]; // per word since its erase
+uint32_t Noise = 1;           // state of the torn write generator
+
+uint32_t static noise(void){
+  Noise = Noise*1664525 + 1013904223;
+  return Noise;
+}
+
+// Map the image named by HOSTDISK_IMAGE, or erased memory if there
+// is none; exits if the image can not be opened
+void static attach(void){
+  const char *name = getenv("HOSTDISK_IMAGE");
+  struct stat info;
+  void *disk;
+  int fd;
+  if(HostDisk){
+    return;
+  }
+  if(name == NULL){
+    disk = mmap(NULL, HOSTDISK_SIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(disk != MAP_FAILED){
+      memset(disk, 0xFF, HOSTDISK_SIZE);
+    }
+  }
+  else{
+    fd = open(name, O_RDWR|O_CREAT, 0644);
+    if((fd < 0)||fstat(fd, &info)){
+      perror(name);
+      exit(1);
+    }
+    if(info.st_size < HOSTDISK_SIZE){ // new or short, the rest is erased
+      if(ftruncate(fd, HOSTDISK_SIZE)){
+        perror(name);
+        exit(1);
+      }
+    }
+    disk = mmap(NULL, HOSTDISK_SIZE, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if((disk != MAP_FAILED)&&(info.st_size < HOSTDISK_SIZE)){
+      memset((uint8_t *)disk + info.st_size, 0xFF, HOSTDISK_SIZE - info.st_size);
+    }
+  }
+  if(disk == MAP_FAILED){
+    perror("HostDisk");
+    exit(1);
+  }
+  HostDisk = disk;
+}
+
+// Count a write step, 1 if power fails on it
+int static cut(void){
+  HostDiskSteps++;
+  return HostDiskSteps == HostDiskCutAt;
+}
+
+// Program count words at byte offset addr, like Flash_Write
+// Outputs: RES_ERROR if a step fails, leaving the rest unwritten
+enum DRESULT static program(const uint32_t *data, uint32_t addr, uint32_t count){
+  uint32_t *word = (uint32_t *)&HostDisk[addr];
+  uint32_t i;
+  for(i=0; i<count; i++){
+    if(cut()){
+      word[i] &= data[i]|noise(); // only some of the bits cleared
+      longjmp(HostDiskPowerFail, 1);
+    }
+    if(HostDiskSteps == HostDiskFailAt){
+      return RES_ERROR;
+    }
+    if(data[i]&~word[i]){
+      HostDiskBadBits++;
+    }
+    word[i] &= data[i];
+    HostDiskWords++;
+    Programs[addr/4+i]++;
+    if(Programs[addr/4+i] > HostDiskRewrites){
+      HostDiskRewrites = Programs[addr/4+i];
+    }
+  }
+  return RES_OK;
+}
+
+enum DRESULT eDisk_Init(uint32_t drive){
+  attach();
+  if(drive == 0){
+    return RES_OK;
+  }
+  return RES_ERROR;
+}
+
+enum DRESULT eDisk_ReadSector(uint8_t *buff, uint8_t sector){
+  attach();
+  HostDiskReads++;
+  memcpy(buff, &HostDisk[512*sector], 512);
+  return RES_OK;
+}
+
+const uint8_t *eDisk_MapSector(uint8_t sector){
+  attach();
+  return &HostDisk[512*sector];
+}
+
+// programs the 32-word chunks that change, each up to the last word
+// that changes, like the target
+enum DRESULT eDisk_WriteSector(const uint8_t *buff, uint8_t sector){
+  const uint32_t *data = (const uint32_t *)buff;
+  const uint32_t *flash;
+  uint32_t i, n;
+  attach();
+  flash = (const uint32_t *)&HostDisk[512*sector];
+  for(i=0; i<WORDSPERSECTOR; i=i+WORDSPERWRITE){
+    for(n=WORDSPERWRITE; (n>0)&&(flash[i+n-1] == data[i+n-1]); n--){
+    }
+    if(n&&(program(&data[i], 512*sector+4*i, n) != RES_OK)){
+      return RES_ERROR;
+    }
+  }
+  return RES_OK;
+}
+
+enum DRESULT eDisk_WriteWords(const uint32_t *buff, uint8_t sector, uint16_t word, uint16_t count){
+  if((word > WORDSPERSECTOR)||(count > WORDSPERSECTOR-word)){
+    return RES_PARERR;
+  }
+  attach();
+  return program(buff, 512*sector+4*word, count);
+}
+
+enum DRESULT eDisk_EraseBlock(uint8_t sector){
+  uint32_t block = sector/SECTORSPERBLOCK;
+  uint32_t i;
+  attach();
+  if(cut()){
+    for(i=0; i<1024; i=i+4){   // partly erased
+      *(uint32_t *)&HostDisk[1024*block+i] |= noise()&noise();
+    }
+    longjmp(HostDiskPowerFail, 1);
+  }
+  if(HostDiskSteps == HostDiskFailAt){
+    return RES_ERROR;
+  }
+  memset(&HostDisk[1024*block], 0xFF, 1024);
+  memset(&Programs[256*block], 0, 256*sizeof(uint16_t));
+  HostDiskErases[block]++;
+  if(HostDiskEndurance && (HostDiskErases[block] > HostDiskEndurance)){
+    for(i=0; i<1024; i=i+4){   // worn out, some bits stay 0
+      *(uint32_t *)&HostDisk[1024*block+i] &= noise()|noise();
+    }
+    return RES_ERROR;
+  }
+  return RES_OK;
+}
+
+enum DRESULT eDisk_Format(void){
+  uint32_t sector;
+  for(sector=0; sector<256; sector=sector+SECTORSPERBLOCK){
+    if(eDisk_EraseBlock(sector) != RES_OK){
+      return RES_ERROR;
+    }
+  }
+  return RES_OK;
+}
@@ -0,0 +1,215 @@
+// faults.c
+// Test of the faults and the image file of the host disk, eDisk.c in
+// this directory, and of the file system retrying after them, run on
+// the Linux host
+// 1) With HOSTDISK_IMAGE set, a child process formats the image,
+//    appends to FILES files and flushes, the first attempt failing on
+//    its first write step, the retry on its second and so on, until
+//    a flush returns 0. The parent maps the same image afterwards and
+//    must mount the files the child flushed.
+// 2) HostDiskFailAt: a failed program or erase returns RES_ERROR and
+//    leaves the flash as it was, and the same call retried succeeds.
+// 3) HostDiskEndurance: a block erased more often than that returns
+//    RES_ERROR and keeps some bits at 0. With the limit at the erases
+//    the disk has had, the file system flushes until the log needs a
+//    new block. That flush and every one after it must fail without
+//    programming the worn block, and a remount must give the files of
+//    the last flush that returned 0.
+//
+// Build from the repository root
+//   gcc -O2 -D__clz=__builtin_clz -ILab5_4C123 -IHost_Linux/disk
+//       Lab5_4C123/eFile.c Lab5_4C123/eCache.c
+//       Host_Linux/disk/eDisk.c Host_Linux/disk/faults.c -o faults
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "eDisk.h"
+#include "eCache.h"
+#include "eFile.h"
+#include "HostDisk.h"
+
+#define FILES   4
+#define APPENDS 40              // sectors flushed by the child
+#define RETRIES 10              // flushes after the log block wore out
+
+extern int32_t bDirectoryLoaded;
+
+// Drop everything in RAM, as a reset does
+void static reboot(void){
+  eCache_Invalidate();
+  bDirectoryLoaded = 0;
+}
+
+// Sector 'location' of file 'num' holds its position in the file
+void static fill(uint8_t *buf, int num, int location){
+  memset(buf, 7*location+num, 512);
+  buf[0] = (uint8_t)num;
+}
+
+// Number of sectors that do not read back as written
+int static checkfiles(void){
+  static uint8_t buf[512], want[512];
+  int num, location, errors = 0;
+  for(num=0; num<FILES; num++){
+    for(location=0; location<OS_File_Size(num); location++){
+      fill(want, num, location);
+      if(OS_File_Read(num, location, buf)||memcmp(buf, want, 512)){
+        errors++;
+      }
+    }
+  }
+  return errors;
+}
+
+// Runs in the child, on the image: 0 if the files were flushed after
+// at least one failed attempt, without a bit set back to 1
+int static writer(void){
+  static uint8_t buf[512];
+  uint32_t k, attempts = 0;
+  OS_File_Format();
+  for(k=0; k<APPENDS; k++){
+    fill(buf, k%FILES, k/FILES);
+    if(OS_File_Append(k%FILES, buf)){
+      return 1;
+    }
+  }
+  do{
+    attempts++;
+    HostDiskFailAt = HostDiskSteps + attempts;
+  } while(OS_File_Flush());
+  HostDiskFailAt = 0;
+  printf("image: flushed on attempt %u, bits set back to 1 %u\n", attempts, HostDiskBadBits);
+  return (attempts < 2)||HostDiskBadBits;
+}
+
+int static imagetest(void){
+  int status, num, wrong = 0, bad;
+  pid_t pid = fork();
+  if(pid == 0){
+    status = writer();
+    fflush(stdout);
+    _exit(status);
+  }
+  if((pid < 0)||(waitpid(pid, &status, 0) != pid)||!WIFEXITED(status)){
+    printf("image: writer did not run\n");
+    return 1;
+  }
+  reboot();                     // the first call maps the image
+  for(num=0; num<FILES; num++){
+    if(OS_File_Size(num) != APPENDS/FILES){
+      wrong++;
+    }
+  }
+  bad = checkfiles();
+  printf("image: %u files of the wrong size, %u bad sectors after mapping it again\n", wrong, bad);
+  return WEXITSTATUS(status)||wrong||bad;
+}
+
+int static steptest(void){
+  static uint8_t before[1024];
+  uint32_t words[4] = {0x12345678, 0x9ABCDEF0, 0x0F0F0F0F, 0};
+  uint32_t i, block = 10, errors = 0;
+  uint8_t *flash = &HostDisk[1024*block];
+  eDisk_EraseBlock(SECTORSPERBLOCK*block);
+  HostDiskBadBits = 0;
+  memcpy(before, flash, 1024);
+  HostDiskFailAt = HostDiskSteps + 3;  // after 2 words
+  if((eDisk_WriteWords(words, SECTORSPERBLOCK*block, 0, 4) != RES_ERROR)||
+     memcmp(flash, words, 8)||memcmp(flash+8, before+8, 1024-8)){
+    errors++;
+  }
+  if((eDisk_WriteWords(words, SECTORSPERBLOCK*block, 0, 4) != RES_OK)||memcmp(flash, words, 16)){
+    errors++;
+  }
+  memcpy(before, flash, 1024);
+  HostDiskFailAt = HostDiskSteps + 1;
+  if((eDisk_EraseBlock(SECTORSPERBLOCK*block) != RES_ERROR)||memcmp(flash, before, 1024)){
+    errors++;
+  }
+  HostDiskFailAt = 0;
+  memset(before, 0xFF, 1024);
+  if((eDisk_EraseBlock(SECTORSPERBLOCK*block) != RES_OK)||memcmp(flash, before, 1024)){
+    errors++;
+  }
+  HostDiskEndurance = HostDiskErases[block];
+  if(eDisk_EraseBlock(SECTORSPERBLOCK*block) != RES_ERROR){
+    errors++;
+  }
+  for(i=0; (i<1024)&&(flash[i] == 0xFF); i++){
+  }
+  if(i == 1024){                // worn out, some bits must stay 0
+    errors++;
+  }
+  HostDiskEndurance = 0;
+  errors += HostDiskBadBits;
+  printf("steps: %u failed or retried writes and erases that went wrong\n", errors);
+  return errors != 0;
+}
+
+int static endurancetest(void){
+  static uint8_t buf[512];
+  uint32_t block, flushes = 0, failed = 0, wrong = 0, bad;
+  int num, sizes[FILES];
+  eDisk_Format();               // every block erased at least once
+  reboot();
+  OS_File_Format();
+  HostDiskEndurance = 0xFFFFFFFF;
+  for(block=0; block<HOSTDISK_BLOCKS; block++){
+    if(HostDiskErases[block] < HostDiskEndurance){
+      HostDiskEndurance = HostDiskErases[block];
+    }
+  }
+  HostDiskBadBits = 0;
+  for(num=0; num<FILES; num++){
+    sizes[num] = 0;
+  }
+  while(failed < RETRIES){
+    num = flushes%FILES;
+    fill(buf, num, OS_File_Size(num));
+    if(OS_File_Append(num, buf)){
+      break;                    // full before the log wore out
+    }
+    flushes++;
+    if(OS_File_Flush()){
+      failed++;
+    } else if(failed == 0){
+      for(num=0; num<FILES; num++){
+        sizes[num] = OS_File_Size(num);
+      }
+    } else{
+      break;                    // a flush after a worn block succeeded
+    }
+  }
+  HostDiskEndurance = 0;
+  reboot();
+  for(num=0; num<FILES; num++){
+    if(OS_File_Size(num) != sizes[num]){
+      wrong++;
+    }
+  }
+  bad = checkfiles();
+  printf("endurance: %u flushes, the last %u failed, %u files of the wrong size, %u bad sectors, bits set back to 1 %u\n",
+    flushes, failed, wrong, bad, HostDiskBadBits);
+  return (failed != RETRIES)||wrong||bad||HostDiskBadBits;
+}
+
+int main(void){
+  char name[] = "/tmp/faultsXXXXXX";
+  int fd = mkstemp(name), result;
+  if(fd < 0){
+    perror(name);
+    return 1;
+  }
+  close(fd);                    // empty, eDisk.c makes it an erased disk
+  setenv("HOSTDISK_IMAGE", name, 1);
+  result = imagetest();
+  result |= steptest();
+  result |= endurancetest();
+  unlink(name);
+  return result;
+}
@@ -0,0 +1,224 @@
+// powerfail.c
+// Power failure test of the file system, run on the Linux host with
+// the host disk in eDisk.c of this directory
+// A workload of APPENDS appends, each followed by a flush, is run
+// once to record the directory and FAT after every flush. Then for
+// every write step of it, from the format on, the workload is run
+// again from a blank disk with the power cut on that step. After
+// each cut the file system is remounted, as after a reset, and must
+//  - hold the directory and FAT of the last flush that returned, or
+//    of the one that was cut if its commit was written
+//  - read back every sector of every file intact
+//  - mount in bounded time, which is one pass over the log
+//    blocks, shorter when the newest block holds less
+//  - keep working: one more sector per file, flushed and remounted
+// Then for every step the workload is run once more with that step
+// failing instead, as a flash controller error, and the power left on.
+// A failed format is retried, and after the workload one more flush
+// must succeed, so a log left half written is started over, and after
+// a remount every file must hold each sector whose append returned.
+// No step of either run may program a 1 over a 0, which is what
+// writing the log into a block whose erase failed would do.
+//
+// Build from the repository root
+//   gcc -O2 -D__clz=__builtin_clz -ILab5_4C123 -IHost_Linux/disk
+//       Lab5_4C123/eFile.c Lab5_4C123/eCache.c
+//       Host_Linux/disk/eDisk.c Host_Linux/disk/powerfail.c -o powerfail
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+#include "eDisk.h"
+#include "eCache.h"
+#include "eFile.h"
+#include "HostDisk.h"
+
+#define APPENDS 150             // about two blocks of log
+#define FILES   5
+#define MOUNTS  20              // mounts timed after each cut
+
+void MountDirectory(void);      // in eFile.c
+extern uint8_t Directory[256], FAT[256];
+extern int32_t bDirectoryLoaded;
+
+struct state{
+  uint8_t directory[256];
+  uint8_t fat[256];
+};
+struct state States[APPENDS+1]; // after each flush
+uint8_t Blank[HOSTDISK_SIZE];
+volatile int Flushed;           // flushes that returned
+int Appended[FILES];            // appends that returned 0
+
+// Drop everything in RAM, as a reset does
+void static reboot(void){
+  eCache_Invalidate();
+  bDirectoryLoaded = 0;
+}
+
+// Sector 'location' of file 'num' holds its position in the file
+void static fill(uint8_t *buf, int num, int location){
+  memset(buf, 5*location+num, 512);
+  buf[0] = (uint8_t)num;
+}
+
+void static workload(int record){
+  static uint8_t buf[512];
+  int k;
+  for(k=0; k<APPENDS; k++){
+    fill(buf, k%FILES, OS_File_Size(k%FILES));
+    if(OS_File_Append(k%FILES, buf) == 0){
+      Appended[k%FILES]++;
+    }
+    OS_File_Flush();
+    Flushed = k+1;
+    if(record){
+      MountDirectory();
+      memcpy(States[k+1].directory, Directory, 256);
+      memcpy(States[k+1].fat, FAT, 256);
+    }
+  }
+}
+
+int static same(struct state *s){
+  return (memcmp(s->directory, Directory, 256) == 0)&&(memcmp(s->fat, FAT, 256) == 0);
+}
+
+// Number of sectors that do not read back as written
+int static checkfiles(void){
+  static uint8_t buf[512], want[512];
+  int num, location, errors = 0;
+  for(num=0; num<FILES; num++){
+    for(location=0; location<OS_File_Size(num); location++){
+      fill(want, num, location);
+      if(OS_File_Read(num, location, buf)||memcmp(buf, want, 512)){
+        errors++;
+      }
+    }
+  }
+  return errors;
+}
+
+double static now(void){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+// Mount MOUNTS times, return the fastest in us
+double static mounttime(void){
+  double best = 1e9, start, t;
+  int i;
+  for(i=0; i<MOUNTS; i++){
+    bDirectoryLoaded = 0;
+    start = now();
+    MountDirectory();
+    t = now() - start;
+    if(t < best){
+      best = t;
+    }
+  }
+  return best*1e6;
+}
+
+int main(void){
+  static uint8_t buf[512];
+  uint32_t steps, step, atlast = 0, atcut = 0, lost = 0, badfiles = 0, stuck = 0, badbits = 0;
+  uint32_t retrylost = 0, retrybad = 0, retrystuck = 0;
+  double t, tmin = 1e9, tmax = 0;
+  int num, sizes[FILES];
+  eDisk_Format();               // blank chip
+  memcpy(Blank, HostDisk, HOSTDISK_SIZE);
+  HostDiskSteps = 0;
+  OS_File_Format();
+  MountDirectory();
+  memcpy(States[0].directory, Directory, 256);
+  memcpy(States[0].fat, FAT, 256);
+  workload(1);
+  steps = HostDiskSteps;
+  for(step=1; step<=steps; step++){
+    memcpy(HostDisk, Blank, HOSTDISK_SIZE);
+    reboot();
+    Flushed = 0;
+    HostDiskSteps = 0;
+    HostDiskCutAt = step;
+    if(setjmp(HostDiskPowerFail) == 0){
+      OS_File_Format();
+      workload(0);
+      printf("step %u: power never cut\n", step);
+      return 1;
+    }
+    HostDiskCutAt = 0;
+    reboot();
+    t = mounttime();
+    if(t < tmin){
+      tmin = t;
+    }
+    if(t > tmax){
+      tmax = t;
+    }
+    if(same(&States[Flushed])){
+      atlast++;
+    } else if((Flushed < APPENDS)&&same(&States[Flushed+1])){
+      atcut++;
+    } else{
+      lost++;
+      continue;
+    }
+    badfiles += checkfiles();
+    HostDiskBadBits = 0;        // torn words are expected, later ones are not
+    for(num=0; num<FILES; num++){
+      sizes[num] = OS_File_Size(num);
+      fill(buf, num, sizes[num]);
+      if(OS_File_Append(num, buf)){
+        stuck++;
+      }
+    }
+    if(OS_File_Flush()){
+      stuck++;
+    }
+    reboot();
+    for(num=0; num<FILES; num++){
+      if(OS_File_Size(num) != sizes[num]+1){
+        stuck++;
+      }
+    }
+    badfiles += checkfiles();
+    badbits += HostDiskBadBits;
+  }
+  for(step=1; step<=steps; step++){
+    memcpy(HostDisk, Blank, HOSTDISK_SIZE);
+    reboot();
+    HostDiskSteps = 0;
+    HostDiskBadBits = 0;
+    HostDiskFailAt = step;
+    memset(Appended, 0, sizeof(Appended));
+    if(OS_File_Format()&&OS_File_Format()){
+      retrystuck++;
+    }
+    workload(0);
+    HostDiskFailAt = 0;
+    if(OS_File_Flush()){
+      retrystuck++;
+      continue;
+    }
+    reboot();
+    for(num=0; num<FILES; num++){
+      if(OS_File_Size(num) != Appended[num]){
+        retrylost++;
+      }
+    }
+    retrybad += checkfiles();
+    badbits += HostDiskBadBits;
+  }
+  printf("%u write steps, power cut on each\n", steps);
+  printf("mounted at the last flush %u, at the cut flush %u, neither %u\n", atlast, atcut, lost);
+  printf("bad sectors %u, failed appends or flushes after the cut %u\n", badfiles, stuck);
+  printf("mount time %.1f to %.1f us on this host\n", tmin, tmax);
+  printf("failed on each step and retried: files of the wrong size %u, bad sectors %u, failed flushes %u\n",
+    retrylost, retrybad, retrystuck);
+  printf("bits set back to 1 %u\n", badbits);
+  return (lost||badfiles||stuck||badbits||retrylost||retrybad||retrystuck);
+}
@@ -0,0 +1,363 @@
+// stream.c
+// Test of the byte functions of the file system, run on the Linux
+// host with the host disk in eDisk.c of this directory
+// 1) Random writes of 1 to 600 bytes, reads, seeks, closes, flushes
+//    and remounts on NUMOPEN files, checked against a copy in RAM.
+// 2) A logger adding 8-byte samples to two files, flushing every
+//    FLUSHEVERY samples, with the power cut on each write step.
+//    Each cut runs in a child process, so the remount that follows
+//    starts from clean RAM as after a reset. The files must hold the
+//    bytes of the last flush that returned, or of the one that was
+//    cut, and must take more samples without setting a bit back to 1.
+//    The 8-byte samples fill whole words, so without a cut each word
+//    is programmed once; in the random test of 1) at most MAXPROGRAMS.
+// 3) A sector mapped with OS_File_Map right after it is appended, while
+//    it is still dirty in the cache, must keep its bytes after enough
+//    appends to evict every cache slot.
+// 4) OS_File_Append to a file open for bytes, with bytes still in the
+//    buffer of its descriptor, in a new sector and in a partial one.
+//    The buffered bytes must be stored before the appended sector and
+//    the writes after it must go on after that sector.
+// 5) Built with -DGRADERLAYOUT=1, sector 255 must hold the directory
+//    and FAT in the layout the TExaS grader reads after each flush.
+//
+// Build from the repository root
+//   gcc -O2 -D__clz=__builtin_clz -ILab5_4C123 -IHost_Linux/disk
+//       Lab5_4C123/eFile.c Lab5_4C123/eCache.c
+//       Host_Linux/disk/eDisk.c Host_Linux/disk/stream.c -o stream
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "eDisk.h"
+#include "eCache.h"
+#include "eFile.h"
+#include "HostDisk.h"
+
+#define OPS        20000        // random operations
+#define SAMPLES    400          // 8-byte samples, alternating files
+#define FLUSHEVERY 7
+// Most programs of one word between erases. A record is programmed
+// onto erased words, except the word holding the end of a file, which
+// is programmed again for each byte added to it before it fills.
+#define MAXPROGRAMS 4
+
+extern int32_t bDirectoryLoaded;
+
+// Drop everything in RAM that a reset clears and that the files
+// being closed do not
+void static reboot(void){
+  eCache_Invalidate();
+  bDirectoryLoaded = 0;
+}
+
+uint8_t Model[NUMOPEN][60000];  // what each file should hold
+uint32_t ModelLength[NUMOPEN];
+
+int static randomtest(void){
+  static uint8_t buf[600], got[600];
+  uint8_t fd[NUMOPEN];
+  uint32_t position[NUMOPEN], n, i, k, errors = 0;
+  int f;
+  OS_File_Format();
+  for(f=0; f<NUMOPEN; f++){
+    fd[f] = OS_File_Open(f);
+    position[f] = 0;
+  }
+  for(k=0; k<OPS; k++){
+    f = rand()%NUMOPEN;
+    switch(rand()%10){
+    case 0: case 1: case 2: case 3:  // write
+      n = 1 + rand()%600;
+      if(ModelLength[f]+n > sizeof(Model[f])){
+        break;
+      }
+      for(i=0; i<n; i++){
+        buf[i] = rand();
+      }
+      if(OS_File_WriteBytes(fd[f], buf, n)){
+        errors++;
+      }
+      memcpy(&Model[f][ModelLength[f]], buf, n);
+      ModelLength[f] += n;
+      break;
+    case 4: case 5: case 6:          // read
+      n = rand()%600;
+      if(n > ModelLength[f]-position[f]){
+        n = ModelLength[f]-position[f];
+      }
+      if((OS_File_ReadBytes(fd[f], got, n) != n)||memcmp(got, &Model[f][position[f]], n)){
+        errors++;
+      }
+      position[f] += n;
+      break;
+    case 7:                          // seek
+      position[f] = rand()%(ModelLength[f]+1);
+      if(OS_File_Seek(fd[f], position[f])||(OS_File_Seek(fd[f], ModelLength[f]+1) != 255)){
+        errors++;
+      }
+      break;
+    case 8:                          // flush
+      if(OS_File_Flush()||(OS_File_Length(f) != ModelLength[f])){
+        errors++;
+      }
+      break;
+    case 9:                          // close, reset and open again
+      for(f=0; f<NUMOPEN; f++){
+        if(OS_File_Close(fd[f])){
+          errors++;
+        }
+      }
+      OS_File_Flush();
+      reboot();
+      for(f=0; f<NUMOPEN; f++){
+        if(OS_File_Length(f) != ModelLength[f]){
+          errors++;
+        }
+        fd[f] = OS_File_Open(f);
+        OS_File_Seek(fd[f], position[f]);
+      }
+      break;
+    }
+  }
+  printf("random: %u operations, %u and %u bytes, %u sectors, %u errors, bits set back to 1 %u\n",
+    OPS, ModelLength[0], ModelLength[1], OS_File_Size(0)+OS_File_Size(1), errors, HostDiskBadBits);
+  printf("random: most programs of one word between erases %u, bound %d\n",
+    HostDiskRewrites, MAXPROGRAMS);
+  return errors||HostDiskBadBits||(HostDiskRewrites > MAXPROGRAMS);
+}
+
+// Sample k of the logger
+void static sample(uint8_t *buf, int k){
+  int i;
+  for(i=0; i<8; i++){
+    buf[i] = k*8+i;
+  }
+}
+
+#define FLUSHES ((SAMPLES+FLUSHEVERY-1)/FLUSHEVERY)
+uint32_t Lengths[FLUSHES+1][2]; // after each flush
+int Flushed;                    // flushes that returned
+
+void static logger(int record){
+  uint8_t buf[8], fd[2];
+  int k;
+  Flushed = 0;
+  fd[0] = OS_File_Open(0);
+  fd[1] = OS_File_Open(1);
+  for(k=0; k<SAMPLES; k++){
+    sample(buf, k);
+    OS_File_WriteBytes(fd[k%2], buf, 8);
+    if((k%FLUSHEVERY == FLUSHEVERY-1)||(k == SAMPLES-1)){
+      OS_File_Flush();
+      Flushed++;
+      if(record){
+        Lengths[Flushed][0] = OS_File_Length(0);
+        Lengths[Flushed][1] = OS_File_Length(1);
+      }
+    }
+  }
+  OS_File_Close(fd[0]);
+  OS_File_Close(fd[1]);
+}
+
+// 1 if the files are as after flush 'n'
+int static atflush(int n){
+  return (n <= FLUSHES)&&(Lengths[n][0] == OS_File_Length(0))&&(Lengths[n][1] == OS_File_Length(1));
+}
+
+// 1 if file 'num' holds its samples up to 'length' bytes
+int static samplesok(int num, uint32_t length){
+  uint8_t got[8], want[8];
+  uint8_t fd = OS_File_Open(num);
+  uint32_t k;
+  int ok = 1;
+  for(k=0; 8*k<length; k++){
+    sample(want, 2*k+num);
+    if((OS_File_ReadBytes(fd, got, 8) != 8)||memcmp(got, want, 8)){
+      ok = 0;
+    }
+  }
+  OS_File_Close(fd);
+  return ok;
+}
+
+int static powertest(void){
+  static uint8_t blank[HOSTDISK_SIZE];
+  uint8_t buf[8], fd;
+  uint32_t steps, step, atlast = 0, atcut = 0, lost = 0, badfiles = 0, stuck = 0, badbits = 0;
+  uint32_t programs;
+  int fds[2], num, k;
+  eDisk_Format();
+  memcpy(blank, HostDisk, HOSTDISK_SIZE);
+  reboot();
+  HostDiskSteps = 0;
+  HostDiskRewrites = 0;
+  OS_File_Format();
+  logger(1);
+  steps = HostDiskSteps;
+  programs = HostDiskRewrites;  // samples fill whole words
+  for(step=1; step<=steps; step++){
+    memcpy(HostDisk, blank, HOSTDISK_SIZE);
+    reboot();
+    if(pipe(fds) || (fork() == 0)){
+      HostDiskSteps = 0;         // the child runs up to the cut and
+      HostDiskCutAt = step;      // sends back the disk as it is left
+      Flushed = 0;
+      if(setjmp(HostDiskPowerFail) == 0){
+        OS_File_Format();
+        logger(0);
+      }
+      write(fds[1], &Flushed, sizeof(Flushed));
+      write(fds[1], HostDisk, HOSTDISK_SIZE);
+      _exit(0);
+    }
+    close(fds[1]);
+    read(fds[0], &Flushed, sizeof(Flushed));
+    for(k=0; k<HOSTDISK_SIZE; k+=read(fds[0], &HostDisk[k], HOSTDISK_SIZE-k));
+    close(fds[0]);
+    wait(0);
+    if(atflush(Flushed)){
+      atlast++;
+    } else if(atflush(Flushed+1)){
+      atcut++;
+    } else{
+      lost++;
+      continue;
+    }
+    for(num=0; num<2; num++){
+      badfiles += !samplesok(num, OS_File_Length(num));
+    }
+    HostDiskBadBits = 0;        // torn words are expected, later ones are not
+    for(num=0; num<2; num++){   // the next sample of each file
+      fd = OS_File_Open(num);
+      sample(buf, 2*(OS_File_Length(num)/8)+num);
+      if(OS_File_WriteBytes(fd, buf, 8)||OS_File_Close(fd)){
+        stuck++;
+      }
+    }
+    if(OS_File_Flush()){
+      stuck++;
+    }
+    reboot();
+    for(num=0; num<2; num++){
+      badfiles += !samplesok(num, OS_File_Length(num));
+    }
+    badbits += HostDiskBadBits;
+  }
+  printf("logger: %u write steps, power cut on each\n", steps);
+  printf("mounted at the last flush %u, at the cut flush %u, neither %u\n", atlast, atcut, lost);
+  printf("bad files %u, failed writes or flushes after the cut %u, bits set back to 1 %u\n",
+    badfiles, stuck, badbits);
+  printf("most programs of one word between erases %u\n", programs);
+#if GRADERLAYOUT
+  programs = 1;                 // the copy for the grader is programmed up to 4 times
+#endif
+  return lost||badfiles||stuck||badbits||(programs > 1);
+}
+
+int static maptest(void){
+  static uint8_t buf[512];
+  const uint8_t *mapped;
+  uint32_t k, errors = 0;
+  reboot();
+  OS_File_Format();
+  memset(buf, 0xA5, 512);
+  OS_File_Append(0, buf);
+  mapped = OS_File_Map(0, 0);
+  if((mapped == 0)||memcmp(mapped, buf, 512)){
+    errors++;
+  }
+  memset(buf, 0x5A, 512);
+  for(k=0; k<2*ECACHE_SLOTS; k++){ // reuse every slot
+    OS_File_Append(1, buf);
+    OS_File_Read(1, k, buf);
+  }
+  memset(buf, 0xA5, 512);
+  if((mapped == 0)||memcmp(mapped, buf, 512)){
+    errors++;
+  }
+  printf("map: %u pointers changed by eviction\n", errors);
+  return errors;
+}
+
+// 1 if file 'num' holds 'length' bytes equal to want
+int static fileis(int num, const uint8_t *want, uint32_t length){
+  static uint8_t got[2048];
+  uint8_t fd = OS_File_Open(num);
+  int ok = (OS_File_Length(num) == length)&&(OS_File_ReadBytes(fd, got, length) == length)&&
+           (memcmp(got, want, length) == 0);
+  OS_File_Close(fd);
+  return ok;
+}
+
+int static mixedtest(void){
+  static uint8_t sector[512], want[2048];
+  uint8_t fd;
+  uint32_t errors = 0;
+  reboot();
+  OS_File_Format();
+  memset(sector, 'S', 512);
+  memset(want, 0xFF, sizeof(want));
+  // bytes in a new sector, then a sector appended
+  fd = OS_File_Open(0);
+  errors += OS_File_WriteBytes(fd, (const uint8_t *)"AAAAAAA", 8) != 0;
+  errors += OS_File_Append(0, sector) != 0;
+  errors += OS_File_WriteBytes(fd, (const uint8_t *)"BBBBBBB", 8) != 0;
+  errors += OS_File_Close(fd) != 0;
+  memcpy(want, "AAAAAAA", 8);
+  memcpy(&want[512], sector, 512);
+  memcpy(&want[1024], "BBBBBBB", 8);
+  errors += !fileis(0, want, 1032);
+  // bytes added in place to a partial sector, then a sector appended
+  fd = OS_File_Open(1);
+  errors += OS_File_WriteBytes(fd, (const uint8_t *)"AAAAAAA", 8) != 0;
+  errors += OS_File_Flush() != 0;
+  errors += OS_File_WriteBytes(fd, (const uint8_t *)"CCCCCCC", 8) != 0;
+  errors += OS_File_Append(1, sector) != 0;
+  errors += OS_File_WriteBytes(fd, (const uint8_t *)"BBBBBBB", 8) != 0;
+  errors += OS_File_Close(fd) != 0;
+  errors += OS_File_Flush() != 0;
+  memcpy(&want[8], "CCCCCCC", 8);
+  errors += !fileis(1, want, 1032);
+  reboot();
+  memset(&want[8], 0xFF, 8);
+  errors += !fileis(0, want, 1032);
+  memcpy(&want[8], "CCCCCCC", 8);
+  errors += !fileis(1, want, 1032);
+  printf("mixed: %u failed calls or files read back wrong\n", errors);
+  return errors != 0;
+}
+
+#if GRADERLAYOUT
+extern uint8_t Directory[256], FAT[256];
+int static gradertest(void){
+  static uint8_t buf[512];
+  uint32_t k, errors = 0;
+  reboot();
+  OS_File_Format();
+  for(k=0; OS_File_Append(k%5, buf) == 0; k++){
+    if((k%7 == 6)&&(OS_File_Flush() == 0)){
+      OS_File_Size(0);          // mount again
+      if(memcmp(&HostDisk[512*255], Directory, 256)||memcmp(&HostDisk[512*255+256], FAT, 256)){
+        errors++;
+      }
+    }
+  }
+  printf("grader layout: %u sectors, %u flushes left sector 255 out of date\n", k, errors);
+  return errors;
+}
+#else
+int static gradertest(void){
+  return 0;
+}
+#endif
+
+int main(void){
+  eDisk_Format();
+  return randomtest()|powertest()|maptest()|mixedtest()|gradertest();
+}
@@ -0,0 +1,67 @@
+// wear.c
+// Flash wear of the file system over a million flushes, run on the
+// Linux host with the host disk in eDisk.c of this directory
+// Four files are appended to in turn, one sector per flush, like
+// loggers that flush after every sector. When the disk is full it
+// is formatted and the logging starts over.
+// Prints the erases of every block that holds data or directory,
+// and the most times any word was programmed between two erases.
+//
+// Build from the repository root
+//   gcc -O2 -D__clz=__builtin_clz -ILab5_4C123 -IHost_Linux/disk
+//       Lab5_4C123/eFile.c Lab5_4C123/eCache.c
+//       Host_Linux/disk/eDisk.c Host_Linux/disk/wear.c -o wear
+
+#include <stdint.h>
+#include <stdio.h>
+#include <setjmp.h>
+#include "eDisk.h"
+#include "eFile.h"
+#include "HostDisk.h"
+
+#define FLUSHES 1000000
+
+int main(void){
+  static uint8_t buf[512];
+  uint32_t flushes = 0, formats = 0, block, min = 0xFFFFFFFF, max = 0, words;
+  uint8_t file = 0;
+  eDisk_Format();               // blank chip
+  OS_File_Format();
+  formats++;
+  words = HostDiskWords;
+  while(flushes < FLUSHES){
+    buf[0] = (uint8_t)flushes;
+    if(OS_File_Append(file, buf)){
+      OS_File_Format();         // full
+      formats++;
+      continue;
+    }
+    file = (file+1)%4;
+    if(OS_File_Flush()){
+      printf("flush failed\n");
+      return 1;
+    }
+    flushes++;
+  }
+  printf("%u flushes, %u formats, %.1f words programmed per flush\n",
+    flushes, formats, (double)(HostDiskWords - words)/flushes);
+  for(block=0; block<HOSTDISK_BLOCKS; block++){
+    if(HostDiskErases[block] == 0){
+      continue;                 // never used
+    }
+    if(HostDiskErases[block] < min){
+      min = HostDiskErases[block];
+    }
+    if(HostDiskErases[block] > max){
+      max = HostDiskErases[block];
+    }
+  }
+  printf("erases per block: min %u max %u\n", min, max);
+  printf("top 8 blocks, the log and the last data blocks:");
+  for(block=HOSTDISK_BLOCKS-8; block<HOSTDISK_BLOCKS; block++){
+    printf(" %u", HostDiskErases[block]);
+  }
+  printf("\nmost programs of one word between erases %u, bits set back to 1 %u\n",
+    HostDiskRewrites, HostDiskBadBits);
+  return 0;
+}
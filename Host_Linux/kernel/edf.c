@@ -0,0 +1,157 @@
+// edf.c
+// Deadlines of the PeriodicRTOS event threads, run on the Linux host,
+// see Host.h
+// Three main threads round robin as in user.c, and three event threads
+// with the periods of user.c, 100, 20 and 10 ms, each computing for a
+// set time every run, picked with -DLOAD
+//   1   0.8 ms each, 11% of the CPU
+//   2   4, 3 and 2.5 ms, 44%
+//   3   30, 6 and 3 ms, 90%
+// Start and finish of each run are timed here, outside the kernel. The
+// k-th run of an event thread must finish by its first release plus
+// k+1 periods; jitter is the worst difference between the time from
+// one start to the next and the period.
+// Built with -DINDEXORDER the kernel runs with the Scheduler it had
+// before the heaps: the first event thread in index order within 10 us
+// of its deadline runs, and its next deadline is counted from when it
+// was picked. Compare build/edf_N with build/indexorder_N. The check
+// fails if an EDF run misses its deadline or is lost; the index order
+// runs only report.
+//
+// Build and run from Host_Linux, see the Makefile
+//   make build/edf_3 build/indexorder_3 && build/edf_3
+
+#include <stdio.h>
+#ifdef INDEXORDER
+#define Scheduler EDFScheduler
+#endif
+#include "os.c"
+#undef Scheduler
+#include "Host.h"
+
+#ifndef LOAD
+#define LOAD 3
+#endif
+#define EVENTS 3
+
+const uint32_t Period[EVENTS] = {100000, 20000, 10000}; // us
+#if LOAD == 1
+const uint32_t Work[EVENTS] = {800, 800, 800};          // us each run
+#elif LOAD == 2
+const uint32_t Work[EVENTS] = {4000, 3000, 2500};
+#else
+const uint32_t Work[EVENTS] = {30000, 6000, 3000};
+#endif
+
+uint32_t Runs[EVENTS], Misses[EVENTS];
+uint32_t LastStart[EVENTS];
+int32_t Lateness[EVENTS], Jitter[EVENTS]; // us, worst of each
+volatile uint32_t MainCount[NUMTHREADS];
+
+#ifdef INDEXORDER
+// ******** Scheduler ************
+// Scheduler of the original PeriodicRTOS os.c
+// Inputs:  none
+// Outputs: none
+void Scheduler(void){ int i;
+  uint32_t time; int32_t timeToDeadline;
+  time = BSP_Time_Get();     // in us
+  for(i=NUMTHREADS; i<NUMTHREADS+NumEventThreads;i++){
+    timeToDeadline = tcbs[i].deadline - time; // handles time rollover after 71 minutes
+    if(timeToDeadline <= 10){ // event thread is ready to run
+      tcbs[i].next = RunPt;  // go back to circular list when done
+      RunPt = &tcbs[i];      // IMPORTANT: run this one NOW
+      tcbs[i].deadline = time + tcbs[i].period;
+      return;
+    }
+  }
+  RunPt = RunPt->next;    // Round Robin
+}
+#endif
+
+void static event(uint32_t k){
+  uint32_t start, due;
+  int32_t late, jitter;
+  while(1){
+    start = BSP_Time_Get();
+    if(Runs[k]){
+      jitter = (int32_t)(start - LastStart[k] - Period[k]);
+      if(jitter < 0){
+        jitter = -jitter;
+      }
+      if(jitter > Jitter[k]){
+        Jitter[k] = jitter;
+      }
+    }
+    LastStart[k] = start;
+    Host_Consume(Work[k]);
+    due = 1000 + 1000*(NUMTHREADS + k) + (Runs[k] + 1)*Period[k];
+    late = (int32_t)(BSP_Time_Get() - due);
+    if(late > 0){
+      Misses[k]++;
+    }
+    if((Runs[k] == 0)||(late > Lateness[k])){
+      Lateness[k] = late;
+    }
+    Runs[k]++;
+    OS_Suspend();
+  }
+}
+
+void EventThread0(void){ event(0); }
+void EventThread1(void){ event(1); }
+void EventThread2(void){ event(2); }
+
+void MainThread0(void){
+  while(1){
+    MainCount[0]++;
+  }
+}
+void MainThread1(void){
+  while(1){
+    MainCount[1]++;
+  }
+}
+void MainThread2(void){
+  while(1){
+    MainCount[2]++;
+    OS_Suspend();
+  }
+}
+
+int static check(void){
+  uint32_t k, expected;
+  int bad = 0;
+  for(k=0; k<EVENTS; k++){
+    expected = (HOST_RUNTIME - 1000*(NUMTHREADS + k + 1))/Period[k];
+    printf("EventThread%u %6u us every %6u us  %5u runs of %u, %5u missed, lateness %6d us most, jitter %5d us\n",
+      k, Work[k], Period[k], Runs[k], expected, Misses[k], Lateness[k], Jitter[k]);
+    if((Misses[k] != 0)||(Runs[k] + 1 < expected)){
+      bad = 1;
+    }
+  }
+  printf("main threads        %u, %u, %u loops\n", MainCount[0], MainCount[1], MainCount[2]);
+#ifdef INDEXORDER
+  printf("index order, not checked\n");
+  return 0;
+#else
+  printf("kernel counted %u missed, lateness %d us most\n", OS_DeadlineMisses(), OS_MaxLateness());
+  printf("%s\n", bad ? "FAILED" : "passed");
+  return bad;
+#endif
+}
+
+int main(void){
+  int i;
+  OS_Init();
+  OS_AddThreads(&MainThread0, &MainThread1, &MainThread2);
+  OS_AddPeriodicThreads(&EventThread0, Period[0], &EventThread1, Period[1], &EventThread2, Period[2]);
+#ifdef INDEXORDER
+  for(i=NUMTHREADS; i<NUMTHREADS+NumEventThreads;i++){
+    tcbs[i].deadline = 1000+1000*i; // in usec, as the original OS_Launch
+  }
+#endif
+  Host_AtReport(&check);
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;
+}
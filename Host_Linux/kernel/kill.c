@@ -0,0 +1,63 @@
+// kill.c
+// OS_Kill of a thread that owns a mutex, in the Lab4 kernel, run on
+// the Linux host, see Host.h
+// Owner, at priority 1, takes Lock, sleeps 5 ms holding it and kills
+// itself. Waiter, at priority 0, sleeps 1 ms so that Owner takes Lock
+// first, then blocks on it and raises Owner to priority 0. After that
+// it takes Lock every 10 ms. Busy, at priority 2, never blocks, so
+// there is always a thread to run. The check fails if Waiter takes
+// Lock fewer than half the times it should, as when it waits forever
+// on the dead Owner, or if the TCB of Owner is not freed.
+//
+// Build and run from Host_Linux, see the Makefile
+//   make build/kill && build/kill
+
+#include <stdio.h>
+#include "os.c"
+#include "Host.h"
+
+#define PERIODS (HOST_RUNTIME/10000) // times Waiter takes Lock
+
+MutexType Lock;
+uint32_t Taken, BusyCount;
+
+void Owner(void){
+  OS_MutexLock(&Lock);
+  OS_Sleep(5);
+  OS_Kill();
+}
+
+void Waiter(void){
+  OS_Sleep(1);
+  while(1){
+    OS_MutexLock(&Lock);
+    Taken++;
+    OS_MutexUnlock(&Lock);
+    OS_Sleep(10);
+  }
+}
+
+void Busy(void){
+  while(1){
+    BusyCount++;
+  }
+}
+
+int static check(void){
+  int bad;
+  printf("Waiter took Lock %u times of %d, %u threads left\n", Taken, PERIODS, NumThread);
+  bad = (2*Taken < PERIODS)||(NumThread != 2);
+  printf("%s\n", bad ? "FAILED" : "passed");
+  return bad;
+}
+
+int main(void){
+  OS_Init();
+  OS_InitMutex(&Lock);
+  OS_AddThread(&Waiter, 0, 32);
+  OS_AddThread(&Owner, 1, 32);
+  OS_AddThread(&Busy, 2, 32);
+  Host_AtReport(&check);
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;
+}
@@ -0,0 +1,80 @@
+// latency.c
+// Interrupt-to-thread latency of the Lab4 kernel, run on the Linux
+// host, see Host.h
+// A periodic ISR at priority 1, every 1003 us so it drifts against the
+// 1 ms time slice, signals Event. Thread Waiter, at priority 0, waits
+// on Event and takes the time as soon as OS_Wait returns. Thread Busy,
+// at priority 1, never blocks, so the signal always finds a thread to
+// switch from. Latency is from the cycle the interrupt was due to the
+// cycle the waiter runs, and the switch has to go through PendSV.
+// With the periodic tick and with TICKLESS=1, makeready pends PendSV
+// when the woken thread has a higher priority, so it runs as soon as
+// the ISR returns rather than at the next time slice.
+// The check fails if a signal is lost or the worst latency is above
+// MAXLATENCY cycles, far less than a time slice.
+//
+// Build and run from Host_Linux, see the Makefile
+//   make build/latency build/latency_tickless && build/latency_tickless
+
+#include <stdio.h>
+#include "os.c"
+#include "Host.h"
+
+#define PERIOD 1003            // us between interrupts
+#define MAXLATENCY 2000        // cycles
+
+Sema4Type Event;
+uint64_t Armed;                // Host_Cycles() when the timer was started
+uint32_t Signals, Wakes;
+uint64_t Total, Most;          // cycles of latency
+
+// ******** event ************
+// Periodic ISR, signals the waiting thread
+// Inputs:  none
+// Outputs: none
+void static event(void){
+  Signals++;
+  OS_Signal(&Event);
+}
+
+void Waiter(void){
+  uint64_t due, latency;
+  while(1){
+    OS_Wait(&Event);
+    due = Armed + (uint64_t)(Wakes + 1)*PERIOD*HOST_CYCLESPERUS;
+    latency = Host_Cycles() - due;
+    Wakes++;
+    Total += latency;
+    if(latency > Most){
+      Most = latency;
+    }
+  }
+}
+
+uint32_t BusyCount;
+void Busy(void){
+  while(1){
+    BusyCount++;
+  }
+}
+
+int static check(void){
+  int bad;
+  printf("interrupt to thread %u signals, %u wakeups, %.1f cycles average, %llu most, bound %d\n",
+    Signals, Wakes, Wakes ? (double)Total/Wakes : 0.0, (unsigned long long)Most, MAXLATENCY);
+  bad = (Wakes + 1 < Signals)||(Wakes < 1000)||(Most > MAXLATENCY);
+  printf("%s\n", bad ? "FAILED" : "passed");
+  return bad;
+}
+
+int main(void){
+  OS_Init();
+  OS_InitSemaphore(&Event, 0);
+  OS_AddThread(&Waiter, 0, 32);
+  OS_AddThread(&Busy, 1, 32);
+  Armed = Host_Cycles();
+  BSP_PeriodicTask_InitB(&event, 1000000/PERIOD, 1);
+  Host_AtReport(&check);
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;
+}
@@ -0,0 +1,62 @@
+// mutex.c
+// Step 4 of Lab4.c as a test of priority inheritance, run on the Linux
+// host, see Host.h
+// main_step4 runs unchanged: TaskS at priority 0 takes MutexSU every
+// 10 ms, TaskT at priority 3 computes 30 ms out of every 50 ms and
+// TaskU at priority 6 holds MutexSU for 3 ms at a time. The check fails
+// if TaskS waited longer than MAXWAITS of Lab4.c for the mutex, if it
+// missed its period or if TaskU starved.
+// Built with -DSEMAPHORE, Lab4.c takes MutexSU with a plain binary
+// semaphore, so TaskT runs ahead of TaskU while TaskS waits. That run
+// must fail the same check, or the check could not catch a kernel
+// without inheritance; it prints passed when it does.
+//
+// Build and run from Host_Linux, see the Makefile
+//   make build/mutex build/mutex_semaphore && build/mutex
+
+#include <stdio.h>
+#include <stdint.h>
+#include "os.h"
+#include "Host.h"
+#undef main
+
+#define MAXWAITS 3500          // us, as in Lab4.c
+#define PERIODS (HOST_RUNTIME/10000) // TaskS signals in the run
+
+extern uint32_t MaxBlockS, LateS;
+extern int32_t CountS, CountT, CountU;
+int main_step4(void);
+
+#ifdef SEMAPHORE
+Sema4Type Plain;               // stands in for MutexSU, no inheritance
+int SemaphoreLock(MutexType *mutex){
+  OS_Wait(&Plain);
+  return 1;
+}
+int SemaphoreUnlock(MutexType *mutex){
+  OS_Signal(&Plain);
+  return 1;
+}
+#endif
+
+int static check(void){
+  int late;
+  printf("TaskS %d runs, TaskT %d, TaskU %d\n", CountS, CountT, CountU);
+  printf("TaskS waited for MutexSU %u us most, %u times over %d us\n", MaxBlockS, LateS, MAXWAITS);
+  late = (LateS != 0)||(MaxBlockS > MAXWAITS)||(CountS + 2 < PERIODS)||(CountU == 0);
+#ifdef SEMAPHORE
+  printf("%s\n", late ? "passed, without inheritance the check fails" : "FAILED, the check missed the inversion");
+  return !late;
+#else
+  printf("%s\n", late ? "FAILED" : "passed");
+  return late;
+#endif
+}
+
+int main(void){
+#ifdef SEMAPHORE
+  OS_InitSemaphore(&Plain, 1);
+#endif
+  Host_AtReport(&check);
+  return main_step4();
+}
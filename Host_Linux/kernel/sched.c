@@ -0,0 +1,145 @@
+// sched.c
+// Cost of one Scheduler call of the Lab4 kernel at 8, 32 and 128
+// threads, for the CLZ scheduler of os.c and the linear scan it
+// replaced, run on the Linux host in simulated cycles, see Host.h
+// The linear scan is the Scheduler of the original Lab4 os.c: it walks
+// the whole TCB ring every time and keeps the highest priority thread
+// that is neither blocked nor sleeping. Each case is timed with
+//  - 4 threads ready at one priority, the rest blocked, as when most
+//    threads wait on semaphores or sleep
+//  - every thread ready, at priorities 0 to 31 in turn
+// and both schedulers must pick a thread of the same priority on
+// every call. A whole switch adds the PendSV entry, save and restore
+// and exit to either, HOST_ENTRYCYCLES+HOST_SWITCHCYCLES+HOST_EXITCYCLES.
+//
+// Build and run from Host_Linux, see the Makefile
+//   make build/sched && build/sched
+
+#include <stdio.h>
+#define NUMTHREADS 128
+#include "os.c"
+#include "Host.h"
+
+#define CALLS 1000             // Scheduler calls per measurement
+
+Sema4Type Never;               // threads that are not ready wait on it
+uint32_t Visited;              // TCBs looked at by linearscheduler
+
+// ******** linearscheduler ************
+// Scheduler of Lab4 before the ready lists, counting TCBs visited
+// Inputs:  none
+// Outputs: none
+void static linearscheduler(void){
+  uint32_t maxprio = 255;
+  tcbType *tempPt;
+  tcbType *bestPt = RunPt;
+  tempPt = RunPt;
+  do {
+    tempPt = tempPt->next;
+    Visited++;
+    if(((tempPt->priority) < maxprio) && (tempPt->blocked == 0) && (tempPt->sleep == 0)) {
+      maxprio = tempPt->priority;
+      bestPt = tempPt;
+    }
+  } while (RunPt != tempPt);
+  RunPt = bestPt;
+}
+
+void static nothing(void){
+}
+
+// ******** setup ************
+// Put n threads in the TCB ring, of which ready (0 for all) are ready
+// Inputs:  n, threads
+//          ready, threads ready at priority 10, spread over the ring
+// Outputs: none
+void static setup(uint32_t n, uint32_t ready){
+  uint32_t i;
+  ReadyBitmap = 0;
+  for(i=0; i<NUMPRIORITY; i++){
+    ReadyList[i] = 0;
+  }
+  for(i=0; i<n; i++){
+    tcbs[i].next = &tcbs[(i+1)%n];
+    tcbs[i].sleep = 0;
+    if(ready == 0){
+      tcbs[i].priority = i%NUMPRIORITY;
+      tcbs[i].blocked = 0;
+    } else{
+      tcbs[i].priority = 10;
+      tcbs[i].blocked = (i%(n/ready) == 0) ? 0 : &Never;
+    }
+    if(tcbs[i].blocked == 0){
+      addready(&tcbs[i]);
+    }
+  }
+  RunPt = &tcbs[n-1];
+}
+
+// ******** measure ************
+// Average simulated cycles of one call, without the calling loop
+// Inputs:  scheduler to call CALLS times
+// Outputs: cycles per call
+double static measure(void(*scheduler)(void)){
+  uint64_t start, loop;
+  int i;
+  start = Host_Cycles();
+  for(i=0; i<CALLS; i++){
+    nothing();
+  }
+  loop = Host_Cycles() - start;
+  start = Host_Cycles();
+  for(i=0; i<CALLS; i++){
+    scheduler();
+  }
+  return (double)(Host_Cycles() - start - loop)/CALLS;
+}
+
+// ******** agree ************
+// Both schedulers pick a thread of the same priority, call after call
+// Inputs:  n, threads set up
+// Outputs: number of calls where they differ
+uint32_t static agree(uint32_t n){
+  uint32_t i, wrong = 0;
+  tcbType *linear;
+  for(i=0; i<CALLS; i++){
+    linearscheduler();
+    linear = RunPt;
+    Scheduler();
+    if(RunPt->priority != linear->priority){
+      wrong++;
+    }
+  }
+  return wrong;
+}
+
+int main(void){
+  uint32_t threads[3] = {8, 32, 128};
+  uint32_t ready[2] = {4, 0};
+  uint32_t t, r, visited, wrong = 0;
+  double linear, clz, most = 0, least = 1e9;
+  printf("threads  ready      linear scan          CLZ\n");
+  printf("                 TCBs   cycles        cycles\n");
+  for(r=0; r<2; r++){
+    for(t=0; t<3; t++){
+      setup(threads[t], ready[r]);
+      Visited = 0;
+      linear = measure(linearscheduler);
+      visited = Visited/CALLS;
+      setup(threads[t], ready[r]);
+      clz = measure(Scheduler);
+      setup(threads[t], ready[r]);
+      wrong += agree(threads[t]);
+      printf("%5u   %5u   %5u  %7.1f       %7.1f\n", threads[t], ready[r] ? ready[r] : threads[t],
+        visited, linear, clz);
+      if(clz > most) most = clz;
+      if(clz < least) least = clz;
+    }
+  }
+  printf("a switch adds %d cycles to either\n", HOST_ENTRYCYCLES+HOST_SWITCHCYCLES+HOST_EXITCYCLES);
+  printf("%u calls picked a different priority\n", wrong);
+  if(most > least){
+    printf("CLZ scheduler cost depends on the threads\n");
+  }
+  return (wrong || (most > least)) ? 1 : 0;
+}
@@ -0,0 +1,225 @@
+// sema.c
+// Stress test of the semaphores of the Lab3 and Lab4 kernels, run on
+// the Linux host, see Host.h
+// Producers pass numbered items to consumers through a bounded buffer
+// guarded by the counting semaphores Items and Space and the binary
+// semaphore Lock, doing a varying amount of work between items, so
+// every thread blocks on all three while others are preempted inside
+// their critical sections. Consumers check that the items of each
+// producer come out in order, none lost or repeated.
+// A periodic ISR signals Gate, on which more threads queue. Before each
+// signal it finds the thread that has waited longest from the tickets
+// the waiters take as they block, and checks that this is the thread
+// the signal wakes, so the wait queues are FIFO.
+//  - Lab 4, 16 threads: 5 producers, 5 consumers, 4 waiters on Gate
+//    at a higher priority and an idle thread
+//  - Lab 3, 6 threads: 2 producers, 2 consumers, 1 waiter on Gate and
+//    a thread that never blocks, and one consumer waits on Items with
+//    a 1 ms timeout, so threads also leave the middle of a wait queue
+// At the end the report gives the longest time interrupts were
+// disabled, which must stay under MAXMASKED cycles however many
+// threads wait on a semaphore.
+//
+// Build and run from Host_Linux, see the Makefile
+//   make build/sema build/sema_lab3 && build/sema && build/sema_lab3
+
+#include <stdio.h>
+#ifndef LAB3
+#define NUMTHREADS 16
+#endif
+#include "os.c"
+#include "Host.h"
+
+#ifdef LAB3
+#define PRODUCERS 2
+#define CONSUMERS 2
+#define WAITERS   1
+#else
+#define PRODUCERS 5
+#define CONSUMERS 5
+#define WAITERS   4
+#endif
+#define BUFSIZE   8            // items in the buffer
+#define MAXMASKED 400          // cycles, bound on any critical section
+
+Sema4Type Items, Space, Lock, Gate;
+uint32_t Buffer[BUFSIZE];      // producer in bits 31-24, sequence number below
+uint32_t BufPut, BufGet;
+uint32_t Produced, Consumed, Timeouts, OrderErrors;
+uint32_t Next[PRODUCERS];      // next sequence number expected from each producer
+uint32_t Seed[PRODUCERS+CONSUMERS];
+
+tcbType *Waiter[WAITERS];      // TCB of each Gate waiter, once it has run
+uint32_t Ticket[WAITERS];      // order in which each started its current wait
+uint32_t Tickets, Wakeups, FifoErrors;
+
+// ******** work ************
+// A pseudo-random amount of computing, up to about 100 basic blocks
+// Inputs:  seed of the calling thread
+// Outputs: none
+void static work(uint32_t *seed){
+  volatile uint32_t n;
+  *seed = 1664525*(*seed) + 1013904223;
+  for(n = (*seed)>>25; n > 0; n--){
+  }
+}
+
+void static produce(uint32_t id){
+  uint32_t seq = 0;
+  while(1){
+    work(&Seed[id]);
+    OS_Wait(&Space);
+    OS_Wait(&Lock);
+    Buffer[BufPut] = (id<<24)|(seq&0x00FFFFFF);
+    BufPut = (BufPut + 1)%BUFSIZE;
+    Produced++;
+    OS_Signal(&Lock);
+    OS_Signal(&Items);
+    seq++;
+  }
+}
+
+// ******** waititems ************
+// Wait for an item, with a timeout for the first Lab 3 consumer
+// Inputs:  id of the calling thread
+// Outputs: 1 if an item was taken, 0 if the wait expired
+int static waititems(uint32_t id){
+#ifdef LAB3
+  if(id == PRODUCERS){
+    return OS_WaitTimeout(&Items, 1);
+  }
+#endif
+  OS_Wait(&Items);
+  return 1;
+}
+
+void static consume(uint32_t id){
+  uint32_t item, from;
+  while(1){
+    if(waititems(id) == 0){
+      Timeouts++;
+      continue;
+    }
+    OS_Wait(&Lock);
+    item = Buffer[BufGet];
+    BufGet = (BufGet + 1)%BUFSIZE;
+    Consumed++;
+    from = item>>24;
+    if((item&0x00FFFFFF) != (Next[from]&0x00FFFFFF)){
+      OrderErrors++;
+    }
+    Next[from] = (item&0x00FFFFFF) + 1;
+    OS_Signal(&Lock);
+    OS_Signal(&Space);
+    work(&Seed[id]);
+  }
+}
+
+void static waitgate(uint32_t k){
+  Waiter[k] = RunPt;
+  while(1){
+    DisableInterrupts();       // OS_Wait queues it before interrupts are enabled
+    Ticket[k] = Tickets;
+    Tickets++;
+    OS_Wait(&Gate);
+  }
+}
+
+// ******** gate ************
+// Periodic ISR, signals Gate and checks the longest waiter is woken
+// Inputs:  none
+// Outputs: none
+void static gate(void){
+  int k, first = -1;
+  for(k=0; k<WAITERS; k++){
+    if(Waiter[k] && (Waiter[k]->blocked == &Gate)){
+      if((first < 0)||(Ticket[k] < Ticket[first])){
+        first = k;
+      }
+    }
+  }
+  OS_Signal(&Gate);
+  if(first >= 0){
+    Wakeups++;
+    if(Waiter[first]->blocked != 0){
+      FifoErrors++;
+    }
+  }
+}
+
+void Producer0(void){ produce(0); }
+void Producer1(void){ produce(1); }
+void Consumer0(void){ consume(PRODUCERS); }
+void Consumer1(void){ consume(PRODUCERS+1); }
+void Waiter0(void){ waitgate(0); }
+#ifndef LAB3
+void Producer2(void){ produce(2); }
+void Producer3(void){ produce(3); }
+void Producer4(void){ produce(4); }
+void Consumer2(void){ consume(PRODUCERS+2); }
+void Consumer3(void){ consume(PRODUCERS+3); }
+void Consumer4(void){ consume(PRODUCERS+4); }
+void Waiter1(void){ waitgate(1); }
+void Waiter2(void){ waitgate(2); }
+void Waiter3(void){ waitgate(3); }
+#endif
+uint32_t IdleCount;
+void Idle(void){
+  while(1){
+    IdleCount++;
+#ifndef LAB3
+    WaitForInterrupt();
+#endif
+  }
+}
+
+int static check(void){
+  uint64_t masked = Host_MaxMasked();
+  int bad;
+  printf("items               %u produced, %u consumed, %u out of order or lost\n",
+    Produced, Consumed, OrderErrors);
+#ifdef LAB3
+  printf("Items timeouts      %u\n", Timeouts);
+#endif
+  printf("Gate wakeups        %u checked, %u not the longest waiter\n", Wakeups, FifoErrors);
+  printf("longest masked      %llu cycles, bound %d\n", (unsigned long long)masked, MAXMASKED);
+  bad = (OrderErrors != 0)||(FifoErrors != 0)||(Produced - Consumed > BUFSIZE)||
+        (Consumed < 1000)||(Wakeups < 1000)||(masked > MAXMASKED);
+  printf("%s\n", bad ? "FAILED" : "passed");
+  return bad;
+}
+
+int main(void){
+  uint32_t i;
+  OS_Init();
+  for(i=0; i<PRODUCERS+CONSUMERS; i++){
+    Seed[i] = i + 1;
+  }
+  OS_InitSemaphore(&Items, 0);
+  OS_InitSemaphore(&Space, BUFSIZE);
+  OS_InitSemaphore(&Lock, 1);
+  OS_InitSemaphore(&Gate, 0);
+#ifdef LAB3
+  OS_AddThreads(&Producer0, &Producer1, &Consumer0, &Consumer1, &Waiter0, &Idle);
+#else
+  OS_AddThread(&Waiter0, 1, 32);
+  OS_AddThread(&Waiter1, 1, 32);
+  OS_AddThread(&Waiter2, 1, 32);
+  OS_AddThread(&Waiter3, 1, 32);
+  OS_AddThread(&Producer0, 2, 32);
+  OS_AddThread(&Consumer0, 2, 32);
+  OS_AddThread(&Producer1, 2, 32);
+  OS_AddThread(&Consumer1, 2, 32);
+  OS_AddThread(&Producer2, 2, 32);
+  OS_AddThread(&Consumer2, 2, 32);
+  OS_AddThread(&Producer3, 2, 32);
+  OS_AddThread(&Consumer3, 2, 32);
+  OS_AddThread(&Producer4, 2, 32);
+  OS_AddThread(&Consumer4, 2, 32);
+  OS_AddThread(&Idle, 3, 32);
+#endif
+  BSP_PeriodicTask_InitC(&gate, 1000, 1);
+  Host_AtReport(&check);
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;
+}
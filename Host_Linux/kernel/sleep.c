@@ -0,0 +1,96 @@
+// sleep.c
+// Time the 1 ms sleep tick of the Lab3 kernel, run on the Linux host,
+// see Host.h
+// The tick is runsleep in os.c, on BSP_PeriodicTask_InitB, so its
+// cycles per run are the BSP_PeriodicTaskB line of the report.
+// SLEEPERS of the 6 threads sleep in a loop, for 1, 2, 3, 5 and 7 ms,
+// the others only count and never block, so there is always a thread
+// to run. Built with -DSWEEP the kernel runs with the tick and OS_Sleep
+// it had before the sleep list: a sweep over every TCB that decrements
+// each nonzero sleep count. Compare
+//   build/sweep_0 and build/sleep_0, no thread sleeping
+//   build/sweep_5 and build/sleep_5, five threads sleeping
+// The check fails if a sleeper wakes too often or too seldom for its
+// sleep time.
+//
+// Build and run from Host_Linux, see the Makefile
+//   make build/sleep_5 && build/sleep_5
+
+#include <stdio.h>
+#include "os.c"
+#include "Host.h"
+
+#ifndef SLEEPERS
+#define SLEEPERS 5
+#endif
+
+const uint32_t Period[5] = {1, 2, 3, 5, 7}; // ms each sleeper sleeps
+uint32_t Wakes[NUMTHREADS];
+
+#ifdef SWEEP
+// ******** sweep ************
+// runsleep of the original Lab3 os.c
+// Inputs:  none
+// Outputs: none
+void static sweep(void){
+// **DECREMENT SLEEP COUNTERS
+	int32_t i;
+	for (i=0;i<NUMTHREADS;i++){ if(tcbs[i].sleep != 0) {	//search for sleeping main threads
+			tcbs[i].sleep --;	//decrement sleep period by 1ms
+		}
+	}
+}
+
+// OS_Sleep of the original Lab3 os.c
+void static sweepsleep(uint32_t sleepTime){
+	RunPt->sleep = sleepTime;
+	OS_Suspend();
+}
+#define SLEEP(ms) sweepsleep(ms)
+#else
+#define SLEEP(ms) OS_Sleep(ms)
+#endif
+
+void static thread(uint32_t k){
+  while(1){
+    Wakes[k]++;
+    if(k < SLEEPERS){
+      SLEEP(Period[k]);
+    }
+  }
+}
+
+void Thread0(void){ thread(0); }
+void Thread1(void){ thread(1); }
+void Thread2(void){ thread(2); }
+void Thread3(void){ thread(3); }
+void Thread4(void){ thread(4); }
+void Thread5(void){ thread(5); }
+
+int static check(void){
+  uint32_t k, most, least;
+  int bad = 0;
+  for(k=0; k<SLEEPERS; k++){
+    // each wakeup takes its sleep and up to one more ms, to the next
+    // tick, and one time slice at most before it runs
+    most = HOST_RUNTIME/1000/Period[k] + 1;
+    least = HOST_RUNTIME/1000/(Period[k] + 2);
+    printf("Thread%u sleeps %u ms  %6u wakeups, %u to %u expected\n", k, Period[k], Wakes[k], least, most);
+    if((Wakes[k] < least)||(Wakes[k] > most)){
+      bad = 1;
+    }
+  }
+  printf("%s\n", bad ? "FAILED" : "passed");
+  return bad;
+}
+
+int main(void){
+  OS_Init();
+#ifdef SWEEP
+  BSP_PeriodicTask_InitB(&sweep, 1000, 3);
+#endif
+  OS_AddThreads(&Thread0, &Thread1, &Thread2, &Thread3, &Thread4, &Thread5);
+  Host_AtReport(&check);
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;
+}
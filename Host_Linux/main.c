@@ -0,0 +1,10 @@
+// main.c
+// Entry point of the lab programs on the Linux host
+// The lab's own main is renamed with -Dmain=LabN_main, and HOST_MAIN
+// picks which of the lab's mains runs, see the Makefile
+
+#undef main
+int HOST_MAIN(void);
+int main(void){
+  return HOST_MAIN();
+}
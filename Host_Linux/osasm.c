@@ -0,0 +1,107 @@
+// osasm.c
+// Linux host replacement for osasm.s of the Lab3 and Lab4 kernels
+// StartOS and the PendSV context switch, on top of ucontext
+// Each thread gets its own host stack, created the first time it runs,
+// from the PC that OS_AddThreads placed in its initial stack frame.
+// That PC is stored as a 32-bit word, so link with -no-pie to keep
+// code addresses below 2^31.
+// See the Makefile for how the labs are built.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <ucontext.h>
+#include "CortexM.h"
+#include "Host.h"
+
+#define HOST_NUMTHREADS  16       // more than NUMTHREADS of any kernel
+#define HOST_STACKSIZE   65536    // bytes, room for printf and the C library
+#define FRESHR4          0x04040404 // R4 in the initial frame from OS_AddThreads
+
+// same first two fields as struct tcb in os.c, which is all osasm.s uses
+struct hosttcb{
+  int32_t *sp;
+  struct hosttcb *next;
+};
+extern struct hosttcb *RunPt;
+
+struct hostthread{
+  struct hosttcb *tcb;        // thread this context belongs to
+  ucontext_t context;
+};
+struct hostthread HostThreads[HOST_NUMTHREADS];
+struct hostthread *HostCurrent; // context running
+
+// ******** threadstart ************
+// First code run by each thread, like the exception return in StartOS
+// Inputs:  none
+// Outputs: none
+void static threadstart(void){
+  void (*task)(void);
+  task = (void(*)(void))(uintptr_t)(uint32_t)RunPt->sp[14]; // PC of the initial frame
+  EnableInterrupts();         // tasks run with interrupts enabled
+  task();
+  printf("thread returned\n");
+  Host_Report();
+}
+
+// ******** newthread ************
+// Point a host context at threadstart, reusing its host stack
+// Marks the initial frame as used, so a TCB given a new thread after
+// OS_Kill can be told apart from one that has already started
+// Inputs:  pointer to a host context
+// Outputs: none
+void static newthread(struct hostthread *thread){
+  void *stack = thread->context.uc_stack.ss_sp;
+  if(stack == 0){
+    stack = malloc(HOST_STACKSIZE);
+  }
+  getcontext(&thread->context);
+  thread->context.uc_stack.ss_sp = stack;
+  thread->context.uc_stack.ss_size = HOST_STACKSIZE;
+  thread->context.uc_link = 0;
+  sigemptyset(&thread->context.uc_sigmask);
+  makecontext(&thread->context, threadstart, 0);
+  thread->tcb->sp[0] = 0;     // R4 popped, as PendSV_Handler would
+}
+
+// ******** findthread ************
+// Host context of a TCB, making a new one the first time
+// Inputs:  pointer to a TCB
+// Outputs: pointer to its context
+struct hostthread static *findthread(struct hosttcb *tcb){
+  int i;
+  for(i=0; i<HOST_NUMTHREADS; i++){
+    if(HostThreads[i].tcb == tcb){
+      if(tcb->sp[0] == FRESHR4){
+        newthread(&HostThreads[i]); // TCB reused by OS_AddThread
+      }
+      return &HostThreads[i];
+    }
+  }
+  for(i=0; i<HOST_NUMTHREADS; i++){
+    if(HostThreads[i].tcb == 0){
+      HostThreads[i].tcb = tcb;
+      newthread(&HostThreads[i]);
+      return &HostThreads[i];
+    }
+  }
+  printf("more than %d threads\n", HOST_NUMTHREADS);
+  exit(1);
+}
+
+void StartOS(void){
+  Host_Start();
+  HostCurrent = findthread(RunPt);
+  setcontext(&HostCurrent->context);
+}
+
+void Host_PendSV(void){
+  struct hostthread *old = HostCurrent;
+  if(RunPt != old->tcb){
+    Host_Switched();
+    HostCurrent = findthread(RunPt);
+    swapcontext(&old->context, &HostCurrent->context);
+  }
+}
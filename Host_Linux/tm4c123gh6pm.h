@@ -0,0 +1,27 @@
+// tm4c123gh6pm.h
+// Linux host version, only the registers the kernels touch
+// They are plain memory in BSP.c, so Port D never interrupts
+
+#include <stdint.h>
+
+extern volatile uint32_t HostGPIOD[13];
+extern volatile uint32_t HostSYSCTL[2];
+extern volatile uint32_t HostNVIC[2];
+
+#define GPIO_PORTD_RIS_R        HostGPIOD[0]
+#define GPIO_PORTD_IS_R         HostGPIOD[1]
+#define GPIO_PORTD_IBE_R        HostGPIOD[2]
+#define GPIO_PORTD_IEV_R        HostGPIOD[3]
+#define GPIO_PORTD_IM_R         HostGPIOD[4]
+#define GPIO_PORTD_ICR_R        HostGPIOD[5]
+#define GPIO_PORTD_DIR_R        HostGPIOD[6]
+#define GPIO_PORTD_AFSEL_R      HostGPIOD[7]
+#define GPIO_PORTD_PUR_R        HostGPIOD[8]
+#define GPIO_PORTD_DEN_R        HostGPIOD[9]
+#define GPIO_PORTD_AMSEL_R      HostGPIOD[10]
+#define GPIO_PORTD_PCTL_R       HostGPIOD[11]
+#define GPIO_PORTD_DATA_R       HostGPIOD[12]
+#define SYSCTL_RCGCGPIO_R       HostSYSCTL[0]
+#define SYSCTL_PRGPIO_R         HostSYSCTL[1]
+#define NVIC_EN0_R              HostNVIC[0]
+#define NVIC_PRI0_R             HostNVIC[1]
@@ -0,0 +1,224 @@
+// cyclic.c
+// Cyclic executive table generator for the periodic event threads
+// Runs on the Linux host, not part of the host port of the kernels
+// Given the periods of the periodic tasks, in ticks, it finds the
+// hyperperiod, picks a release offset for each task that keeps the
+// busiest tick as light as possible, and prints a header with one
+// const table per set of periods. Bit i of a table entry is set when
+// task i (the order they are listed, which is the order they are
+// added) runs on that tick, so the tick ISR is a single lookup. The
+// tables are static, so the header is included by one file only, the
+// kernel or main that runs the tick.
+//
+// Build and run from the repository root, e.g. for Lab 3
+//   gcc -O2 Host_Linux/tools/cyclic.c -o cyclic
+//   ./cyclic 1,100 10,100 > Lab3_4C123/schedule.h
+// Each argument is one set of periods. A period may be followed by
+// the run time of the task in us, as in 1:50,100:400, to weigh the
+// tasks by their cost instead of counting them.
+// The worst case load of each set, with and without the offsets, is
+// printed on stderr.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAXTASKS       8      // bits in a table entry
+#define MAXSETS        8      // sets of periods in one header
+#define MAXHYPERPERIOD 10000  // ticks, the table is one byte per tick
+
+struct set{
+  uint32_t numTasks;
+  uint32_t period[MAXTASKS];  // ticks
+  uint32_t work[MAXTASKS];    // cost of one run, 1 if not given
+  uint32_t offset[MAXTASKS];  // first tick the task runs on
+  uint32_t hyperperiod;
+  char text[128];             // argument as given
+};
+struct set Sets[MAXSETS];
+uint32_t NumSets;
+uint32_t Load[MAXHYPERPERIOD]; // work released on each tick
+
+uint32_t static gcd(uint32_t a, uint32_t b){
+  uint32_t t;
+  while(b){
+    t = a%b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+// ******** parse ************
+// Read one set of periods, like 1,100 or 1:50,100:400
+// Inputs:  argument, pointer to the set to fill
+// Outputs: none, exits on a bad argument
+void static parse(char *arg, struct set *s){
+  char *pt = arg;
+  uint64_t hyper = 1;
+  snprintf(s->text, sizeof(s->text), "%s", arg);
+  s->numTasks = 0;
+  while(*pt){
+    if(s->numTasks == MAXTASKS){
+      fprintf(stderr, "%s: more than %d tasks\n", arg, MAXTASKS);
+      exit(1);
+    }
+    s->period[s->numTasks] = strtoul(pt, &pt, 10);
+    s->work[s->numTasks] = 1;
+    if(*pt == ':'){
+      s->work[s->numTasks] = strtoul(pt+1, &pt, 10);
+    }
+    if((s->period[s->numTasks] == 0)||((*pt != ',')&&(*pt != 0))){
+      fprintf(stderr, "%s: expected period[:us],period[:us],...\n", arg);
+      exit(1);
+    }
+    hyper = hyper/gcd(hyper, s->period[s->numTasks])*s->period[s->numTasks];
+    if(hyper > MAXHYPERPERIOD){
+      fprintf(stderr, "%s: hyperperiod over %d ticks\n", arg, MAXHYPERPERIOD);
+      exit(1);
+    }
+    s->numTasks++;
+    if(*pt == ','){
+      pt++;
+    }
+  }
+  s->hyperperiod = (uint32_t)hyper;
+}
+
+// ******** peak ************
+// Load of the busiest tick if a task were added at an offset
+// Inputs:  set, task, offset to try
+// Outputs: worst load in work units, sum of squares in *spread
+uint32_t static peak(struct set *s, uint32_t task, uint32_t offset, uint64_t *spread){
+  uint32_t t, load, worst = 0;
+  *spread = 0;
+  for(t=0; t<s->hyperperiod; t++){
+    load = Load[t];
+    if((t%s->period[task]) == offset){
+      load = load + s->work[task];
+    }
+    if(load > worst){
+      worst = load;
+    }
+    *spread = *spread + (uint64_t)load*load;
+  }
+  return worst;
+}
+
+// ******** place ************
+// Choose offsets one task at a time, most work first, each at the
+// offset that keeps the peak lowest, then the load most even
+// Inputs:  set
+// Outputs: worst case load of one tick
+uint32_t static place(struct set *s){
+  uint32_t order[MAXTASKS], i, j, k, t, offset, best, worst;
+  uint64_t spread, bestSpread;
+  for(i=0; i<s->numTasks; i++){
+    order[i] = i;
+  }
+  for(i=1; i<s->numTasks; i++){ // insertion sort by work, then period
+    k = order[i];
+    for(j=i; j>0; j--){
+      if((s->work[order[j-1]] > s->work[k])||
+        ((s->work[order[j-1]] == s->work[k])&&(s->period[order[j-1]] <= s->period[k]))){
+        break;
+      }
+      order[j] = order[j-1];
+    }
+    order[j] = k;
+  }
+  memset(Load, 0, sizeof(Load));
+  for(i=0; i<s->numTasks; i++){
+    k = order[i];
+    best = 0; bestSpread = 0; s->offset[k] = 0;
+    for(offset=0; offset<s->period[k]; offset++){
+      worst = peak(s, k, offset, &spread);
+      if((offset == 0)||(worst < best)||((worst == best)&&(spread < bestSpread))){
+        best = worst;
+        bestSpread = spread;
+        s->offset[k] = offset;
+      }
+    }
+    for(t=s->offset[k]; t<s->hyperperiod; t=t+s->period[k]){
+      Load[t] = Load[t] + s->work[k];
+    }
+  }
+  worst = 0;
+  for(t=0; t<s->hyperperiod; t++){
+    if(Load[t] > worst){
+      worst = Load[t];
+    }
+  }
+  return worst;
+}
+
+int main(int argc, char **argv){
+  struct set *s;
+  uint32_t i, n, t, tasks, worst, together;
+  if((argc < 2)||(argc > MAXSETS+1)){
+    fprintf(stderr, "usage: %s period[:us],... [period[:us],...] ... > schedule.h\n", argv[0]);
+    return 1;
+  }
+  NumSets = argc-1;
+  printf("// schedule.h\n");
+  printf("// Cyclic executive tables for the periodic event threads\n");
+  printf("// Generated by Host_Linux/tools/cyclic.c, do not edit\n");
+  printf("//  ");
+  for(i=0; i<(uint32_t)argc; i++){
+    printf(" %s", i ? argv[i] : "cyclic");
+  }
+  printf("\n\n");
+  printf("#ifndef __SCHEDULE_H\n");
+  printf("#define __SCHEDULE_H  1\n");
+  printf("#include <stdint.h>\n\n");
+  printf("struct schedule{\n");
+  printf("  uint32_t numTasks;      // periodic tasks, in the order they are added\n");
+  printf("  const uint32_t *period; // ticks between runs of each task\n");
+  printf("  uint32_t hyperperiod;   // ticks before the table repeats\n");
+  printf("  const uint8_t *tick;    // bit i set if task i runs on this tick\n");
+  printf("};\n");
+  for(n=0; n<NumSets; n++){
+    s = &Sets[n];
+    parse(argv[n+1], s);
+    together = 0;
+    for(i=0; i<s->numTasks; i++){
+      together = together + s->work[i]; // every task released on tick 0
+    }
+    worst = place(s);
+    fprintf(stderr, "%s: hyperperiod %u ticks, worst tick load %u, %u with no offsets\n",
+      s->text, s->hyperperiod, worst, together);
+    printf("\n// periods %s, worst tick load %u\n", s->text, worst);
+    printf("static const uint32_t SchedulePeriod%u[%u] = {", n, s->numTasks);
+    for(i=0; i<s->numTasks; i++){
+      printf("%s%u", i ? ", " : "", s->period[i]);
+    }
+    printf("};\n");
+    printf("// offsets");
+    for(i=0; i<s->numTasks; i++){
+      printf(" %u", s->offset[i]);
+    }
+    printf("\n");
+    printf("static const uint8_t ScheduleTick%u[%u] = {", n, s->hyperperiod);
+    for(t=0; t<s->hyperperiod; t++){
+      tasks = 0;
+      for(i=0; i<s->numTasks; i++){
+        if((t%s->period[i]) == s->offset[i]){
+          tasks |= 1u<<i;
+        }
+      }
+      printf("%s0x%02X%s", (t%16) ? " " : "\n ", tasks, (t == s->hyperperiod-1) ? "" : ",");
+    }
+    printf("\n};\n");
+    printf("static const struct schedule Schedule%u = {%u, SchedulePeriod%u, %u, ScheduleTick%u};\n",
+      n, s->numTasks, n, s->hyperperiod, n);
+  }
+  printf("\n#define NUMSCHEDULES %u\n", NumSets);
+  printf("static const struct schedule *const Schedules[NUMSCHEDULES] = {");
+  for(n=0; n<NumSets; n++){
+    printf("%s&Schedule%u", n ? ", " : "", n);
+  }
+  printf("};\n");
+  printf("\n#endif\n");
+  return 0;
+}
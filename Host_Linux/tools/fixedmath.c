@@ -0,0 +1,288 @@
+// fixedmath.c
+// Test of inc/FixedMath.c against reference versions, run on the
+// Linux host with the C versions of the Cortex M4 instructions
+// 1) FixedMath_Sqrt for every input below 2^24, perfect squares and
+//    their neighbours up to 2^32-1, and random inputs, along with
+//    sqrt32 of the labs and how many Newton steps each takes
+// 2) FixedMath_Divide with random divisors and dividends, n*d < 2^32
+// 3) FixedMath_EWMA, FixedMath_RMS at every alignment and length,
+//    and the Q15/Q31 functions against 64-bit arithmetic
+// 4) The streaming RMS over random windows, fed one sample at a time
+//    and in blocks of random length and alignment, against the RMS,
+//    mean and peak of each window
+// Times per call are for the host, the header has the M4 cycles.
+//
+// Build and run from the repository root
+//   gcc -O2 -Iinc Host_Linux/tools/fixedmath.c inc/FixedMath.c -lm -o fixedmath
+//   ./fixedmath
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "FixedMath.h"
+
+#define RANDOM 10000000       // random inputs per test
+
+uint32_t Errors;
+uint32_t Steps;               // divides in the last square root
+
+// UDIV of the M4, which gives 0 for a divide by 0
+uint32_t static udiv(uint32_t n, uint32_t d){
+  return d ? n/d : 0;
+}
+
+// Newton's method, as in Lab1.c to Lab6.c
+uint32_t sqrt32(uint32_t s){
+uint32_t t;   // t*t will become s
+int n;             // loop counter
+  t = s/16+1;      // initial guess
+  for(n = 16; n; --n){ // will finish
+    t = udiv(t*t+s, t)/2;
+  }
+  return t;
+}
+
+// FixedMath_Sqrt again, counting its divides
+uint32_t static countsqrt(uint32_t s){
+  uint32_t k, t, u;
+  Steps = 0;
+  if(s == 0){
+    return 0;
+  }
+  k = (33 - __builtin_clz(s))/2;
+  t = 1<<k;
+  u = (t + (s>>k))/2;
+  while(u < t){
+    t = u;
+    u = (t + s/t)/2;
+    Steps++;
+  }
+  return t;
+}
+
+// 1 if r is sqrt(s) rounded down
+int static issqrt(uint32_t s, uint32_t r){
+  return ((uint64_t)r*r <= s)&&((uint64_t)(r+1)*(r+1) > s);
+}
+
+uint32_t static random32(void){
+  return ((uint32_t)rand()<<16)^(uint32_t)rand();
+}
+
+double static now(void){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+void static check(int ok, const char *what, int64_t a, int64_t b){
+  if(!ok){
+    if(Errors < 10){
+      printf("  %s wrong for %lld, %lld\n", what, (long long)a, (long long)b);
+    }
+    Errors++;
+  }
+}
+
+uint32_t In[RANDOM];
+volatile uint32_t Sink;
+
+void static sqrttest(void){
+  uint32_t s, r, oldwrong = 0, oldwrongsmall = 0, maxsteps = 0;
+  uint64_t steps = 0;
+  double t0, told, tnew;
+  int i;
+  for(s=0; s<(1<<24); s++){
+    r = FixedMath_Sqrt(s);
+    check(issqrt(s, r), "FixedMath_Sqrt", s, r);
+    if(!issqrt(s, sqrt32(s))){
+      oldwrong++;
+      oldwrongsmall += (s < 3139588);  // 3*1023^2, the largest magnitude
+    }
+  }
+  for(r=1; r<65536; r++){
+    for(s=r*r-1; s<=r*r+1; s++){
+      check(issqrt(s, FixedMath_Sqrt(s)), "FixedMath_Sqrt", s, 0);
+    }
+  }
+  check(FixedMath_Sqrt(0xFFFFFFFF) == 65535, "FixedMath_Sqrt", 0xFFFFFFFF, 0);
+  for(i=0; i<RANDOM; i++){
+    In[i] = random32()>>(i%32);       // spread over every length
+    check(issqrt(In[i], countsqrt(In[i])), "FixedMath_Sqrt", In[i], 0);
+    steps += Steps;
+    if(Steps > maxsteps){
+      maxsteps = Steps;
+    }
+  }
+  t0 = now();
+  for(i=0; i<RANDOM; i++){
+    Sink = sqrt32(In[i]);
+  }
+  told = now() - t0;
+  t0 = now();
+  for(i=0; i<RANDOM; i++){
+    Sink = FixedMath_Sqrt(In[i]);
+  }
+  tnew = now() - t0;
+  printf("sqrt: divides per call %.2f average, %u most, sqrt32 takes 16\n",
+    (double)steps/RANDOM, maxsteps);
+  printf("      sqrt32 wrong below 2^24 for %u inputs, %u of them below 3*1023^2\n",
+    oldwrong, oldwrongsmall);
+  printf("      host %.1f ns per call, sqrt32 %.1f ns\n", tnew*1e9/RANDOM, told*1e9/RANDOM);
+}
+
+void static dividetest(void){
+  uint32_t d, n, r;
+  int i;
+  for(i=0; i<RANDOM; i++){
+    d = 2 + random32()%((i&1) ? 1000 : 0x7FFFFFFF);
+    n = random32()%(0xFFFFFFFF/d + 1);
+    r = FixedMath_Reciprocal(d);
+    check(FixedMath_Divide(n, r) == n/d, "FixedMath_Divide", n, d);
+  }
+  printf("divide: %u random dividends and divisors\n", RANDOM);
+}
+
+int16_t Samples[1002];
+
+void static rmstest(void){
+  uint32_t avg, x, alpha, n, start, k, got;
+  int32_t mean;
+  double sum;
+  double t0;
+  int i;
+  for(i=0; i<RANDOM; i++){
+    avg = random32()%(1<<21);
+    x = random32()%(1<<21);
+    alpha = random32()%1025;
+    check(FixedMath_EWMA(avg, x, alpha) == (uint32_t)floor((avg*(1024.0-alpha) + x*(double)alpha)/1024),
+      "FixedMath_EWMA", avg, x);
+  }
+  for(i=0; i<100000; i++){
+    start = i%2;
+    n = 1 + random32()%1000;
+    mean = random32()%1024;
+    for(k=0; k<n; k++){
+      Samples[start+k] = (i%3) ? random32()%1024 : ((k&1) ? 1023 : 0);  // microphone range
+    }
+    sum = 0;
+    for(k=0; k<n; k++){
+      sum += (double)(Samples[start+k] - mean)*(Samples[start+k] - mean);
+    }
+    got = FixedMath_RMS(&Samples[start], n, mean);
+    check(got == FixedMath_Sqrt((uint32_t)floor(sum/n)), "FixedMath_RMS", n, mean);
+  }
+  t0 = now();
+  for(i=0; i<10000; i++){
+    Sink = FixedMath_RMS(&Samples[i%2], 1000, 512);
+  }
+  printf("ewma, rms: %u and 100000 random cases, host %.2f ns per RMS sample\n",
+    RANDOM, (now() - t0)*1e9/10000/1000);
+}
+
+#define STREAM 2000000        // samples per streaming test
+uint16_t Stream[STREAM+1];
+
+// 1 if the results of w are those of window k of the stream
+int static windowok(struct rmswindow *w, uint32_t start, uint32_t k){
+  uint64_t n = w->window, sum = 0, squares = 0, variance;
+  uint32_t i, x, min = 0xFFFF, max = 0;
+  for(i=k*n; i<(k+1)*n; i++){
+    x = Stream[start+i];
+    sum += x;
+    squares += x*x;
+    min = (x < min) ? x : min;
+    max = (x > max) ? x : max;
+  }
+  variance = (n*squares - sum*sum)/(n*n);
+  return (w->mean == sum/n)&&issqrt(variance, w->rms)&&(w->peak == max - min);
+}
+
+void static streamtest(void){
+  struct rmswindow one, block;
+  uint32_t start, window, k, i, n, windows, got;
+  double t0, tone, tblock;
+  int run;
+  for(run=0; run<40; run++){
+    start = run%2;
+    window = (run < 4) ? run + 1 : 1 + random32()%((run%3) ? 2000 : 65535);
+    for(i=0; i<STREAM; i++){
+      Stream[start+i] = (run%2) ? random32()%1024 : random32()%32768;
+    }
+    FixedMath_RMSInit(&one, window);
+    FixedMath_RMSInit(&block, window);
+    windows = 0;
+    for(i=0; i<STREAM; i++){
+      if(FixedMath_RMSAdd(&one, Stream[start+i])){
+        check(windowok(&one, start, windows), "FixedMath_RMSAdd", window, windows);
+        windows++;
+      }
+    }
+    k = 0;
+    for(i=0; i<STREAM; i=i+n){
+      n = (run%4 == 0) ? 8 : random32()%(2*window + 3);
+      if(n > STREAM - i){
+        n = STREAM - i;
+      }
+      got = FixedMath_RMSAddBlock(&block, &Stream[start+i], n);
+      k = k + got;
+      if(got){
+        check(windowok(&block, start, k-1), "FixedMath_RMSAddBlock", window, k);
+      }
+    }
+    check((k == windows)&&(k == STREAM/window), "FixedMath_RMSAddBlock windows", window, k);
+  }
+  FixedMath_RMSInit(&one, 1000);
+  FixedMath_RMSInit(&block, 1000);
+  t0 = now();
+  for(i=0; i<STREAM; i++){
+    Sink = FixedMath_RMSAdd(&one, Stream[i]);
+  }
+  tone = now() - t0;
+  t0 = now();
+  for(i=0; i<STREAM; i=i+8){
+    Sink = FixedMath_RMSAddBlock(&block, &Stream[i], 8);
+  }
+  tblock = now() - t0;
+  printf("stream: 40 runs of %u samples, host %.2f ns per sample, %.2f in blocks of 8\n",
+    STREAM, tone*1e9/STREAM, tblock*1e9/STREAM);
+}
+
+int32_t static sat(int64_t x, int bits){
+  int64_t max = ((int64_t)1<<(bits-1)) - 1;
+  return (x > max) ? max : (x < -max-1) ? -max-1 : x;
+}
+
+void static qtest(void){
+  int32_t a, b;
+  int i;
+  for(i=0; i<RANDOM; i++){
+    a = (i < 4) ? INT32_MIN + (i&1) : random32();
+    b = (i < 4) ? INT32_MIN + (i>>1) : random32();
+    check(FixedMath_Q31Add(a, b) == sat((int64_t)a + b, 32), "FixedMath_Q31Add", a, b);
+    check(FixedMath_Q31Mul(a, b) == sat(((int64_t)a*b)>>31, 32), "FixedMath_Q31Mul", a, b);
+    check(FixedMath_Q15Sat(a) == sat(a, 16), "FixedMath_Q15Sat", a, 0);
+    check(FixedMath_USat12(a) == ((a < 0) ? 0 : (a > 4095) ? 4095 : a), "FixedMath_USat12", a, 0);
+    a = (int16_t)a;
+    b = (int16_t)b;
+    if(i < 4){
+      a = -32768 + (i&1);
+      b = -32768 + (i>>1);
+    }
+    check(FixedMath_Q15Add(a, b) == sat(a + b, 16), "FixedMath_Q15Add", a, b);
+    check(FixedMath_Q15Mul(a, b) == sat((a*b)>>15, 16), "FixedMath_Q15Mul", a, b);
+  }
+  printf("q15, q31: %u random pairs and the -1 corners\n", RANDOM);
+}
+
+int main(void){
+  sqrttest();
+  dividetest();
+  rmstest();
+  qtest();
+  streamtest();
+  printf("%u errors\n", Errors);
+  return Errors != 0;
+}
@@ -0,0 +1,268 @@
+// steps.c
+// Replay of accelerometer traces through the step counter in
+// inc/StepCount.c, run on the Linux host
+// Each trace is fed to StepCount_AddBlock in batches, and to the loop
+// of Task2 of Lab4.c as it was before StepCount.c, which must count
+// the same steps on the same magnitudes once its local min starts
+// over at NOMIN and its average keeps KEEP/1024 of the old one, as in
+// StepCount.c. The traces that the loop as it was, from 1024 and with
+// 1023/1024, counts differently are reported too. For each trace
+// it prints the steps counted, the steps taken if the trace gives
+// them, the accuracy, and the magnitudes per second the counter
+// runs at on the host.
+//
+// With no trace files it replays walks made up here: a stride at a
+// cadence that drifts, one peak of Z per stride, noise on every axis,
+// at 10, 25, 50 and 100 samples per second, and a standing still
+// trace of noise alone that should count no steps. One stride is two
+// steps.
+//
+// A trace file has one sample per line, x y z as returned by
+// BSP_Accelerometer_Input. Lines starting with # are comments, except
+//   # rate <samples per second>
+//   # steps <steps taken>
+// The tuning is that of the labs, for 10 samples per second, scaled
+// to the rate of each trace unless given:
+//   -a ALPHA  -c LOCALCOUNTTARGET  -o AVGOVERSHOOT
+//
+// Build and run from the repository root
+//   gcc -O2 -Iinc Host_Linux/tools/steps.c inc/StepCount.c inc/FixedMath.c -lm -o steps
+//   ./steps [-a alpha] [-c count] [-o overshoot] [trace ...]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "FixedMath.h"
+#include "StepCount.h"
+
+#define MAXSAMPLES 1000000
+#define BATCH      32           // magnitudes per StepCount_AddBlock
+// tuning of the labs at 10 samples per second
+#define ALPHA            128
+#define LOCALCOUNTTARGET 5
+#define AVGOVERSHOOT     25
+#define NOMIN     0xFFFFFFFF    // local min before a magnitude, 1024 in Lab4.c
+#define KEEP      1024          // weight of the old average, 1023 in Lab4.c
+
+uint16_t Magnitude[MAXSAMPLES];
+uint16_t Events[BATCH];
+uint32_t NumSamples;
+uint32_t Rate;                  // samples per second of the trace
+int32_t Taken;                  // steps taken, -1 if not known
+int32_t Alpha = -1, Count = -1, Overshoot = -1;  // from the command line
+uint32_t Mismatches, Traces, Differ;
+
+// The step counter of Task2 of Lab4.c, with the average started by
+// the first magnitude as Task1_Init did, the tuning passed in, the
+// local min starting over at nomin and the average keeping keep/1024
+uint32_t static reference(const uint16_t *magnitude, uint32_t n, uint32_t alpha, uint32_t target, uint32_t overshoot,
+  uint32_t nomin, uint32_t keep){
+  enum stepstate algorithmState = LookingForMax;
+  uint32_t localMin = nomin, localMax = 0, localCount = 0, steps = 0;
+  uint32_t EWMA = magnitude[0], Magnitude, i;
+  for(i=0; i<n; i++){
+    Magnitude = magnitude[i];
+    EWMA = (alpha*Magnitude + (keep - alpha)*EWMA)/1024;
+    if(algorithmState == LookingForMax){
+      if(Magnitude > localMax){
+        localMax = Magnitude;
+        localCount = 0;
+      } else{
+        localCount = localCount + 1;
+        if(localCount >= target){
+          algorithmState = LookingForCross1;
+        }
+      }
+    } else if(algorithmState == LookingForCross1){
+      if(Magnitude > localMax){
+        localMax = Magnitude;
+        localCount = 0;
+        algorithmState = LookingForMax;
+      } else if(Magnitude < (EWMA - overshoot)){
+        steps = steps + 1;
+        localMin = nomin;
+        localCount = 0;
+        algorithmState = LookingForMin;
+      }
+    } else if(algorithmState == LookingForMin){
+      if(Magnitude < localMin){
+        localMin = Magnitude;
+        localCount = 0;
+      } else{
+        localCount = localCount + 1;
+        if(localCount >= target){
+          algorithmState = LookingForCross2;
+        }
+      }
+    } else if(algorithmState == LookingForCross2){
+      if(Magnitude < localMin){
+        localMin = Magnitude;
+        localCount = 0;
+        algorithmState = LookingForMin;
+      } else if(Magnitude > (EWMA + overshoot)){
+        steps = steps + 1;
+        localMax = 0;
+        localCount = 0;
+        algorithmState = LookingForMax;
+      }
+    }
+  }
+  return steps;
+}
+
+void static addsample(uint32_t x, uint32_t y, uint32_t z){
+  if(NumSamples < MAXSAMPLES){
+    Magnitude[NumSamples] = FixedMath_Sqrt(x*x + y*y + z*z);
+    NumSamples++;
+  }
+}
+
+// 10-bit reading, limited like the ADC
+uint32_t static adc(double v){
+  return (v < 0) ? 0 : (v > 1023) ? 1023 : (uint32_t)v;
+}
+
+double static noise(double amplitude){
+  return amplitude*(2.0*rand()/RAND_MAX - 1);
+}
+
+// A walk of 'seconds' at 'cadence' strides per second, drifting by
+// up to 10%, with Z swinging by 'swing', X and Y by swing/8, and
+// noise of 'jitter' on each
+void static walk(uint32_t rate, double cadence, double seconds, double swing, double jitter){
+  double phase = 0, f, t;
+  uint32_t i;
+  NumSamples = 0;
+  Rate = rate;
+  for(i=0; i<seconds*rate; i++){
+    t = (double)i/rate;
+    f = cadence*(1 + 0.1*sin(2*M_PI*t/20));
+    addsample(adc(512 + swing/8*sin(phase + 1) + noise(jitter)),
+              adc(512 - swing/8*sin(phase/2) + noise(jitter)),
+              adc(700 + swing*sin(phase) + noise(jitter)));
+    phase += 2*M_PI*f/rate;
+  }
+  Taken = 2*(int32_t)(phase/(2*M_PI));
+}
+
+int static load(const char *name){
+  char line[128];
+  uint32_t x, y, z, n;
+  FILE *f = fopen(name, "r");
+  if(f == 0){
+    perror(name);
+    return -1;
+  }
+  NumSamples = 0;
+  Rate = 10;
+  Taken = -1;
+  while(fgets(line, sizeof(line), f)){
+    if(line[0] == '#'){
+      if(sscanf(line, "# rate %u", &n) == 1){
+        Rate = n;
+      } else if(sscanf(line, "# steps %u", &n) == 1){
+        Taken = n;
+      }
+    } else if(sscanf(line, "%u %u %u", &x, &y, &z) == 3){
+      addsample(x, y, z);
+    }
+  }
+  fclose(f);
+  return 0;
+}
+
+double static now(void){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec*1e-9;
+}
+
+// Run the counter over the trace loaded and print one line
+void static replay(const char *name){
+  struct stepcounter counter;
+  uint32_t alpha, target, overshoot, i, n, got, steps = 0, last = 0, reps, r;
+  double t0, rate;
+  alpha = (Alpha >= 0) ? Alpha : (ALPHA*10 + Rate/2)/Rate;
+  target = (Count >= 0) ? Count : (LOCALCOUNTTARGET*Rate + 5)/10;
+  overshoot = (Overshoot >= 0) ? Overshoot : AVGOVERSHOOT;
+  if(alpha > 1023){
+    alpha = 1023;
+  }
+  StepCount_Init(&counter, alpha, target, overshoot);
+  for(i=0; i<NumSamples; i=i+n){
+    n = (NumSamples - i < BATCH) ? NumSamples - i : BATCH;
+    got = StepCount_AddBlock(&counter, &Magnitude[i], n, Events);
+    steps = steps + got;
+    if(got){
+      if((Events[got-1] >= n)||(i + Events[0] < last)){
+        Mismatches++;             // events out of the batch or out of order
+      }
+      last = i + Events[got-1];
+    }
+  }
+  if((steps != counter.steps)||(NumSamples && (steps != reference(Magnitude, NumSamples, alpha, target, overshoot, NOMIN, KEEP)))){
+    Mismatches++;
+  }
+  Traces++;
+  if(NumSamples && (steps != reference(Magnitude, NumSamples, alpha, target, overshoot, 1024, 1023))){
+    Differ++;
+  }
+  reps = 1 + 20000000/(NumSamples + 1);
+  t0 = now();
+  for(r=0; r<reps; r++){
+    StepCount_Init(&counter, alpha, target, overshoot);
+    StepCount_AddBlock(&counter, Magnitude, NumSamples, 0);
+  }
+  rate = reps*(double)NumSamples/(now() - t0);
+  printf("%-26s %4u Hz  alpha %4u count %3u over %3u  %6u steps", name, Rate, alpha, target, overshoot, steps);
+  if(Taken > 0){
+    printf(" of %6d, %5.1f%%", Taken, 100.0*steps/Taken);
+  } else if(Taken == 0){
+    printf(" of      0        ");
+  } else{
+    printf("                  ");
+  }
+  printf("  %6.1fM/s\n", rate/1e6);
+}
+
+int main(int argc, char **argv){
+  static const uint32_t rates[] = {10, 25, 50, 100};
+  int i, files = 0;
+  for(i=1; i<argc; i++){
+    if((strcmp(argv[i], "-a") == 0)&&(i+1 < argc)){
+      Alpha = atoi(argv[++i]);
+    } else if((strcmp(argv[i], "-c") == 0)&&(i+1 < argc)){
+      Count = atoi(argv[++i]);
+    } else if((strcmp(argv[i], "-o") == 0)&&(i+1 < argc)){
+      Overshoot = atoi(argv[++i]);
+    } else if(load(argv[i]) == 0){
+      replay(argv[i]);
+      files++;
+    }
+  }
+  if(files == 0){
+    for(i=0; i<4; i++){
+      srand(1);
+      walk(rates[i], 1.0, 600, 150, 10);
+      replay("walk 1.0 strides/s");
+      srand(1);
+      walk(rates[i], 2.0, 600, 150, 10);
+      replay("walk 2.0 strides/s");
+      srand(1);
+      walk(rates[i], 1.0, 600, 60, 30);
+      replay("weak, noisy walk 1.0");
+      srand(1);
+      walk(rates[i], 1.0, 600, 0, 10);
+      Taken = 0;
+      replay("standing still");
+    }
+  }
+  printf("%u mismatches with the step counter of Task2 of Lab4.c, its local min from 0x%X, average keeping %u/1024\n",
+    Mismatches, NOMIN, KEEP);
+  printf("%u of %u traces counted differently with its local min from 1024, average keeping 1023/1024\n",
+    Differ, Traces);
+  return Mismatches != 0;
+}
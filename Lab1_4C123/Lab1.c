@@ -93,8 +93,9 @@
 #include "Profile.h"
 #include "Texas.h"
 #include "CortexM.h"
-
-uint32_t sqrt32(uint32_t s);
+#include "schedule.h"
+#include "FixedMath.h"
+#include "StepCount.h"
 
 //---------------- Global variables shared between tasks ----------------
 uint32_t Time;              // elasped time in seconds
@@ -147,7 +148,6 @@ void Task0(void){
   static int32_t soundSum = 0;
   static int time = 0;// units of microphone sampling rate
   int32_t soundAvg;
-  int i;
   TExaS_Task0();     // record system time in array, toggle virtual logic analyzer
   Profile_Toggle0(); // viewed by the logic analyzer to know Task0 started
   BSP_Microphone_Input(&SoundData);
@@ -157,11 +157,7 @@ void Task0(void){
   if(time == SOUNDRMSLENGTH){
     time = 0;
     soundAvg = soundSum/SOUNDRMSLENGTH;
-    soundSum = 0;
-    for(i=0; i<SOUNDRMSLENGTH; i=i+1){
-      soundSum = soundSum + (SoundArray[i] - soundAvg)*(SoundArray[i] - soundAvg);
-    }
-    SoundRMS = sqrt32(soundSum/SOUNDRMSLENGTH);
+    SoundRMS = FixedMath_RMS(SoundArray, SOUNDRMSLENGTH, soundAvg);
     soundSum = 0;
   }
 }
@@ -172,18 +168,7 @@ void Task0(void){
 //---------------- Task1 measures acceleration ----------------
 uint16_t AccX, AccY, AccZ;  // returned by BSP as 10-bit numbers
 #define ALPHA 128           // The degree of weighting decrease, a constant smoothing factor between 0 and 1,023. A higher ALPHA discounts older observations faster.
-                            // basic step counting algorithm is based on a forum post from
-                            // http://stackoverflow.com/questions/16392142/android-accelerometer-profiling/16539643#16539643
-enum state{                 // the step counting algorithm cycles through four states
-  LookingForMax,            // looking for a local maximum in current magnitude
-  LookingForCross1,         // looking for current magnitude to cross average magnitude, minus a constant
-  LookingForMin,            // looking for a local minimum in current magnitude
-  LookingForCross2          // looking for current magnitude to cross average magnitude, plus a constant
-};
-enum state AlgorithmState = LookingForMax;
-uint32_t LocalMin = 1024;   // smallest measured magnitude since odd-numbered step detected
-uint32_t LocalMax = 0;      // largest measured magnitude since even-numbered step detected
-uint32_t LocalCount = 0;    // number of measured magnitudes above local min or below local max
+struct stepcounter StepCounter; // steps and average of the magnitudes
 #define LOCALCOUNTTARGET 5  // The number of valid measured magnitudes needed to confirm a local min or local max.  Increase this number for longer strides or more frequent measurements.
 #define AVGOVERSHOOT 25     // The amount above or below average a measurement must be to count as "crossing" the average.  Increase this number to reject increasingly hard shaking as steps.
 // *********Task1_Init*********
@@ -195,9 +180,10 @@ void Task1_Init(void){
   BSP_Accelerometer_Init();
   // initialize the exponential weighted moving average filter
   BSP_Accelerometer_Input(&AccX, &AccY, &AccZ);
-  Magnitude = sqrt32(AccX*AccX + AccY*AccY + AccZ*AccZ);
+  Magnitude = FixedMath_Sqrt(AccX*AccX + AccY*AccY + AccZ*AccZ);
   EWMA = Magnitude;                // this is a guess; there are many options
   Steps = 0;
+  StepCount_Init(&StepCounter, ALPHA, LOCALCOUNTTARGET, AVGOVERSHOOT);
 }
 // *********Task1*********
 // collects data from accelerometer
@@ -209,56 +195,10 @@ void Task1(void){
   Profile_Toggle1(); // viewed by the logic analyzer to know Task1 started
 
   BSP_Accelerometer_Input(&AccX, &AccY, &AccZ);
-  Magnitude = sqrt32(AccX*AccX + AccY*AccY + AccZ*AccZ);
-  EWMA = (ALPHA*Magnitude + (1023 - ALPHA)*EWMA)/1024;
-
-  if(AlgorithmState == LookingForMax){
-    if(Magnitude > LocalMax){
-      LocalMax = Magnitude;
-      LocalCount = 0;
-    } else{
-      LocalCount = LocalCount + 1;
-      if(LocalCount >= LOCALCOUNTTARGET){
-        AlgorithmState = LookingForCross1;
-      }
-    }
-  } else if(AlgorithmState == LookingForCross1){
-    if(Magnitude > LocalMax){
-      // somehow measured a very large magnitude
-      LocalMax = Magnitude;
-      LocalCount = 0;
-      AlgorithmState = LookingForMax;
-    } else if(Magnitude < (EWMA -  AVGOVERSHOOT)){
-      // step detected
-      Steps = Steps + 1;
-      LocalMin = 1024;
-      LocalCount = 0;
-      AlgorithmState = LookingForMin;
-    }
-  } else if(AlgorithmState == LookingForMin){
-    if(Magnitude < LocalMin){
-      LocalMin = Magnitude;
-      LocalCount = 0;
-    } else{
-      LocalCount = LocalCount + 1;
-      if(LocalCount >= LOCALCOUNTTARGET){
-        AlgorithmState = LookingForCross2;
-      }
-    }
-  } else if(AlgorithmState == LookingForCross2){
-    if(Magnitude < LocalMin){
-      // somehow measured a very small magnitude
-      LocalMin = Magnitude;
-      LocalCount = 0;
-      AlgorithmState = LookingForMin;
-    } else if(Magnitude > (EWMA + AVGOVERSHOOT)){
-      // step detected
-      Steps = Steps + 1;
-      LocalMax = 0;
-      LocalCount = 0;
-      AlgorithmState = LookingForMax;
-    }
-  }
+  Magnitude = FixedMath_Sqrt(AccX*AccX + AccY*AccY + AccZ*AccZ);
+  StepCount_Add(&StepCounter, Magnitude);
+  EWMA = StepCounter.ewma;
+  Steps = StepCounter.steps;
 }
 /* ****************************************** */
 /*          End of Task1 Section              */
@@ -349,7 +289,7 @@ void Task3(void){
   }
   prev2 = current;
   // update the LED
-  switch(AlgorithmState){
+  switch(StepCounter.state){
     case LookingForMax: BSP_RGB_Set(500, 0, 0); break;
     case LookingForCross1: BSP_RGB_Set(350, 350, 0); break;
     case LookingForMin: BSP_RGB_Set(0, 500, 0); break;
@@ -464,8 +404,12 @@ void Task5(void){
 /*          End of Task5 Section              */
 /* ****************************************** */
 
+// The tasks run in each 1 ms pass come from a table in schedule.h,
+// made by Host_Linux/tools/cyclic.c for periods of 1, 100 and 1000 ms.
+// Its offsets keep the 100 ms and 1 s tasks off the same pass.
 int main(void){
-	static int counter = 0;	//AleGaa
+	uint32_t counter = 0;	//index into ScheduleTick0
+	uint8_t tasks;	//bit 0 every 1 ms, bit 1 every 100 ms, bit 2 every 1 s
   DisableInterrupts();
   BSP_Clock_InitFastest();
   Profile_Init();               // initialize the 7 hardware profiling pins
@@ -481,14 +425,17 @@ int main(void){
   Time = 0;
   EnableInterrupts(); // interrupts needed for grader to run
   while(1){
-		Task0();  // sample microphone		
-		if((counter % 100) == 0) //100 ms task
+		tasks = ScheduleTick0[counter];
+		if(tasks & 0x01){
+			Task0();  // sample microphone
+		}
+		if(tasks & 0x02) //100 ms task
 		{
 			Task1();  // sample accelerometer
       Task3();  // check the buttons and change mode if pressed
       Task4();  // update the plot
 		}	
-		if((counter % 1000) == 0) //1 s task
+		if(tasks & 0x04) //1 s task
 		{
 			Task2();   // sample light at 1 Hz
 			Task5();   // update the LCD text at 1 Hz
@@ -496,24 +443,10 @@ int main(void){
 			Profile_Toggle6();			
 		}
 		counter ++;
+		if(counter == Schedule0.hyperperiod){
+			counter = 0;
+		}
 		BSP_Delay1ms(1);
   }
 
 }
-
-// Newton's method
-// s is an integer
-// sqrt(s) is an integer
-uint32_t sqrt32(uint32_t s){
-uint32_t t;   // t*t will become s
-int n;             // loop counter
-  t = s/16+1;      // initial guess
-  for(n = 16; n; --n){ // will finish
-    t = ((t*t+s)/t)/2;
-  }
-  return t;
-}
-
-
-
-
@@ -158,11 +158,21 @@ int OS_AddPeriodicEventThreads(void(*thread1)(void), uint32_t period1,
 void OS_Launch(uint32_t theTimeSlice){
   STCTRL = 0;                  // disable SysTick during setup
   STCURRENT = 0;               // any write to current clears it
-  SYSPRI3 =(SYSPRI3&0x00FFFFFF)|0xE0000000; // priority 7
+  SYSPRI3 =(SYSPRI3&0x0000FFFF)|0xE0E00000; // priority 7, SysTick and PendSV
   STRELOAD = theTimeSlice - 1; // reload value
   STCTRL = 0x00000007;         // enable, core clock and interrupt arm
   StartOS();                   // start on the first task
 }
+
+//******** SysTick_Handler ***************
+// Time slice interrupt, only requests a thread switch
+// The switch itself runs in PendSV_Handler (osasm.s) at the lowest
+// priority, after every other pending interrupt has finished
+// Inputs: none
+// Outputs: none
+void SysTick_Handler(void){
+  INTCTRL = 0x10000000; // trigger PendSV
+}
 // runs every ms in this project
 void Scheduler(void){ // every time slice
 // ROUND ROBIN
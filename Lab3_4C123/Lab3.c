@@ -34,13 +34,14 @@
  */
 
 #include <stdint.h>
-#include "../inc/BSP.h"
-#include "../inc/CortexM.h"
+#include "BSP.h"
+#include "CortexM.h"
 #include "os.h"
-#include "../inc/Profile.h"
+#include "Profile.h"
 #include "Texas.h"
+#include "FixedMath.h"
+#include "StepCount.h"
 
-uint32_t sqrt32(uint32_t s);
 #define THREADFREQ 1000   // frequency in Hz of round robin scheduler
 #define BUZZLEVEL	512	//Buzzer PWM duty cycle
 
@@ -57,9 +58,9 @@ uint32_t SoundRMS;          // Root Mean Square average of most recent sound sam
 uint32_t LightData;         // 100 lux
 int32_t TemperatureData;    // 0.1C
 // semaphores
-int32_t NewData;  // true when new numbers to display on top of LCD
-int32_t LCDmutex; // exclusive access to LCD
-int32_t I2Cmutex; // exclusive access to I2C
+Sema4Type NewData;  // true when new numbers to display on top of LCD
+Sema4Type LCDmutex; // exclusive access to LCD
+Sema4Type I2Cmutex; // exclusive access to I2C
 int ReDrawAxes = 0;         // non-zero means redraw axes on next display task
 
 enum plotstate{
@@ -83,8 +84,13 @@ enum plotstate PlotState = Accelerometer;
 
 //---------------- Task0 samples sound from microphone ----------------
 // Event thread run by OS in real time at 1000 Hz
-#define SOUNDRMSLENGTH 1000 // number of samples to collect before calculating RMS (may overflow if greater than 4104)
-int16_t SoundArray[SOUNDRMSLENGTH];
+// Event threads run in the periodic interrupt of the OS, so they can
+// not block on a semaphore while the ADC converts. Task0 and Task1
+// instead start a conversion at the end of each run and collect it at
+// the start of the next, so no run spins on the ADC; each sample is
+// one period old, still taken exactly every period.
+#define SOUNDRMSLENGTH 1000 // number of samples in each RMS result, 1 to 65535
+struct rmswindow Sound;     // running sums of the microphone samples
 // *********Task0_Init*********
 // initializes microphone
 // Task0 measures sound intensity
@@ -93,6 +99,8 @@ int16_t SoundArray[SOUNDRMSLENGTH];
 void Task0_Init(void){
   BSP_Microphone_Init();
   SoundRMS = 0;
+  FixedMath_RMSInit(&Sound, SOUNDRMSLENGTH);
+  BSP_Microphone_Start();  // for the first run of Task0
 }
 // *********Task0*********
 // Periodic event thread runs in real time at 1000 Hz
@@ -100,21 +108,14 @@ void Task0_Init(void){
 // Inputs:  none
 // Outputs: none
 void Task0(void){
-  static int32_t soundSum = 0;
-  static int time = 0;// units of microphone sampling rate
-
   TExaS_Task0();     // record system time in array, toggle virtual logic analyzer
   Profile_Toggle0(); // viewed by a real logic analyzer to know Task0 started
-  BSP_Microphone_Input(&SoundData);
-  soundSum = soundSum + (int32_t)SoundData;
-  SoundArray[time] = SoundData;
-  time = time + 1;
-  if(time == SOUNDRMSLENGTH){
-    SoundAvg = soundSum/SOUNDRMSLENGTH;
-    soundSum = 0;
+  if(BSP_Microphone_End(&SoundData) && FixedMath_RMSAdd(&Sound, SoundData)){
+    SoundAvg = Sound.mean;
+    SoundRMS = Sound.rms;
     OS_Signal(&NewData); // makes task5 run every 1 sec
-    time = 0;
   }
+  BSP_Microphone_Start();  // collected by the next run
 }
 /* ****************************************** */
 /*          End of Task0 Section              */
@@ -125,15 +126,7 @@ void Task0(void){
 uint32_t LostTask1Data;     // number of times that the FIFO was full when acceleration data was ready
 uint16_t AccX, AccY, AccZ;  // returned by BSP as 10-bit numbers
 #define ALPHA 128           // The degree of weighting decrease, a constant smoothing factor between 0 and 1,023. A higher ALPHA discounts older observations faster.
-                            // basic step counting algorithm is based on a forum post from
-                            // http://stackoverflow.com/questions/16392142/android-accelerometer-profiling/16539643#16539643
-enum state{                 // the step counting algorithm cycles through four states
-  LookingForMax,            // looking for a local maximum in current magnitude
-  LookingForCross1,         // looking for current magnitude to cross average magnitude, minus a constant
-  LookingForMin,            // looking for a local minimum in current magnitude
-  LookingForCross2          // looking for current magnitude to cross average magnitude, plus a constant
-};
-enum state AlgorithmState = LookingForMax;
+struct stepcounter StepCounter; // steps and average of the magnitudes
 #define LOCALCOUNTTARGET 5  // The number of valid measured magnitudes needed to confirm a local min or local max.  Increase this number for longer strides or more frequent measurements.
 #define AVGOVERSHOOT 25     // The amount above or below average a measurement must be to count as "crossing" the average.  Increase this number to reject increasingly hard shaking as steps.
 // *********Task1_Init*********
@@ -145,10 +138,11 @@ void Task1_Init(void){
   BSP_Accelerometer_Init();
   // initialize the exponential weighted moving average filter
   BSP_Accelerometer_Input(&AccX, &AccY, &AccZ);
-  Magnitude = sqrt32(AccX*AccX + AccY*AccY + AccZ*AccZ);
+  Magnitude = FixedMath_Sqrt(AccX*AccX + AccY*AccY + AccZ*AccZ);
   EWMA = Magnitude;                // this is a guess; there are many options
   Steps = 0;
   LostTask1Data = 0;
+  BSP_Accelerometer_Start();  // for the first run of Task1
 }
 // *********Task1*********
 // collects data from accelerometer
@@ -158,11 +152,13 @@ void Task1(void){uint32_t squared;
   TExaS_Task1();     // records system time in array, toggles virtual logic analyzer
   Profile_Toggle1(); // viewed by a real logic analyzer to know Task1 started
 
-  BSP_Accelerometer_Input(&AccX, &AccY, &AccZ);
-  squared = AccX*AccX + AccY*AccY + AccZ*AccZ;
-  if(OS_FIFO_Put(squared) == -1){  // makes Task2 run every 100ms
-    LostTask1Data = LostTask1Data + 1;
+  if(BSP_Accelerometer_End(&AccX, &AccY, &AccZ)){
+    squared = AccX*AccX + AccY*AccY + AccZ*AccZ;
+    if(OS_FIFO_Put(squared) == -1){  // makes Task2 run every 100ms
+      LostTask1Data = LostTask1Data + 1;
+    }
   }
+  BSP_Accelerometer_Start();  // collected by the next run
   Time++; // in 100ms units
 }
 /* ****************************************** */
@@ -196,66 +192,16 @@ void drawaxes(void){
   OS_Signal(&LCDmutex);  ReDrawAxes = 0;
 }
 void Task2(void){uint32_t data;
-  uint32_t localMin;   // smallest measured magnitude since odd-numbered step detected
-  uint32_t localMax;   // largest measured magnitude since even-numbered step detected
-  uint32_t localCount; // number of measured magnitudes above local min or below local max
-  localMin = 1024;
-  localMax = 0;
-  localCount = 0;
+  StepCount_Init(&StepCounter, ALPHA, LOCALCOUNTTARGET, AVGOVERSHOOT);
   drawaxes();
   while(1){
     data = OS_FIFO_Get();
     TExaS_Task2();     // records system time in array, toggles virtual logic analyzer
     Profile_Toggle2(); // viewed by a real logic analyzer to know Task2 started
-    Magnitude = sqrt32(data);
-    EWMA = (ALPHA*Magnitude + (1023 - ALPHA)*EWMA)/1024;
-    if(AlgorithmState == LookingForMax){
-      if(Magnitude > localMax){
-        localMax = Magnitude;
-        localCount = 0;
-      } else{
-        localCount = localCount + 1;
-        if(localCount >= LOCALCOUNTTARGET){
-          AlgorithmState = LookingForCross1;
-        }
-      }
-    } else if(AlgorithmState == LookingForCross1){
-      if(Magnitude > localMax){
-      // somehow measured a very large magnitude
-        localMax = Magnitude;
-        localCount = 0;
-        AlgorithmState = LookingForMax;
-      } else if(Magnitude < (EWMA -  AVGOVERSHOOT)){
-        // step detected
-        Steps = Steps + 1;
-        localMin = 1024;
-        localCount = 0;
-        AlgorithmState = LookingForMin;
-      }
-    } else if(AlgorithmState == LookingForMin){
-      if(Magnitude < localMin){
-        localMin = Magnitude;
-        localCount = 0;
-      } else{
-        localCount = localCount + 1;
-        if(localCount >= LOCALCOUNTTARGET){
-          AlgorithmState = LookingForCross2;
-        }
-      }
-    } else if(AlgorithmState == LookingForCross2){
-      if(Magnitude < localMin){
-      // somehow measured a very small magnitude
-        localMin = Magnitude;
-        localCount = 0;
-        AlgorithmState = LookingForMin;
-      } else if(Magnitude > (EWMA + AVGOVERSHOOT)){
-        // step detected
-        Steps = Steps + 1;
-        localMax = 0;
-        localCount = 0;
-        AlgorithmState = LookingForMax;
-      }
-    }
+    Magnitude = FixedMath_Sqrt(data);
+    StepCount_Add(&StepCounter, Magnitude);
+    EWMA = StepCounter.ewma;
+    Steps = StepCounter.steps;
     if(ReDrawAxes){
       drawaxes();
       ReDrawAxes = 0;
@@ -327,7 +273,7 @@ void Task3(void){
     }
     prev2 = current;
     // update the LED
-    switch(AlgorithmState){
+    switch(StepCounter.state){
       case LookingForMax: BSP_RGB_Set(500, 0, 0); break;
       case LookingForCross1: BSP_RGB_Set(350, 350, 0); break;
       case LookingForMin: BSP_RGB_Set(0, 500, 0); break;
@@ -382,7 +328,7 @@ void Task4(void){int32_t voltData,tempData;
 // updates the text at the top and bottom of the LCD
 // Inputs:  none
 // Outputs: none
-void Task5(void){int32_t soundSum;
+void Task5(void){
   OS_Wait(&LCDmutex);
   BSP_LCD_DrawString(0,  0, "Temp=",  TOPTXTCOLOR);
   BSP_LCD_DrawString(0,  1, "Step=",  TOPTXTCOLOR);
@@ -393,11 +339,6 @@ void Task5(void){int32_t soundSum;
     OS_Wait(&NewData);
     TExaS_Task5();     // records system time in array, toggles virtual logic analyzer
     Profile_Toggle5(); // viewed by a real logic analyzer to know Task5 started
-    soundSum = 0;
-    for(int i=0; i<SOUNDRMSLENGTH; i=i+1){
-      soundSum = soundSum + (SoundArray[i] - SoundAvg)*(SoundArray[i] - SoundAvg);
-    }
-    SoundRMS = sqrt32(soundSum/SOUNDRMSLENGTH);
     OS_Wait(&LCDmutex);
     BSP_LCD_SetCursor(5,  0); BSP_LCD_OutUFix2_1(TemperatureData, TEMPCOLOR);
     BSP_LCD_SetCursor(5,  1); BSP_LCD_OutUDec4(Steps,             MAGCOLOR);
@@ -469,7 +410,7 @@ void Task7(void){
 // Remember that you must have exactly one main() function, so
 // to work on this step, you must rename all other main()
 // functions in this file.
-int32_t s1,s2;
+Sema4Type s1,s2;
 int main_step1(void){
   OS_InitSemaphore(&s1, 0);
   OS_InitSemaphore(&s2, 1);
@@ -500,7 +441,7 @@ int main_step1(void){
 // Remember that you must have exactly one main() function, so
 // to work on this step, you must rename all other main()
 // functions in this file.
-int32_t sAB,sCD,sEF;
+Sema4Type sAB,sCD,sEF;
 int32_t CountA,CountB,CountC,CountD,CountE,CountF;
 void TaskA(void){ // producer
   CountA = 0;
@@ -817,7 +758,7 @@ void TaskT(void){ // consumer as main thread
   }
 }
 int32_t CountU=0;
-int32_t sUV;
+Sema4Type sUV;
 void TaskU(void){ // event thread every 100 ms
   CountU++;
   TExaS_Task2();
@@ -1250,16 +1191,3 @@ int main(void){
 /* ****************************************** */
 /*          End of Step 6 Section             */
 /* ****************************************** */
-
-// Newton's method
-// s is an integer
-// sqrt(s) is an integer
-uint32_t sqrt32(uint32_t s){
-uint32_t t;   // t*t will become s
-int n;             // loop counter
-  t = s/16+1;      // initial guess
-  for(n = 16; n; --n){ // will finish
-    t = ((t*t+s)/t)/2;
-  }
-  return t;
-}
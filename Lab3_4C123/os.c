@@ -8,6 +8,7 @@
 #include "os.h"
 #include "CortexM.h"
 #include "BSP.h"
+#include "schedule.h"
 
 // function definitions in osasm.s
 void StartOS(void);
@@ -22,21 +23,39 @@ void static runsleep(void);
 struct tcb{
 	int32_t *sp;      // pointer to stack (valid for threads not running
 	struct tcb *next; // linked-list pointer
-	int32_t *blocked;	// pointer to blocked semaphore, nonzero if blocked on this semaphore
+	Sema4Type *blocked;	// pointer to blocked semaphore, nonzero if blocked on this semaphore
 	int32_t sleep;	// time to sleep, nonzero if this thread is sleeping
+	struct tcb *waitNext;	// next thread blocked on the same semaphore
+	uint32_t delta;	// ms to wake up after the previous thread in SleepList
+	struct tcb *sleepNext;	// doubly-linked SleepList, valid only while sleeping
+	struct tcb *sleepPrev;
+	int32_t timedOut;	// nonzero if the last OS_WaitTimeout expired
 };
 typedef struct tcb tcbType;
 tcbType tcbs[NUMTHREADS];
 tcbType *RunPt;
 int32_t Stacks[NUMTHREADS][STACKSIZE];
 
+// Sleeping threads, sorted by wakeup time. Each delta is relative to
+// the thread in front of it, so the 1 ms tick only touches the head.
+tcbType *SleepList;
+
 struct ptcb{
 	void (*task)(void);
 	uint32_t period;
-	uint32_t counter;
 };
 typedef struct ptcb ptcbType;
 ptcbType PerTask[NUMPERIODIC];
+uint32_t NumPeriodic;	// periodic event threads added
+
+// Which periodic event threads run on each 1 ms tick comes from a table
+// in schedule.h, made by Host_Linux/tools/cyclic.c for the periods used.
+// OS_Launch picks the table for the periods added, so each tick is one
+// lookup and the release offsets in it spread the threads over the ticks.
+const uint8_t NoTasks[1] = {0};
+const struct schedule NoSchedule = {0, 0, 1, NoTasks};
+const struct schedule *Schedule = &NoSchedule;	// table in use
+uint32_t Tick;	// index into Schedule->tick
 
 // ******** OS_Init ************
 // Initialize operating system, disable interrupts
@@ -134,36 +153,145 @@ int OS_AddThreads(void(*thread0)(void), // **similar to Lab 2. initialize as not
 // These threads cannot spin, block, loop, sleep, or kill
 // These threads can call OS_Signal
 // In Lab 3 this will be called exactly twice
+// The periods, in the order added, must match a table in schedule.h
 int OS_AddPeriodicEventThread(void(*thread)(void), uint32_t period){
-	int32_t static event_number = 0;
-	//int32_t frequency;
-	//frequency = 1000/period;	//in this case 1000 / 1ms = 1000 Hz
-	PerTask[event_number].task = thread;
-	PerTask[event_number].period = period;
-	PerTask[event_number].counter = 1;
-	event_number++;
+	if(NumPeriodic == NUMPERIODIC){
+		return 0;
+	}
+	PerTask[NumPeriodic].task = thread;
+	PerTask[NumPeriodic].period = period;
+	NumPeriodic++;
 	return 1;
 }
 
+// ******** findschedule ************
+// Find the table in schedule.h made for the periods that were added
+// Inputs:  none
+// Outputs: pointer to the table, 0 if schedule.h has none for them
+const struct schedule static *findschedule(void){
+	uint32_t i,n;
+	if(NumPeriodic == 0){
+		return &NoSchedule;
+	}
+	for(n=0; n<NUMSCHEDULES; n++){
+		if(Schedules[n]->numTasks == NumPeriodic){
+			for(i=0; (i<NumPeriodic)&&(Schedules[n]->period[i] == PerTask[i].period); i++){}
+			if(i == NumPeriodic){
+				return Schedules[n];
+			}
+		}
+	}
+	return 0;
+}
+
 void static runperiodicevents(void){
 // **RUN PERIODIC THREADS
-	int32_t i;
-	for (i=0;i<NUMPERIODIC;i++){	//search for periodic tasks
-		PerTask[i].counter--;
-		if(PerTask[i].counter == 0) { //it's time to launch a periodic task		
-			PerTask[i].task();
-			PerTask[i].counter = PerTask[i].period;	//reset
+	uint32_t tasks;
+	ptcbType *pt;
+	tasks = Schedule->tick[Tick];	//bit i set if PerTask[i] runs now
+	for(pt = PerTask; tasks; pt++){
+		if(tasks&0x01){
+			pt->task();
 		}
+		tasks = tasks>>1;
+	}
+	Tick++;
+	if(Tick == Schedule->hyperperiod){
+		Tick = 0;
+	}
+}
+
+// ******** insertsleep ************
+// Put a thread into SleepList, after all threads that wake up no later
+// Called with interrupts disabled
+// Inputs:  pointer to thread, number of msec to sleep (at least 1)
+// Outputs: none
+void static insertsleep(tcbType *thread, uint32_t time){
+	tcbType *pt;
+	tcbType *prevPt = 0;
+	pt = SleepList;
+	while((pt != 0)&&(pt->delta <= time)){
+		time = time - pt->delta;	//convert to a delta after pt
+		prevPt = pt;
+		pt = pt->sleepNext;
+	}
+	thread->delta = time;
+	thread->sleepPrev = prevPt;
+	thread->sleepNext = pt;
+	if(pt != 0){
+		pt->delta = pt->delta - time;	//pt now wakes up relative to thread
+		pt->sleepPrev = thread;
+	}
+	if(prevPt != 0){
+		prevPt->sleepNext = thread;
+	} else{
+		SleepList = thread;
+	}
+}
+
+// ******** removesleep ************
+// Take a thread out of SleepList before its time expires
+// Called with interrupts disabled
+// Inputs:  pointer to a sleeping thread
+// Outputs: none
+void static removesleep(tcbType *thread){
+	if(thread->sleepNext != 0){
+		thread->sleepNext->delta = thread->sleepNext->delta + thread->delta;
+		thread->sleepNext->sleepPrev = thread->sleepPrev;
+	}
+	if(thread->sleepPrev != 0){
+		thread->sleepPrev->sleepNext = thread->sleepNext;
+	} else{
+		SleepList = thread->sleepNext;
 	}
+	thread->sleep = 0;
+}
+
+// ******** removewait ************
+// Take a thread out of the wait queue of the semaphore it is blocked on
+// Used when OS_WaitTimeout expires, the semaphore gives back its count
+// Called with interrupts disabled
+// Inputs:  pointer to a blocked thread
+// Outputs: none
+void static removewait(tcbType *thread){
+	Sema4Type *semaPt;
+	tcbType *pt;
+	semaPt = thread->blocked;
+	if(semaPt->Head == thread){
+		semaPt->Head = thread->waitNext;
+	} else{
+		pt = semaPt->Head;
+		while(pt->waitNext != thread){ pt = pt->waitNext; }
+		pt->waitNext = thread->waitNext;
+		if(semaPt->Tail == thread){
+			semaPt->Tail = pt;
+		}
+	}
+	semaPt->Value = semaPt->Value + 1;
+	thread->blocked = 0;
 }
 
 void static runsleep(void){
-// **DECREMENT SLEEP COUNTERS
-	int32_t i;
-	for (i=0;i<NUMTHREADS;i++){ if(tcbs[i].sleep != 0) {	//search for sleeping main threads
-			tcbs[i].sleep --;	//decrement sleep period by 1ms
+// **WAKE UP THREADS WHOSE SLEEP EXPIRED
+	tcbType *pt;
+	long sr;
+	sr = StartCritical();	//periodic event threads may signal
+	if(SleepList != 0){
+		SleepList->delta--;	//only the head is counted down
+		while((SleepList != 0)&&(SleepList->delta == 0)){
+			pt = SleepList;
+			SleepList = pt->sleepNext;
+			if(SleepList != 0){
+				SleepList->sleepPrev = 0;
+			}
+			pt->sleep = 0;
+			if(pt->blocked != 0){	//OS_WaitTimeout expired
+				removewait(pt);
+				pt->timedOut = 1;
+			}
 		}
 	}
+	EndCritical(sr);
 }
 
 //******** OS_Launch ***************
@@ -171,14 +299,35 @@ void static runsleep(void){
 // Inputs: number of clock cycles for each time slice
 // Outputs: none (does not return)
 // Errors: theTimeSlice must be less than 16,777,216
+//         if schedule.h has no table for the periodic event threads added,
+//         it stops with the LCD red and says so
 void OS_Launch(uint32_t theTimeSlice){
+  Schedule = findschedule();
+  if(Schedule == 0){ // run Host_Linux/tools/cyclic to add these periods to schedule.h
+    BSP_LCD_Init();
+    BSP_LCD_FillScreen(LCD_RED);
+    BSP_LCD_DrawString(0, 0, "OS_Launch: periods", LCD_WHITE);
+    BSP_LCD_DrawString(0, 1, "not in schedule.h", LCD_WHITE);
+    for(;;){};     // stop, with interrupts disabled
+  }
+  Tick = 0;
   STCTRL = 0;                  // disable SysTick during setup
   STCURRENT = 0;               // any write to current clears it
-  SYSPRI3 =(SYSPRI3&0x00FFFFFF)|0xE0000000; // priority 7
+  SYSPRI3 =(SYSPRI3&0x0000FFFF)|0xE0E00000; // priority 7, SysTick and PendSV
   STRELOAD = theTimeSlice - 1; // reload value
   STCTRL = 0x00000007;         // enable, core clock and interrupt arm
   StartOS();                   // start on the first task
 }
+
+//******** SysTick_Handler ***************
+// Time slice interrupt, only requests a thread switch
+// The switch itself runs in PendSV_Handler (osasm.s) at the lowest
+// priority, after every other pending interrupt has finished
+// Inputs: none
+// Outputs: none
+void SysTick_Handler(void){
+  INTCTRL = 0x10000000; // trigger PendSV
+}
 // runs every ms in this project
 void Scheduler(void){ // every time slice
 	// ROUND ROBIN, skip blocked and sleeping threads
@@ -196,7 +345,7 @@ void Scheduler(void){ // every time slice
 // Will be run again depending on sleep/block status
 void OS_Suspend(void){
   STCURRENT = 0;        // any write to current clears it
-  INTCTRL = 0x04000000; // trigger SysTick
+  INTCTRL = 0x10000000; // trigger PendSV
 // next thread gets a full time slice
 }
 
@@ -208,7 +357,12 @@ void OS_Suspend(void){
 void OS_Sleep(uint32_t sleepTime){
 // set sleep parameter in TCB
 // suspend, stops running
-	RunPt->sleep = sleepTime;
+	DisableInterrupts();
+	if(sleepTime){
+		RunPt->sleep = sleepTime;
+		insertsleep(RunPt, sleepTime);
+	}
+	EnableInterrupts();
 	OS_Suspend();
 }
 
@@ -217,42 +371,73 @@ void OS_Sleep(uint32_t sleepTime){
 // Inputs:  pointer to a semaphore
 //          initial value of semaphore
 // Outputs: none
-void OS_InitSemaphore(int32_t *semaPt, int32_t value){
-  //Assign initial value to *semaPt
-	*semaPt = value;
+void OS_InitSemaphore(Sema4Type *semaPt, int32_t value){
+  //Assign initial value to semaphore, no threads blocked on it yet
+	semaPt->Value = value;
+	semaPt->Head = 0;
+	semaPt->Tail = 0;
 }
 
 // ******** OS_Wait ************
 // Decrement semaphore and block if less than zero
 // Lab2 spinlock (does not suspend while spinning)
-// Lab3 block if less than zero
+// Lab3 block if less than zero, blocked threads queue in FIFO order
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
-void OS_Wait(int32_t *semaPt){
+void OS_Wait(Sema4Type *semaPt){
+	OS_WaitTimeout(semaPt, 0);	//wait forever
+}
+
+// ******** OS_WaitTimeout ************
+// Decrement semaphore and block if less than zero,
+// but stop waiting after the given time
+// Inputs:  pointer to a counting semaphore
+//          maximum number of msec to wait, 0 means wait forever
+// Outputs: 1 if the semaphore was acquired, 0 if the time expired
+int OS_WaitTimeout(Sema4Type *semaPt, uint32_t timeout){
 	DisableInterrupts();
-	*semaPt = (*semaPt) - 1;
-	if(*semaPt < 0){
+	semaPt->Value = semaPt->Value - 1;
+	if(semaPt->Value < 0){
 		RunPt->blocked = semaPt;	//Point to semaphore which is blocked
+		RunPt->waitNext = 0;	//append to tail of the wait queue
+		if(semaPt->Head == 0){
+			semaPt->Head = RunPt;
+		} else{
+			semaPt->Tail->waitNext = RunPt;
+		}
+		semaPt->Tail = RunPt;
+		RunPt->timedOut = 0;
+		if(timeout){
+			RunPt->sleep = timeout;	//also sleeping, first of the two to finish wakes it
+			insertsleep(RunPt, timeout);
+		}
 		EnableInterrupts();
 		OS_Suspend();	//Switch threads by generating a systick interrupt
+		if(RunPt->timedOut){
+			return 0;
+		}
 	}
 	EnableInterrupts();
+	return 1;
 }
 
 // ******** OS_Signal ************
 // Increment semaphore
 // Lab2 spinlock
-// Lab3 wakeup blocked thread if appropriate
+// Lab3 wakeup blocked thread if appropriate, the longest waiter is woken first
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
-void OS_Signal(int32_t *semaPt){
+void OS_Signal(Sema4Type *semaPt){
 	tcbType	*threadPt;	//local thread pointer
 	DisableInterrupts();
-	(*semaPt) = (*semaPt) + 1;
-	if(*semaPt <= 0){
-		threadPt = RunPt->next;	//point to next thread
-		while((threadPt->blocked) != semaPt) {	threadPt = threadPt->next; }//search for a thread that is blocked on this semaphore
-		threadPt->blocked = 0;	//unblock 1st blocked thread found
+	semaPt->Value = semaPt->Value + 1;
+	if(semaPt->Value <= 0){
+		threadPt = semaPt->Head;	//longest waiting thread
+		semaPt->Head = threadPt->waitNext;	//remove it from the wait queue
+		threadPt->blocked = 0;	//unblock it
+		if(threadPt->sleep != 0){
+			removesleep(threadPt);	//cancel its OS_WaitTimeout
+		}
 	}
 	EnableInterrupts();
 }
@@ -261,7 +446,7 @@ void OS_Signal(int32_t *semaPt){
 uint32_t PutI;      // index of where to put next
 uint32_t GetI;      // index of where to get next
 uint32_t Fifo[FSIZE];
-int32_t CurrentSize;// 0 means FIFO empty, FSIZE means full
+Sema4Type CurrentSize;// 0 means FIFO empty, FSIZE means full
 uint32_t LostData;  // number of lost pieces of data
 
 // ******** OS_FIFO_Init ************
@@ -282,7 +467,7 @@ void OS_FIFO_Init(void){ //Init the FIFO with indexes and CurrentSize and LostDa
 // Inputs:  data to be stored
 // Outputs: 0 if successful, -1 if the FIFO is full
 int OS_FIFO_Put(uint32_t data){
-	if(CurrentSize == FSIZE) { //FIFO is full
+	if(CurrentSize.Value == FSIZE) { //FIFO is full
 		LostData++;
 		return -1; //Error
 	}
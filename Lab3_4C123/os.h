@@ -28,6 +28,16 @@
 #ifndef __OS_H
 #define __OS_H  1
 
+// counting semaphore with its own FIFO queue of blocked threads
+// Value<0 means -Value threads are waiting, Head is the longest waiter
+struct tcb;
+struct Sema4{
+  int32_t Value;      // semaphore count
+  struct tcb *Head;   // first thread blocked on this semaphore, 0 if none
+  struct tcb *Tail;   // last thread blocked on this semaphore
+};
+typedef struct Sema4 Sema4Type;
+
 
 // ******** OS_Init ************
 // Initialize operating system, disable interrupts
@@ -60,6 +70,7 @@ int OS_AddThreads(void(*thread0)(void),
 // These threads cannot spin, block, loop, sleep, or kill
 // These threads can call OS_Signal
 // In Lab 3 this will be called exactly twice
+// The periods, in the order added, must match a table in schedule.h
 int OS_AddPeriodicEventThread(void(*thread)(void), uint32_t period);
 
 //******** OS_Launch ***************
@@ -67,6 +78,8 @@ int OS_AddPeriodicEventThread(void(*thread)(void), uint32_t period);
 // Inputs: number of clock cycles for each time slice
 // Outputs: none (does not return)
 // Errors: theTimeSlice must be less than 16,777,216
+//         if schedule.h has no table for the periodic event threads added,
+//         it stops with the LCD red and says so
 void OS_Launch(uint32_t theTimeSlice);
 
 //******** OS_Suspend ***************
@@ -88,23 +101,31 @@ void OS_Sleep(uint32_t sleepTime);
 // Inputs:  pointer to a semaphore
 //          initial value of semaphore
 // Outputs: none
-void OS_InitSemaphore(int32_t *semaPt, int32_t value);
+void OS_InitSemaphore(Sema4Type *semaPt, int32_t value);
 
 // ******** OS_Wait ************
 // Decrement semaphore and block if less than zero
 // Lab2 spinlock (does not suspend while spinning)
-// Lab3 block if less than zero
+// Lab3 block if less than zero, blocked threads queue in FIFO order
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
-void OS_Wait(int32_t *semaPt);
+void OS_Wait(Sema4Type *semaPt);
+
+// ******** OS_WaitTimeout ************
+// Decrement semaphore and block if less than zero,
+// but stop waiting after the given time
+// Inputs:  pointer to a counting semaphore
+//          maximum number of msec to wait, 0 means wait forever
+// Outputs: 1 if the semaphore was acquired, 0 if the time expired
+int OS_WaitTimeout(Sema4Type *semaPt, uint32_t timeout);
 
 // ******** OS_Signal ************
 // Increment semaphore
 // Lab2 spinlock
-// Lab3 wakeup blocked thread if appropriate
+// Lab3 wakeup blocked thread if appropriate, the longest waiter is woken first
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
-void OS_Signal(int32_t *semaPt);
+void OS_Signal(Sema4Type *semaPt);
 
 // ******** OS_FIFO_Init ************
 // Initialize FIFO. 
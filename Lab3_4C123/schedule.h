@@ -0,0 +1,48 @@
+// schedule.h
+// Cyclic executive tables for the periodic event threads
+// Generated by Host_Linux/tools/cyclic.c, do not edit
+//   cyclic 1,100 10,100
+
+#ifndef __SCHEDULE_H
+#define __SCHEDULE_H  1
+#include <stdint.h>
+
+struct schedule{
+  uint32_t numTasks;      // periodic tasks, in the order they are added
+  const uint32_t *period; // ticks between runs of each task
+  uint32_t hyperperiod;   // ticks before the table repeats
+  const uint8_t *tick;    // bit i set if task i runs on this tick
+};
+
+// periods 1,100, worst tick load 2
+static const uint32_t SchedulePeriod0[2] = {1, 100};
+// offsets 0 0
+static const uint8_t ScheduleTick0[100] = {
+ 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+ 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+ 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+ 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+ 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+ 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+ 0x01, 0x01, 0x01, 0x01
+};
+static const struct schedule Schedule0 = {2, SchedulePeriod0, 100, ScheduleTick0};
+
+// periods 10,100, worst tick load 1
+static const uint32_t SchedulePeriod1[2] = {10, 100};
+// offsets 0 1
+static const uint8_t ScheduleTick1[100] = {
+ 0x01, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+ 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+ 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
+ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+ 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+ 0x00, 0x00, 0x00, 0x00
+};
+static const struct schedule Schedule1 = {2, SchedulePeriod1, 100, ScheduleTick1};
+
+#define NUMSCHEDULES 2
+static const struct schedule *const Schedules[NUMSCHEDULES] = {&Schedule0, &Schedule1};
+
+#endif
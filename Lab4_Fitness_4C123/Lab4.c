@@ -40,8 +40,9 @@
 #include "Texas.h"
 #include "CortexM.h"
 #include "os.h"
+#include "FixedMath.h"
+#include "StepCount.h"
 
-uint32_t sqrt32(uint32_t s);
 #define THREADFREQ 1000   // frequency in Hz of round robin scheduler
 
 //---------------- Global variables shared between tasks ----------------
@@ -57,9 +58,9 @@ uint32_t SoundRMS;          // Root Mean Square average of most recent sound sam
 uint32_t LightData;         // 100 lux
 int32_t TemperatureData;    // 0.1C
 // semaphores
-int32_t NewData;  // true when new numbers to display on top of LCD
-int32_t LCDmutex; // exclusive access to LCD
-int32_t I2Cmutex; // exclusive access to I2C
+Sema4Type NewData;  // true when new numbers to display on top of LCD
+MutexType LCDmutex; // exclusive access to LCD
+MutexType I2Cmutex; // exclusive access to I2C
 int ReDrawAxes = 0;         // non-zero means redraw axes on next display task
 
 enum plotstate{
@@ -83,10 +84,9 @@ enum plotstate PlotState = Accelerometer;
 
 //---------------- Task0 samples sound from microphone ----------------
 // High priority thread run by OS in real time at 1000 Hz
-#define SOUNDRMSLENGTH 1000 // number of samples to collect before calculating RMS (may overflow if greater than 4104)
-int16_t SoundArray[SOUNDRMSLENGTH];
-int32_t TakeSoundData; // binary semaphore
-int32_t ADCmutex;      // access to ADC
+#define SOUNDRMSLENGTH 1000 // number of samples in each RMS result, 1 to 65535
+struct rmswindow Sound;     // running sums of the microphone samples
+Sema4Type TakeSoundData; // binary semaphore
 // *********Task0*********
 // Task0 measures sound intensity
 // Periodic main thread runs in real time at 1000 Hz
@@ -94,25 +94,17 @@ int32_t ADCmutex;      // access to ADC
 // Inputs:  none
 // Outputs: none
 void Task0(void){
-  static int32_t soundSum = 0;
-  static int time = 0;// units of microphone sampling rate
-
   SoundRMS = 0;
+  FixedMath_RMSInit(&Sound, SOUNDRMSLENGTH);
   while(1){
     OS_Wait(&TakeSoundData); // signaled by OS every 1ms
     TExaS_Task0();     // record system time in array, toggle virtual logic analyzer
     Profile_Toggle0(); // viewed by the logic analyzer to know Task0 started
-    OS_Wait(&ADCmutex);
-    BSP_Microphone_Input(&SoundData);
-    OS_Signal(&ADCmutex);
-    soundSum = soundSum + (int32_t)SoundData;
-    SoundArray[time] = SoundData;
-    time = time + 1;
-    if(time == SOUNDRMSLENGTH){
-      SoundAvg = soundSum/SOUNDRMSLENGTH;
-      soundSum = 0;
+    BSP_Microphone_Input(&SoundData); // 8 us, less than blocking for it would cost
+    if(FixedMath_RMSAdd(&Sound, SoundData)){
+      SoundAvg = Sound.mean;
+      SoundRMS = Sound.rms;
       OS_Signal(&NewData); // makes task5 run every 1 sec
-      time = 0;
     }
   }
 }
@@ -122,21 +114,20 @@ void Task0(void){
 
 //---------------- Task1 measures acceleration ----------------
 // Event thread run by OS in real time at 10 Hz
-int32_t TakeAccelerationData;
+Sema4Type TakeAccelerationData;
+Sema4Type AccelerationDone;  // signaled by the ADC when the three conversions end
 uint32_t LostTask1Data;     // number of times that the FIFO was full when acceleration data was ready
 uint16_t AccX, AccY, AccZ;  // returned by BSP as 10-bit numbers
 #define ALPHA 128           // The degree of weighting decrease, a constant smoothing factor between 0 and 1,023. A higher ALPHA discounts older observations faster.
-                            // basic step counting algorithm is based on a forum post from
-                            // http://stackoverflow.com/questions/16392142/android-accelerometer-profiling/16539643#16539643
-enum state{                 // the step counting algorithm cycles through four states
-  LookingForMax,            // looking for a local maximum in current magnitude
-  LookingForCross1,         // looking for current magnitude to cross average magnitude, minus a constant
-  LookingForMin,            // looking for a local minimum in current magnitude
-  LookingForCross2          // looking for current magnitude to cross average magnitude, plus a constant
-};
-enum state AlgorithmState = LookingForMax;
+struct stepcounter StepCounter; // steps and average of the magnitudes
 #define LOCALCOUNTTARGET 5  // The number of valid measured magnitudes needed to confirm a local min or local max.  Increase this number for longer strides or more frequent measurements.
 #define AVGOVERSHOOT 25     // The amount above or below average a measurement must be to count as "crossing" the average.  Increase this number to reject increasingly hard shaking as steps.
+// ADC completion task, runs in the ADC interrupt
+void AdcDone(uint32_t done){
+  if(done&BSP_ADC_ACCELEROMETER){
+    OS_Signal(&AccelerationDone);
+  }
+}
 // *********Task1*********
 // Task1 collects data from accelerometer in real time
 // Periodic main thread runs in real time at 10 Hz
@@ -145,7 +136,7 @@ enum state AlgorithmState = LookingForMax;
 void Task1(void){uint32_t squared;
   // initialize the exponential weighted moving average filter
   BSP_Accelerometer_Input(&AccX, &AccY, &AccZ);
-  Magnitude = sqrt32(AccX*AccX + AccY*AccY + AccZ*AccZ);
+  Magnitude = FixedMath_Sqrt(AccX*AccX + AccY*AccY + AccZ*AccZ);
   EWMA = Magnitude;                // this is a guess; there are many options
   Steps = 0;
   LostTask1Data = 0;
@@ -153,9 +144,9 @@ void Task1(void){uint32_t squared;
     OS_Wait(&TakeAccelerationData); // signaled by OS every 100ms
     TExaS_Task1();     // records system time in array, toggles virtual logic analyzer
     Profile_Toggle1(); // viewed by the logic analyzer to know Task1 started
-    OS_Wait(&ADCmutex);
-    BSP_Accelerometer_Input(&AccX, &AccY, &AccZ);
-    OS_Signal(&ADCmutex);
+    BSP_Accelerometer_Start();
+    OS_Wait(&AccelerationDone);     // lower threads run during the conversions
+    BSP_Accelerometer_End(&AccX, &AccY, &AccZ);
     squared = AccX*AccX + AccY*AccY + AccZ*AccZ;
     if(OS_FIFO_Put(squared) == -1){  // makes Task2 run every 100ms
       LostTask1Data = LostTask1Data + 1;
@@ -181,7 +172,7 @@ void Task1(void){uint32_t squared;
 #define TEMP_MAX 1023
 #define TEMP_MIN 0
 void drawaxes(void){
-  OS_Wait(&LCDmutex);
+  OS_MutexLock(&LCDmutex);
   if(PlotState == Accelerometer){
     BSP_LCD_Drawaxes(AXISCOLOR, BGCOLOR, "Time", "Mag", MAGCOLOR, "Ave", EWMACOLOR, ACCELERATION_MAX, ACCELERATION_MIN);
   } else if(PlotState == Microphone){
@@ -191,74 +182,24 @@ void drawaxes(void){
   } else if(PlotState == Light){
     BSP_LCD_Drawaxes(AXISCOLOR, BGCOLOR, "Time", "Light", LIGHTCOLOR, "", 0, LIGHT_MAX, LIGHT_MIN);
   }
-  OS_Signal(&LCDmutex);  ReDrawAxes = 0;
+  OS_MutexUnlock(&LCDmutex);  ReDrawAxes = 0;
 }
 void Task2(void){uint32_t data;
-  uint32_t localMin;   // smallest measured magnitude since odd-numbered step detected
-  uint32_t localMax;   // largest measured magnitude since even-numbered step detected
-  uint32_t localCount; // number of measured magnitudes above local min or below local max
-  localMin = 1024;
-  localMax = 0;
-  localCount = 0;
+  StepCount_Init(&StepCounter, ALPHA, LOCALCOUNTTARGET, AVGOVERSHOOT);
   drawaxes();
   while(1){
     data = OS_FIFO_Get();
     TExaS_Task2();     // records system time in array, toggles virtual logic analyzer
     Profile_Toggle2(); // viewed by the logic analyzer to know Task2 started
-    Magnitude = sqrt32(data);
-    EWMA = (ALPHA*Magnitude + (1023 - ALPHA)*EWMA)/1024;
-    if(AlgorithmState == LookingForMax){
-      if(Magnitude > localMax){
-        localMax = Magnitude;
-        localCount = 0;
-      } else{
-        localCount = localCount + 1;
-        if(localCount >= LOCALCOUNTTARGET){
-          AlgorithmState = LookingForCross1;
-        }
-      }
-    } else if(AlgorithmState == LookingForCross1){
-      if(Magnitude > localMax){
-      // somehow measured a very large magnitude
-        localMax = Magnitude;
-        localCount = 0;
-        AlgorithmState = LookingForMax;
-      } else if(Magnitude < (EWMA -  AVGOVERSHOOT)){
-        // step detected
-        Steps = Steps + 1;
-        localMin = 1024;
-        localCount = 0;
-        AlgorithmState = LookingForMin;
-      }
-    } else if(AlgorithmState == LookingForMin){
-      if(Magnitude < localMin){
-        localMin = Magnitude;
-        localCount = 0;
-      } else{
-        localCount = localCount + 1;
-        if(localCount >= LOCALCOUNTTARGET){
-          AlgorithmState = LookingForCross2;
-        }
-      }
-    } else if(AlgorithmState == LookingForCross2){
-      if(Magnitude < localMin){
-      // somehow measured a very small magnitude
-        localMin = Magnitude;
-        localCount = 0;
-        AlgorithmState = LookingForMin;
-      } else if(Magnitude > (EWMA + AVGOVERSHOOT)){
-        // step detected
-        Steps = Steps + 1;
-        localMax = 0;
-        localCount = 0;
-        AlgorithmState = LookingForMax;
-      }
-    }
+    Magnitude = FixedMath_Sqrt(data);
+    StepCount_Add(&StepCounter, Magnitude);
+    EWMA = StepCounter.ewma;
+    Steps = StepCounter.steps;
     if(ReDrawAxes){
       drawaxes();
       ReDrawAxes = 0;
     }
-    OS_Wait(&LCDmutex);
+    OS_MutexLock(&LCDmutex);
     if(PlotState == Accelerometer){
       BSP_LCD_PlotPoint(Magnitude, MAGCOLOR);
       BSP_LCD_PlotPoint(EWMA, EWMACOLOR);
@@ -270,7 +211,7 @@ void Task2(void){uint32_t data;
       BSP_LCD_PlotPoint(LightData, LIGHTCOLOR);
     }
     BSP_LCD_PlotIncrement();
-    OS_Signal(&LCDmutex);
+    OS_MutexUnlock(&LCDmutex);
   }
 }
 /* ****************************************** */
@@ -286,7 +227,7 @@ void Task2(void){uint32_t data;
 // checks the switches, updates the mode, and outputs to the buzzer and LED
 // Inputs:  none
 // Outputs: none
-int32_t SwitchTouch;
+Sema4Type SwitchTouch;
 void Task3(void){
   uint8_t current;
 	OS_InitSemaphore(&SwitchTouch,0); // signaled on touch button1
@@ -333,15 +274,15 @@ void Task4(void){int32_t voltData,tempData;
     TExaS_Task4();     // records system time in array, toggles virtual logic analyzer
 
 
-    OS_Wait(&I2Cmutex);
+    OS_MutexLock(&I2Cmutex);
     BSP_TempSensor_Start();
-    OS_Signal(&I2Cmutex);
+    OS_MutexUnlock(&I2Cmutex);
     done = 0;
     OS_Sleep(1000);    // waits about 1 sec
     while(done == 0){
-      OS_Wait(&I2Cmutex);
+      OS_MutexLock(&I2Cmutex);
       done = BSP_TempSensor_End(&voltData, &tempData);
-      OS_Signal(&I2Cmutex);
+      OS_MutexUnlock(&I2Cmutex);
     }
     TemperatureData = tempData/10000;
   }
@@ -361,23 +302,18 @@ void Task4(void){int32_t voltData,tempData;
 // updates the text at the top and bottom of the LCD
 // Inputs:  none
 // Outputs: none
-void Task5(void){int32_t soundSum;
-  OS_Wait(&LCDmutex);
+void Task5(void){
+  OS_MutexLock(&LCDmutex);
   BSP_LCD_DrawString(0,  0, "Temp=",  TOPTXTCOLOR);
   BSP_LCD_DrawString(0,  1, "Step=",  TOPTXTCOLOR);
   BSP_LCD_DrawString(10, 0, "Light=", TOPTXTCOLOR);
   BSP_LCD_DrawString(10, 1, "Sound=", TOPTXTCOLOR);
-  OS_Signal(&LCDmutex);
+  OS_MutexUnlock(&LCDmutex);
   while(1){
     OS_Wait(&NewData);
     TExaS_Task5();     // records system time in array, toggles virtual logic analyzer
     Profile_Toggle5(); // viewed by the logic analyzer to know Task5 started
-    soundSum = 0;
-    for(int i=0; i<SOUNDRMSLENGTH; i=i+1){
-      soundSum = soundSum + (SoundArray[i] - SoundAvg)*(SoundArray[i] - SoundAvg);
-    }
-    SoundRMS = sqrt32(soundSum/SOUNDRMSLENGTH);
-    OS_Wait(&LCDmutex);
+    OS_MutexLock(&LCDmutex);
     BSP_LCD_SetCursor(5,  0); BSP_LCD_OutUFix2_1(TemperatureData, TEMPCOLOR);
     BSP_LCD_SetCursor(5,  1); BSP_LCD_OutUDec4(Steps,             MAGCOLOR);
     BSP_LCD_SetCursor(16, 0); BSP_LCD_OutUDec4(LightData,         LIGHTCOLOR);
@@ -388,7 +324,7 @@ void Task5(void){int32_t soundSum;
       BSP_LCD_SetCursor(0, 12); BSP_LCD_OutUDec4(LostTask1Data, BSP_LCD_Color565(255, 0, 0));
     }
 //end of debug code
-    OS_Signal(&LCDmutex);
+    OS_MutexUnlock(&LCDmutex);
   }
 }
 /* ****************************************** */
@@ -407,15 +343,15 @@ void Task6(void){ uint32_t lightData;
     TExaS_Task6();     // records system time in array, toggles virtual logic analyzer
     Profile_Toggle6(); // viewed by the logic analyzer to know Task6 started
 
-    OS_Wait(&I2Cmutex);
+    OS_MutexLock(&I2Cmutex);
     BSP_LightSensor_Start();
-    OS_Signal(&I2Cmutex);
+    OS_MutexUnlock(&I2Cmutex);
     done = 0;
     OS_Sleep(800);     // waits about 0.8 sec
     while(done == 0){
-      OS_Wait(&I2Cmutex);
+      OS_MutexLock(&I2Cmutex);
       done = BSP_LightSensor_End(&lightData);
-      OS_Signal(&I2Cmutex);
+      OS_MutexUnlock(&I2Cmutex);
     }
     LightData = lightData/100;
   }
@@ -473,16 +409,25 @@ int main(void){
   BSP_TempSensor_Init();
   Time = 0;
   OS_InitSemaphore(&NewData, 0);  // 0 means no data
-  OS_InitSemaphore(&LCDmutex, 1); // 1 means free
-  OS_InitSemaphore(&I2Cmutex, 1); // 1 means free
+  OS_InitMutex(&LCDmutex);
+  OS_InitMutex(&I2Cmutex);
   OS_InitSemaphore(&TakeSoundData,0);
-  OS_InitSemaphore(&ADCmutex,1);
   BSP_Microphone_Init();
   BSP_Accelerometer_Init();
   OS_InitSemaphore(&TakeAccelerationData,0);
+  OS_InitSemaphore(&AccelerationDone,0);
+  BSP_ADC_Notify(&AdcDone, 2);    // below the OS periodic triggers
   OS_FIFO_Init();                 // initialize FIFO used to send data between Task1 and Task2
-  OS_AddThreads(&Task0,0, &Task1,1, &Task2,2, &Task3,3, 
-	              &Task4,3, &Task5,3, &Task6,3, &Task7,4);
+  OS_AddThread(&Task0, 0, 96);
+  OS_AddThread(&Task1, 1, 96);
+  OS_AddThread(&Task2, 2, 160);   // step counting and plotting go deepest
+  OS_AddThread(&Task3, 3, 64);
+  OS_AddThread(&Task4, 3, 96);    // I2C
+  OS_AddThread(&Task5, 3, 128);   // LCD text
+  OS_AddThread(&Task6, 3, 96);    // I2C
+  OS_AddThread(&Task7, 4, 32);    // idle
+  BSP_LCD_DrawString(5, 12, "Stack=", TOPTXTCOLOR);
+  BSP_LCD_SetCursor(11, 12); BSP_LCD_OutUDec4(OS_StackFree(), TOPNUMCOLOR); // words left for new threads
 	OS_PeriodTrigger0_Init(&TakeSoundData,1);  // every 1 ms
 	OS_PeriodTrigger1_Init(&TakeAccelerationData,100); //every 100ms
   // when grading change 1000 to 4-digit number from edX
@@ -495,19 +440,6 @@ int main(void){
 /*          End of Step 6 Section             */
 /* ****************************************** */
 
-// Newton's method
-// s is an integer
-// sqrt(s) is an integer
-uint32_t sqrt32(uint32_t s){
-uint32_t t;   // t*t will become s
-int n;             // loop counter
-  t = s/16+1;      // initial guess
-  for(n = 16; n; --n){ // will finish
-    t = ((t*t+s)/t)/2;
-  }
-  return t;
-}
-
 
 //---------------- Step 1 ----------------
 // Step 1 is to extend OS_AddThreads from Lab 4 to handle eight
@@ -525,7 +457,7 @@ int n;             // loop counter
 // Remember that you must have exactly one main() function, so
 // to work on this step, you must rename all other main()
 // functions in this file.
-int32_t sAB,sCD,sEF;
+Sema4Type sAB,sCD,sEF;
 int32_t CountA,CountB,CountC,CountD,CountE,CountF,CountG,CountH;
 void TaskA(void){ // producer highest priority
   CountA = 0;
@@ -628,8 +560,8 @@ int main_step1(void){
 // Remember that you must have exactly one main() function, so
 // to work on this step, you must rename all other main()
 // functions in this file.
-int32_t sIJ,sKL,sMN;
-int32_t sI,sK;
+Sema4Type sIJ,sKL,sMN;
+Sema4Type sI,sK;
 int32_t CountI,CountJ,CountK,CountL,CountM,CountN,CountO,CountP;
 void TaskI(void){ // producer highest priority
   CountI = 0;
@@ -736,8 +668,8 @@ int main_step2(void){
 // Remember that you must have exactly one main() function, so
 // to work on this step, you must rename all other main()
 // functions in this file.
-int32_t sQR;
-int32_t sQ;
+Sema4Type sQR;
+Sema4Type sQ;
 int32_t CountQ,CountR;
 void TaskQ(void){ // producer
   CountQ = 0;
@@ -782,3 +714,91 @@ int main_step3(void){
 /* ****************************************** */
 /*          End of Step 3 Section             */
 /* ****************************************** */
+
+//******************Step 4**************************
+// Step 4 checks priority inheritance of MutexType
+// TaskS  high priority, every 10 ms takes the mutex for 100 us
+// TaskT  medium priority, computes 30 ms out of every 50 ms, no mutex
+// TaskU  low priority, takes the mutex for 3 ms at a time
+// While TaskU holds the mutex and TaskS waits for it, TaskU runs at
+// priority 0, so TaskT can not delay TaskS. MaxBlockS, the longest
+// TaskS waited in OS_MutexLock, stays near the 3 ms TaskU holds it;
+// with a semaphore in place of the mutex it grows to about 30 ms.
+// LateS counts the waits longer than MAXWAITS and must stay 0, the
+// Linux host runs this step as a test, see Host_Linux/kernel/mutex.c
+// Remember that you must have exactly one main() function, so
+// to work on this step, you must rename all other main()
+// functions in this file.
+MutexType MutexSU;
+Sema4Type sS;
+#define MAXWAITS 3500 // us, 3 ms TaskU holds MutexSU plus one time slice
+uint32_t MaxBlockS;  // us, longest wait of TaskS for MutexSU
+uint32_t LateS;      // waits of TaskS longer than MAXWAITS
+int32_t CountS,CountT,CountU;
+void static compute(uint32_t us){ // stand in for work taking us microseconds
+  uint32_t start = BSP_Time_Get();
+  while((BSP_Time_Get()-start) < us){
+  }
+}
+void TaskS(void){ // high priority
+  uint32_t start,blocked;
+  CountS = 0;
+  MaxBlockS = 0;
+  LateS = 0;
+  while(1){
+    OS_Wait(&sS); // signaled every 10 ms
+    start = BSP_Time_Get();
+    OS_MutexLock(&MutexSU);
+    blocked = BSP_Time_Get()-start;
+    if(blocked > MaxBlockS){
+      MaxBlockS = blocked;
+    }
+    if(blocked > MAXWAITS){
+      LateS++;
+    }
+    TExaS_Task0();
+    Profile_Toggle0();
+    compute(100);
+    CountS++;
+    OS_MutexUnlock(&MutexSU);
+  }
+}
+void TaskT(void){ // medium priority
+  CountT = 0;
+  while(1){
+    OS_Sleep(20);
+    TExaS_Task1();
+    Profile_Toggle1();
+    compute(30000);
+    CountT++;
+  }
+}
+void TaskU(void){ // low priority
+  CountU = 0;
+  while(1){
+    OS_MutexLock(&MutexSU);
+    TExaS_Task2();
+    Profile_Toggle2();
+    compute(3000);
+    CountU++;
+    OS_MutexUnlock(&MutexSU);
+    compute(700);
+  }
+}
+int main_step4(void){
+  OS_Init();
+  Profile_Init();  // initialize the 7 hardware profiling pins
+  BSP_Time_Init();
+  OS_InitMutex(&MutexSU);
+  OS_InitSemaphore(&sS, 0);
+  OS_PeriodTrigger0_Init(&sS,10);   // every 10 ms
+  OS_AddThread(&TaskS, 0, 96);
+  OS_AddThread(&TaskT, 3, 96);
+  OS_AddThread(&TaskU, 6, 96);
+  TExaS_Init(LOGICANALYZER, 1000); // initialize the Lab 4 grader
+  OS_Launch(BSP_Clock_GetFreq()/1000);
+  return 0;             // this never executes
+}
+/* ****************************************** */
+/*          End of Step 4 Section             */
+/* ****************************************** */
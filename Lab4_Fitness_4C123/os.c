@@ -9,27 +9,167 @@
 #include "os.h"
 #include "CortexM.h"
 #include "BSP.h"
-#include "../inc/tm4c123gh6pm.h"
+#include "tm4c123gh6pm.h"
 
 // function definitions in osasm.s
 void StartOS(void);
 
 void static runperiodicevents(void);
+#ifndef NUMTHREADS
 #define NUMTHREADS  8        // maximum number of threads
+#endif
 #define NUMPERIODIC 2        // maximum number of periodic threads
-#define STACKSIZE   100      // number of 32-bit words in stack per thread
+#define STACKSIZE   96       // number of 32-bit words in stack per thread added by OS_AddThreads
+#define STACKBLOCK  32       // words per block of StackArena, stacks are whole blocks
+#define NUMBLOCKS   28       // blocks in StackArena, one bit each in FreeBlocks (at most 32)
+#define NUMPRIORITY 32       // number of priority levels, one bit each in ReadyBitmap
+#ifndef TICKLESS
+#define TICKLESS    0        // 1 for a one-shot kernel timer, 0 for 1 kHz periodic interrupts
+#endif
 struct tcb{
   int32_t *sp;      // pointer to stack (valid for threads not running
   struct tcb *next; // linked-list pointer
-  int32_t *blocked;	// pointer to blocked semaphore, nonzero if blocked on this semaphore
+  Sema4Type *blocked;	// pointer to blocked semaphore, nonzero if blocked on this semaphore
   int32_t sleep;	// time to sleep, nonzero if this thread is sleeping
-  uint32_t priority; // priority of the thread, 0 - highest priority, 254 - lowest
+  uint32_t priority; // priority of the thread, 0 - highest priority, 31 - lowest
+  struct tcb *readyNext; // circular ready list of this priority, valid only while ready
+  struct tcb *readyPrev;
+  struct tcb *waitNext;  // next thread blocked on the same semaphore
+  uint32_t delta;        // ms to wake up after the previous thread in SleepList
+  struct tcb *sleepNext; // SleepList link, valid only while sleeping
+  uint32_t stackBlocks;  // blocks of StackArena owned by this thread, 0 if the TCB is free
+  uint32_t basePriority; // priority given to OS_AddThread, priority may be raised above it
+  MutexType *waitMutex;  // nonzero if blocked on this mutex
+  MutexType *held;       // mutexes owned by this thread, linked by HeldNext
 };
 typedef struct tcb tcbType;
 tcbType tcbs[NUMTHREADS];
 tcbType *RunPt;
-int32_t Stacks[NUMTHREADS][STACKSIZE];
+uint32_t NumThread;  // number of threads
 void static runperiodicevents(void);
+void static release(MutexType *mutexPt);
+
+// All thread stacks come from one arena of NUMBLOCKS blocks. Bit i of
+// FreeBlocks is set while block i is unused, a thread takes a run of
+// contiguous blocks and OS_Kill gives them back.
+int32_t StackArena[NUMBLOCKS*STACKBLOCK];
+uint32_t FreeBlocks;
+
+// Sleeping threads, sorted by wakeup time. Each delta is relative to
+// the thread in front of it, so only the head needs to be counted down.
+tcbType *SleepList;
+
+// Ready threads are kept in one circular list per priority.
+// Bit 31-p of ReadyBitmap is set when ReadyList[p] is not empty,
+// so the highest priority ready level is found with a single CLZ.
+tcbType *ReadyList[NUMPRIORITY]; // next thread to run at each priority
+uint32_t ReadyBitmap;            // one bit per nonempty priority level
+#define PRIORITYBIT(p) (0x80000000>>(p))
+
+// ******** addready ************
+// Append a thread to the tail of the ready list of its priority
+// Called with interrupts disabled
+// Inputs:  pointer to thread that is neither blocked nor sleeping
+// Outputs: none
+void static addready(tcbType *thread){
+  tcbType *head;
+  head = ReadyList[thread->priority];
+  if(head == 0){
+    thread->readyNext = thread;  // only ready thread at this level
+    thread->readyPrev = thread;
+    ReadyList[thread->priority] = thread;
+    ReadyBitmap |= PRIORITYBIT(thread->priority);
+  } else{                        // tail is just before head
+    thread->readyNext = head;
+    thread->readyPrev = head->readyPrev;
+    head->readyPrev->readyNext = thread;
+    head->readyPrev = thread;
+  }
+}
+
+// ******** removeready ************
+// Unlink a thread from the ready list of its priority
+// Called with interrupts disabled
+// Inputs:  pointer to thread that is currently ready
+// Outputs: none
+void static removeready(tcbType *thread){
+  if(thread->readyNext == thread){ // last ready thread at this level
+    ReadyList[thread->priority] = 0;
+    ReadyBitmap &= ~PRIORITYBIT(thread->priority);
+  } else{
+    thread->readyPrev->readyNext = thread->readyNext;
+    thread->readyNext->readyPrev = thread->readyPrev;
+    if(ReadyList[thread->priority] == thread){
+      ReadyList[thread->priority] = thread->readyNext;
+    }
+  }
+}
+
+// ******** makeready ************
+// Make a blocked or sleeping thread ready again
+// Preempt as soon as every interrupt has returned if it has higher
+// priority than the running thread, rather than at the next time
+// slice. In TICKLESS mode also restart time slices if it has the same
+// priority, as there is no periodic SysTick to notice it
+// Called with interrupts disabled
+// Inputs:  pointer to thread that is neither blocked nor sleeping
+// Outputs: none
+void static makeready(tcbType *thread){
+  addready(thread);
+  if(thread->priority < RunPt->priority){
+    INTCTRL = 0x10000000;  // trigger PendSV once interrupts are enabled
+  }
+#if TICKLESS
+  else if(thread->priority == RunPt->priority){
+    STCTRL = 0x00000007;   // round robin again at this priority
+  }
+#endif
+}
+
+// ******** insertsleep ************
+// Put a thread into SleepList, after all threads that wake up no later
+// Called with interrupts disabled
+// Inputs:  pointer to thread, number of msec to sleep (at least 1)
+// Outputs: none
+void static insertsleep(tcbType *thread, uint32_t time){
+  tcbType *pt;
+  tcbType *prevPt = 0;
+  pt = SleepList;
+  while((pt != 0)&&(pt->delta <= time)){
+    time = time - pt->delta; // convert to a delta after pt
+    prevPt = pt;
+    pt = pt->sleepNext;
+  }
+  thread->delta = time;
+  thread->sleepNext = pt;
+  if(pt != 0){
+    pt->delta = pt->delta - time; // pt now wakes up relative to thread
+  }
+  if(prevPt != 0){
+    prevPt->sleepNext = thread;
+  } else{
+    SleepList = thread;
+  }
+}
+
+// ******** expiresleep ************
+// Advance SleepList by the elapsed time, waking threads whose sleep is over
+// Called with interrupts disabled
+// Inputs:  number of msec that have passed
+// Outputs: none
+void static expiresleep(uint32_t time){
+  tcbType *pt;
+  while((SleepList != 0)&&(SleepList->delta <= time)){
+    time = time - SleepList->delta;
+    pt = SleepList;
+    SleepList = pt->sleepNext;
+    pt->sleep = 0;
+    makeready(pt);
+  }
+  if(SleepList != 0){
+    SleepList->delta = SleepList->delta - time;
+  }
+}
 
 // ******** OS_Init ************
 // Initialize operating system, disable interrupts
@@ -38,39 +178,136 @@ void static runperiodicevents(void);
 // Inputs:  none
 // Outputs: none
 void OS_Init(void){
+  int32_t i;
   DisableInterrupts();
   BSP_Clock_InitFastest();// set processor clock to fastest speed
+  NumThread = 0;
+  for(i=0; i<NUMTHREADS; i++){
+    tcbs[i].stackBlocks = 0;  // all TCBs free
+  }
+  FreeBlocks = (NUMBLOCKS == 32)? 0xFFFFFFFF : ((1<<NUMBLOCKS) - 1);
+  ReadyBitmap = 0;            // no thread is ready
+  for(i=0; i<NUMPRIORITY; i++){
+    ReadyList[i] = 0;
+  }
 // perform any initializations needed, 
+#if TICKLESS
+// one-shot timer runs runperiodicevents only when a thread wakes up
+// or a periodic semaphore is due, at the priority of RealTimeEvents
+  BSP_Time_Init();
+  BSP_OneShotTask_Init(runperiodicevents,0);
+#else
 // set up periodic timer to run runperiodicevents to implement sleeping
   BSP_PeriodicTask_Init(runperiodicevents,1000,4);	//Start one HW Timer with periodic interrupt at 1000 Hz
+#endif
 }
 
-void SetInitialStack(int i){
-	//first set for each stack the stack pointer
-	tcbs[i].sp = &Stacks[i][STACKSIZE-16];	//Thread Stack Pointer	R13 = SP
-	//fill in bottom positions of the stack with register values, as if thread was already running and interrupted
-	Stacks[i][STACKSIZE-1] = 0x01000000; //Thumb bit on last stack element
-	//Stacks[i][STACKSIZE-2] = PC; //The Program Counter will be set later with the address of the function it points to, R15 = PC
-	Stacks[i][STACKSIZE-3] = 0x14141414; //Initial Link Register dummy value, R14 = LR
-	Stacks[i][STACKSIZE-4] = 0x12121212; //R12
-	Stacks[i][STACKSIZE-5] = 0x03030303; //R3
-	Stacks[i][STACKSIZE-6] = 0x02020202; //R2
-	Stacks[i][STACKSIZE-7] = 0x01010101; //R1
-	Stacks[i][STACKSIZE-8] = 0x00000000; //R0
-	Stacks[i][STACKSIZE-9] = 0x11111111; //R11
-	Stacks[i][STACKSIZE-10] = 0x10101010; //R10
-	Stacks[i][STACKSIZE-12] = 0x09090909; //R9
-	Stacks[i][STACKSIZE-13] = 0x08080808; //R8
-  Stacks[i][STACKSIZE-13] = 0x07070707; //R7
-  Stacks[i][STACKSIZE-14] = 0x06060606; //R6
-  Stacks[i][STACKSIZE-15] = 0x05050505; //R5
-  Stacks[i][STACKSIZE-16] = 0x04040404; //R4	
+// ******** allocstack ************
+// First fit search of FreeBlocks for enough contiguous blocks
+// Called with interrupts disabled
+// Inputs:  number of blocks needed, 1 to NUMBLOCKS
+// Outputs: mask of the blocks taken, 0 if the arena has no room
+uint32_t static allocstack(uint32_t n){
+  uint32_t mask, i;
+  mask = (n == 32)? 0xFFFFFFFF : ((1<<n) - 1);
+  for(i=0; i<=NUMBLOCKS-n; i++){
+    if((FreeBlocks&(mask<<i)) == (mask<<i)){
+      FreeBlocks &= ~(mask<<i);
+      return mask<<i;
+    }
+  }
+  return 0;
+}
+
+// ******** SetInitialStack ************
+// Fill the top of a new stack as if the thread had been interrupted
+// Inputs:  pointer to thread, its stack, size of the stack in words,
+//          and the function it starts in
+// Outputs: none
+void SetInitialStack(tcbType *thread, int32_t *stack, uint32_t words, void(*task)(void)){
+	thread->sp = &stack[words-16];	//Thread Stack Pointer	R13 = SP
+	stack[words-1] = 0x01000000; //Thumb bit on last stack element
+	stack[words-2] = (int32_t)(task); //The Program Counter, R15 = PC
+	stack[words-3] = 0x14141414; //Initial Link Register dummy value, R14 = LR
+	stack[words-4] = 0x12121212; //R12
+	stack[words-5] = 0x03030303; //R3
+	stack[words-6] = 0x02020202; //R2
+	stack[words-7] = 0x01010101; //R1
+	stack[words-8] = 0x00000000; //R0
+	stack[words-9] = 0x11111111; //R11
+	stack[words-10] = 0x10101010; //R10
+	stack[words-11] = 0x09090909; //R9
+	stack[words-12] = 0x08080808; //R8
+	stack[words-13] = 0x07070707; //R7
+	stack[words-14] = 0x06060606; //R6
+	stack[words-15] = 0x05050505; //R5
+	stack[words-16] = 0x04040404; //R4
+}
+
+//******** OS_AddThread ***************
+// Add one main thread to the scheduler, with its own stack size
+// Inputs: pointer to a void/void main thread
+//         priority (0 highest, 31 lowest)
+//         stack size in 32-bit words, rounded up to a multiple of STACKBLOCK
+// Outputs: 1 if successful, 0 if there is no free TCB or not enough stack
+// Can be called before OS_Launch or from a running thread, not from an ISR
+int OS_AddThread(void(*task)(void), uint32_t priority, uint32_t stackWords){
+	int32_t sr;	//I bit status
+	int32_t i;	//thread index
+	uint32_t n;	//number of blocks of StackArena
+	uint32_t blocks;	//mask of the blocks given to the new thread
+	tcbType *thread, *last;
+	if(stackWords < 16){
+		stackWords = 16;	//room for the initial stack frame
+	}
+	n = (stackWords + STACKBLOCK - 1)/STACKBLOCK;
+	if(n > NUMBLOCKS){
+		return 0;
+	}
+	sr = StartCritical();
+	for(i=0; i<NUMTHREADS; i++){
+		if(tcbs[i].stackBlocks == 0) break;	//free TCB
+	}
+	blocks = 0;
+	if(i < NUMTHREADS){
+		blocks = allocstack(n);
+	}
+	if(blocks == 0){
+		EndCritical(sr);
+		return 0;
+	}
+	thread = &tcbs[i];
+	thread->stackBlocks = blocks;
+	SetInitialStack(thread, &StackArena[STACKBLOCK*(31 - __clz(blocks&-blocks))], n*STACKBLOCK, task);
+	thread->blocked = 0;
+	thread->sleep = 0;
+	if(priority >= NUMPRIORITY){
+		priority = NUMPRIORITY-1;	//clamp to lowest priority
+	}
+	thread->priority = priority;
+	thread->basePriority = priority;
+	thread->waitMutex = 0;
+	thread->held = 0;
+	if(NumThread == 0){	//TCB ring, in the order the threads were added
+		RunPt = thread;
+	} else{
+		last = RunPt;
+		while(last->next != RunPt){
+			last = last->next;
+		}
+		last->next = thread;
+	}
+	thread->next = RunPt;
+	NumThread++;
+	addready(thread);
+	EndCritical(sr);
+	return 1;
 }
 
 //******** OS_AddThreads ***************
-// Add eight main threads to the scheduler
+// Add eight main threads to the scheduler, STACKSIZE words of stack each
 // Inputs: function pointers to eight void/void main threads
-//         priorites for each main thread (0 highest)
+//         priorites for each main thread (0 highest, 31 lowest)
 // Outputs: 1 if successful, 0 if this thread can not be added
 // This function will only be called once, after OS_Init and before OS_Launch
 int OS_AddThreads(void(*thread0)(void), uint32_t p0,
@@ -81,101 +318,163 @@ int OS_AddThreads(void(*thread0)(void), uint32_t p0,
                   void(*thread5)(void), uint32_t p5,
                   void(*thread6)(void), uint32_t p6,
                   void(*thread7)(void), uint32_t p7){
-	int32_t sr;	//I bit status
-	int32_t i;	//thread index
-	sr = StartCritical();	//Disable Interrupts
-	
-	//initialize TCB circular list
-	tcbs[0].next = &tcbs[1];	//main thread 0 points to main thread 1
-	tcbs[1].next = &tcbs[2];	//main thread 1 points to main thread 2
-	tcbs[2].next = &tcbs[3];	//main thread 2 points to main thread 3	
-	tcbs[3].next = &tcbs[4];	//main thread 3 points to main thread 4
-	tcbs[4].next = &tcbs[5];	//main thread 4 points to main thread 5
-	tcbs[5].next = &tcbs[6];	//main thread 5 points to main thread 6
-	tcbs[6].next = &tcbs[7];	//main thread 6 points to main thread 7
-	tcbs[7].next = &tcbs[0];	//main thread 7 points to main thread 8
-	
-	//initialize threads as not blocked									
-	for(i=0; i< NUMTHREADS; i++){tcbs[i].blocked = 0;}
-	
-	// initialize RunPt
-	RunPt = &tcbs[0];
-
-	// initialize four stacks, including initial PC
-	SetInitialStack(0);	//SetInitialStack initial stack of main thread 0
-	Stacks[0][STACKSIZE-2] = (int32_t)(thread0);	//Set address of thread0 as PC
-	SetInitialStack(1);	//SetInitialStack initial stack of main thread 1
-	Stacks[1][STACKSIZE-2] = (int32_t)(thread1);	//Set address of thread1 as PC	
-	SetInitialStack(2);	//SetInitialStack initial stack of main thread 2
-	Stacks[2][STACKSIZE-2] = (int32_t)(thread2);	//Set address of thread2 as PC
-	SetInitialStack(3);	//SetInitialStack initial stack of main thread 3
-	Stacks[3][STACKSIZE-2] = (int32_t)(thread3);	//Set address of thread3 as PC
-	SetInitialStack(4);	//SetInitialStack initial stack of main thread 4
-	Stacks[4][STACKSIZE-2] = (int32_t)(thread4);	//Set address of thread4 as PC
-	SetInitialStack(5);	//SetInitialStack initial stack of main thread 5
-	Stacks[5][STACKSIZE-2] = (int32_t)(thread5);	//Set address of thread5 as PC	
-	SetInitialStack(6);	//SetInitialStack initial stack of main thread 6
-	Stacks[6][STACKSIZE-2] = (int32_t)(thread6);	//Set address of thread5 as PC	
-	SetInitialStack(7);	//SetInitialStack initial stack of main thread 6
-	Stacks[7][STACKSIZE-2] = (int32_t)(thread7);	//Set address of thread5 as PC	
-	
-	//initialize priority for each thread
-	tcbs[0].priority = p0;
-	tcbs[1].priority = p1;
-	tcbs[2].priority = p2;
-	tcbs[3].priority = p3;
-	tcbs[4].priority = p4;
-	tcbs[5].priority = p5;
-	tcbs[6].priority = p6;
-	tcbs[7].priority = p7;
-	
-	EndCritical(sr);	//Enable Interrupts
-	return 1;         // successful
+	return OS_AddThread(thread0, p0, STACKSIZE) &&
+	       OS_AddThread(thread1, p1, STACKSIZE) &&
+	       OS_AddThread(thread2, p2, STACKSIZE) &&
+	       OS_AddThread(thread3, p3, STACKSIZE) &&
+	       OS_AddThread(thread4, p4, STACKSIZE) &&
+	       OS_AddThread(thread5, p5, STACKSIZE) &&
+	       OS_AddThread(thread6, p6, STACKSIZE) &&
+	       OS_AddThread(thread7, p7, STACKSIZE);
 }
 
+//******** OS_StackFree ***************
+// Stack arena words not given to any thread
+// Inputs: none
+// Outputs: free words, a multiple of STACKBLOCK
+uint32_t OS_StackFree(void){
+	uint32_t free, count;
+	free = FreeBlocks;
+	count = 0;
+	while(free){
+		free &= free - 1;	//clear lowest set bit
+		count++;
+	}
+	return count*STACKBLOCK;
+}
+
+// *****periodic events****************
+Sema4Type *PeriodicSemaphore0;
+uint32_t Period0; // time between signals
+Sema4Type *PeriodicSemaphore1;
+uint32_t Period1; // time between signals
+
+#if TICKLESS
+// *****tickless kernel timer****************
+// Kernel time only advances when something is due. The one-shot
+// timer is programmed for the earliest of the first sleeping thread
+// and the next periodic semaphore, measured from LastTime.
+int32_t Countdown0, Countdown1; // ms until next periodic signal
+uint32_t LastTime;              // BSP_Time_Get() when kernel time was last advanced
+#define MAXDELAY 10000          // ms, keeps the one-shot delay within 32 bits
+
+// ******** advancetime ************
+// Bring sleeping threads and periodic semaphores up to date
+// Called with interrupts disabled
+// Inputs:  none
+// Outputs: none
+void static advancetime(void){
+  uint32_t elapsed;
+  elapsed = (BSP_Time_Get() - LastTime)/1000; // whole ms since last update
+  LastTime = LastTime + elapsed*1000;         // keep the fraction for next time
+  expiresleep(elapsed);
+  if(Period0){
+    Countdown0 = Countdown0 - elapsed;
+    while(Countdown0 <= 0){
+      OS_Signal(PeriodicSemaphore0);
+      Countdown0 = Countdown0 + Period0;
+    }
+  }
+  if(Period1){
+    Countdown1 = Countdown1 - elapsed;
+    while(Countdown1 <= 0){
+      OS_Signal(PeriodicSemaphore1);
+      Countdown1 = Countdown1 + Period1;
+    }
+  }
+}
+
+// ******** armtimer ************
+// Program the one-shot timer for the next kernel deadline
+// Called with interrupts disabled, right after advancetime
+// Inputs:  none
+// Outputs: none
+void static armtimer(void){
+  uint32_t next = MAXDELAY;     // ms after LastTime
+  uint32_t late;                // us since LastTime
+  if((SleepList != 0)&&(SleepList->delta < next)){
+    next = SleepList->delta;
+  }
+  if(Period0 && ((uint32_t)Countdown0 < next)){
+    next = Countdown0;
+  }
+  if(Period1 && ((uint32_t)Countdown1 < next)){
+    next = Countdown1;
+  }
+  late = BSP_Time_Get() - LastTime;
+  if(next*1000 > late){
+    BSP_OneShotTask_Start(next*1000 - late);
+  } else{
+    BSP_OneShotTask_Start(1);   // already due, interrupt as soon as possible
+  }
+}
 
 void static runperiodicevents(void){
-// **DECREMENT SLEEP COUNTERS
+// **ONE-SHOT KERNEL TIMER, RUNS AT THE EARLIEST DEADLINE
+  long sr;
+  sr = StartCritical();
+  advancetime();
+  armtimer();
+  EndCritical(sr);
+}
+#else
+void static runperiodicevents(void){
+// **WAKE UP THREADS WHOSE SLEEP EXPIRED
 // In Lab 4, handle periodic events in RealTimeEvents
-	int32_t i;
-	for (i=0;i<NUMTHREADS;i++){ if(tcbs[i].sleep != 0) {	//search for sleeping main threads
-			tcbs[i].sleep --;	//decrement sleep period by 1ms
-		}
-	}
+  long sr;
+  sr = StartCritical();  // RealTimeEvents may signal
+  expiresleep(1);        // only the head of SleepList is touched
+  EndCritical(sr);
 }
+#endif
 
 //******** OS_Launch ***************
 // Start the scheduler, enable interrupts
 // Inputs: number of clock cycles for each time slice
 // Outputs: none (does not return)
 // Errors: theTimeSlice must be less than 16,777,216
+// In TICKLESS mode SysTick only interrupts while another thread of
+// the same priority is ready, so the lowest priority thread should
+// call WaitForInterrupt() to sleep until the next deadline
 void OS_Launch(uint32_t theTimeSlice){
   STCTRL = 0;                  // disable SysTick during setup
   STCURRENT = 0;               // any write to current clears it
-  SYSPRI3 =(SYSPRI3&0x00FFFFFF)|0xE0000000; // priority 7
+  SYSPRI3 =(SYSPRI3&0x0000FFFF)|0xE0E00000; // priority 7, SysTick and PendSV
   STRELOAD = theTimeSlice - 1; // reload value
   STCTRL = 0x00000007;         // enable, core clock and interrupt arm
+#if TICKLESS
+  LastTime = BSP_Time_Get();   // kernel time starts now
+  armtimer();
+#endif
   StartOS();                   // start on the first task
 }
+
+//******** SysTick_Handler ***************
+// Time slice interrupt, only requests a thread switch
+// The switch itself runs in PendSV_Handler (osasm.s) at the lowest
+// priority, after every other pending interrupt has finished
+// Inputs: none
+// Outputs: none
+void SysTick_Handler(void){
+  INTCTRL = 0x10000000; // trigger PendSV
+}
 // runs every ms
 void Scheduler(void){      // every time slice
-	// look at all threads in TCB list choose
-	// highest priority thread not blocked and not sleeping 
+	// choose the highest priority thread not blocked and not sleeping
 	// If there are multiple highest priority (not blocked, not sleeping) run these round robin
-	// ROUND ROBIN, skip blocked and sleeping threads
-	uint32_t maxprio = 255;
-	tcbType *tempPt;
-	tcbType *bestPt;
-	tempPt = RunPt;
-	do {
-		tempPt = tempPt->next;
-		if(((tempPt->priority) < maxprio) && (tempPt->blocked == 0) && (tempPt->sleep == 0)) { 
-			//If priority is higher and not blocked and not sleeping
-			maxprio = tempPt->priority;
-			bestPt = tempPt;
-		}
-	} while (RunPt != tempPt); //search through all linked list
-	RunPt = bestPt; //move to next suitable thread
+	// Only ready threads are in ReadyList, so this takes constant time
+	// There must always be at least one ready thread (e.g., a dummy thread that never blocks)
+	uint32_t prio;
+	prio = __clz(ReadyBitmap);	//highest priority level with a ready thread
+	RunPt = ReadyList[prio];
+	ReadyList[prio] = RunPt->readyNext;	//ROUND ROBIN within this priority
+#if TICKLESS
+	if(RunPt->readyNext == RunPt){
+		STCTRL = 0x00000005;	//alone at this priority, no time slice interrupts
+	} else{
+		STCTRL = 0x00000007;	//share time slices round robin
+	}
+#endif
 }
 
 //******** OS_Suspend ***************
@@ -185,10 +484,43 @@ void Scheduler(void){      // every time slice
 // Will be run again depending on sleep/block status
 void OS_Suspend(void){
   STCURRENT = 0;        // any write to current clears it
-  INTCTRL = 0x04000000; // trigger SysTick
+  INTCTRL = 0x10000000; // trigger PendSV
 // next thread gets a full time slice
 }
 
+// ******** OS_Kill ************
+// kill the currently running thread, release its TCB and stack
+// input:  none
+// output: none
+// RunPt stays on the dead thread, PendSV saves into its TCB and schedules.
+// The freed blocks are not reused before that, since OS_AddThread is
+// never called from an ISR
+// Mutexes the thread still owns go to their waiters as OS_MutexUnlock
+// would give them, so no thread waits on a dead owner
+void OS_Kill(void){
+  tcbType *previous;
+  DisableInterrupts();
+  if(NumThread == 1){
+    for(;;){};     // crash, nothing left to run
+  }
+  NumThread--;
+  while(RunPt->held != 0){
+    release(RunPt->held);
+  }
+  removeready(RunPt);         // can't rerun this thread, it will be dead
+  previous = RunPt;
+  while(previous->next != RunPt){
+    previous = previous->next;
+  }
+  previous->next = RunPt->next; // remove from TCB ring
+  FreeBlocks |= RunPt->stackBlocks;
+  RunPt->stackBlocks = 0;     // mark TCB as free
+  STCURRENT = 0;              // next thread gets a full slice
+  INTCTRL = 0x10000000;       // trigger PendSV to start next thread
+  EnableInterrupts();
+  for(;;){};                  // can not return
+}
+
 // ******** OS_Sleep ************
 // place this thread into a dormant state
 // input:  number of msec to sleep
@@ -197,7 +529,19 @@ void OS_Suspend(void){
 void OS_Sleep(uint32_t sleepTime){
 // set sleep parameter in TCB
 // suspend, stops running
-	RunPt->sleep = sleepTime;
+	DisableInterrupts();
+	if(sleepTime){
+		RunPt->sleep = sleepTime;
+		removeready(RunPt);
+#if TICKLESS
+		advancetime();	//sleep is measured from now
+		insertsleep(RunPt, sleepTime);
+		armtimer();	//this thread may be the next deadline
+#else
+		insertsleep(RunPt, sleepTime);
+#endif
+	}
+	EnableInterrupts();
 	OS_Suspend();
 }
 
@@ -206,22 +550,32 @@ void OS_Sleep(uint32_t sleepTime){
 // Inputs:  pointer to a semaphore
 //          initial value of semaphore
 // Outputs: none
-void OS_InitSemaphore(int32_t *semaPt, int32_t value){
-  //Assign initial value to *semaPt
-	*semaPt = value;
+void OS_InitSemaphore(Sema4Type *semaPt, int32_t value){
+  //Assign initial value to semaphore, no threads blocked on it yet
+	semaPt->Value = value;
+	semaPt->Head = 0;
+	semaPt->Tail = 0;
 }
 
 // ******** OS_Wait ************
 // Decrement semaphore and block if less than zero
 // Lab2 spinlock (does not suspend while spinning)
-// Lab3 block if less than zero
+// Lab3 block if less than zero, blocked threads queue in FIFO order
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
-void OS_Wait(int32_t *semaPt){
+void OS_Wait(Sema4Type *semaPt){
 	DisableInterrupts();
-	*semaPt = (*semaPt) - 1;
-	if(*semaPt < 0){
+	semaPt->Value = semaPt->Value - 1;
+	if(semaPt->Value < 0){
 		RunPt->blocked = semaPt;	//Point to semaphore which is blocked
+		RunPt->waitNext = 0;	//append to tail of the wait queue
+		if(semaPt->Head == 0){
+			semaPt->Head = RunPt;
+		} else{
+			semaPt->Tail->waitNext = RunPt;
+		}
+		semaPt->Tail = RunPt;
+		removeready(RunPt);
 		EnableInterrupts();
 		OS_Suspend();	//Switch threads by generating a systick interrupt
 	}
@@ -231,26 +585,216 @@ void OS_Wait(int32_t *semaPt){
 // ******** OS_Signal ************
 // Increment semaphore
 // Lab2 spinlock
-// Lab3 wakeup blocked thread if appropriate
+// Lab3 wakeup blocked thread if appropriate, the longest waiter is woken first
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
-void OS_Signal(int32_t *semaPt){
+void OS_Signal(Sema4Type *semaPt){
 	tcbType	*threadPt;	//local thread pointer
+	long sr;
+	sr = StartCritical();	//may be called by the kernel timer with interrupts disabled
+	semaPt->Value = semaPt->Value + 1;
+	if(semaPt->Value <= 0){
+		threadPt = semaPt->Head;	//longest waiting thread
+		semaPt->Head = threadPt->waitNext;	//remove it from the wait queue
+		threadPt->blocked = 0;	//unblock it
+		makeready(threadPt);
+	}
+	EndCritical(sr);
+}
+
+// *****priority inheritance mutex****************
+// A thread blocked on a mutex raises the owner to its own priority, and
+// the owner of that owner's mutex and so on, so a low priority thread
+// holding the LCD is not starved by medium priority threads while a high
+// priority thread waits. Waiters queue by priority through waitNext.
+
+// ******** isready ************
+// Inputs:  pointer to a thread
+// Outputs: nonzero if the thread is in the ready lists
+int static isready(tcbType *thread){
+	return (thread->blocked == 0)&&(thread->sleep == 0)&&(thread->waitMutex == 0);
+}
+
+// ******** insertwaiter ************
+// Queue a thread on a mutex, highest priority first, FIFO within a priority
+// Called with interrupts disabled
+// Inputs:  pointer to a mutex, pointer to the thread
+// Outputs: none
+void static insertwaiter(MutexType *mutexPt, tcbType *thread){
+	tcbType *pt, *prevPt;
+	prevPt = 0;
+	pt = mutexPt->Head;
+	while((pt != 0)&&(pt->priority <= thread->priority)){
+		prevPt = pt;
+		pt = pt->waitNext;
+	}
+	thread->waitNext = pt;
+	if(prevPt == 0){
+		mutexPt->Head = thread;
+	} else{
+		prevPt->waitNext = thread;
+	}
+}
+
+// ******** removewaiter ************
+// Unlink a thread from the queue of the mutex it waits on
+// Called with interrupts disabled
+// Inputs:  pointer to a mutex, pointer to a thread in its queue
+// Outputs: none
+void static removewaiter(MutexType *mutexPt, tcbType *thread){
+	tcbType *pt;
+	if(mutexPt->Head == thread){
+		mutexPt->Head = thread->waitNext;
+	} else{
+		pt = mutexPt->Head;
+		while(pt->waitNext != thread){
+			pt = pt->waitNext;
+		}
+		pt->waitNext = thread->waitNext;
+	}
+}
+
+// ******** setpriority ************
+// Change the running priority of a thread. A thread waiting on a mutex
+// is requeued, and the owner of that mutex inherits the priority if it
+// is lower, continuing down the chain of owners.
+// Called with interrupts disabled
+// Inputs:  pointer to a thread, new priority
+// Outputs: none
+void static setpriority(tcbType *thread, uint32_t priority){
+	MutexType *mutexPt;
+	while(thread->priority != priority){
+		if(isready(thread)){
+			removeready(thread);
+			thread->priority = priority;
+			addready(thread);
+			return;
+		}
+		thread->priority = priority;	//sleeping or blocked, used once it is ready
+		mutexPt = thread->waitMutex;
+		if(mutexPt == 0){
+			return;
+		}
+		removewaiter(mutexPt, thread);
+		insertwaiter(mutexPt, thread);
+		thread = mutexPt->Owner;
+		if(thread->priority <= priority){
+			return;	//owner already at least this urgent
+		}
+	}
+}
+
+// ******** inheritedpriority ************
+// Priority a thread should run at: its own, or that of the most urgent
+// thread waiting on any mutex it owns
+// Called with interrupts disabled
+// Inputs:  pointer to a thread
+// Outputs: priority, 0 highest
+uint32_t static inheritedpriority(tcbType *thread){
+	uint32_t priority;
+	MutexType *mutexPt;
+	priority = thread->basePriority;
+	for(mutexPt = thread->held; mutexPt != 0; mutexPt = mutexPt->HeldNext){
+		if((mutexPt->Head != 0)&&(mutexPt->Head->priority < priority)){
+			priority = mutexPt->Head->priority;
+		}
+	}
+	return priority;
+}
+
+// ******** OS_InitMutex ************
+// Initialize a priority inheritance mutex as free
+// Inputs:  pointer to a mutex
+// Outputs: none
+void OS_InitMutex(MutexType *mutexPt){
+	mutexPt->Owner = 0;
+	mutexPt->Head = 0;
+	mutexPt->HeldNext = 0;
+}
+
+// ******** OS_MutexLock ************
+// Take the mutex, blocking until it is free. While blocked, the owner
+// runs at least at the priority of this thread.
+// Inputs:  pointer to a mutex
+// Outputs: 1 when the mutex is taken
+//          0 if this thread already owns it (recursive lock, not counted)
+// Must not be called from an ISR
+int OS_MutexLock(MutexType *mutexPt){
 	DisableInterrupts();
-	(*semaPt) = (*semaPt) + 1;
-	if(*semaPt <= 0){
-		threadPt = RunPt->next;	//point to next thread
-		while((threadPt->blocked) != semaPt) {	threadPt = threadPt->next; }//search for a thread that is blocked on this semaphore
-		threadPt->blocked = 0;	//unblock 1st blocked thread found
+	if(mutexPt->Owner == RunPt){
+		EnableInterrupts();
+		return 0;	//would deadlock on itself
+	}
+	if(mutexPt->Owner == 0){
+		mutexPt->Owner = RunPt;
+		mutexPt->HeldNext = RunPt->held;
+		RunPt->held = mutexPt;
+	} else{
+		removeready(RunPt);
+		RunPt->waitMutex = mutexPt;
+		insertwaiter(mutexPt, RunPt);
+		if(mutexPt->Owner->priority > RunPt->priority){
+			setpriority(mutexPt->Owner, RunPt->priority);	//owner inherits
+		}
+		EnableInterrupts();
+		OS_Suspend();	//OS_MutexUnlock hands the mutex over
+	}
+	EnableInterrupts();
+	return 1;
+}
+
+// ******** release ************
+// Remove a mutex from those the running thread owns and give it to
+// the highest priority waiter, if any
+// Called with interrupts disabled
+// Inputs:  pointer to a mutex owned by RunPt
+// Outputs: none
+void static release(MutexType *mutexPt){
+	tcbType *threadPt;
+	MutexType **heldPt;
+	heldPt = &RunPt->held;
+	while(*heldPt != mutexPt){
+		heldPt = &(*heldPt)->HeldNext;
+	}
+	*heldPt = mutexPt->HeldNext;	//remove from the mutexes this thread owns
+	threadPt = mutexPt->Head;
+	mutexPt->Owner = threadPt;
+	if(threadPt != 0){
+		mutexPt->Head = threadPt->waitNext;
+		threadPt->waitMutex = 0;
+		mutexPt->HeldNext = threadPt->held;
+		threadPt->held = mutexPt;
+		threadPt->priority = inheritedpriority(threadPt);	//it may inherit from the rest of the queue
+		makeready(threadPt);
+	}
+}
+
+// ******** OS_MutexUnlock ************
+// Release the mutex to the highest priority waiter, if any, and drop
+// any priority inherited through it
+// Inputs:  pointer to a mutex
+// Outputs: 1 if released, 0 if this thread does not own it
+// Must not be called from an ISR
+int OS_MutexUnlock(MutexType *mutexPt){
+	DisableInterrupts();
+	if(mutexPt->Owner != RunPt){
+		EnableInterrupts();
+		return 0;
+	}
+	release(mutexPt);
+	setpriority(RunPt, inheritedpriority(RunPt));
+	if(__clz(ReadyBitmap) < RunPt->priority){
+		OS_Suspend();	//a more urgent thread is ready, run it as soon as interrupts are enabled
 	}
 	EnableInterrupts();
+	return 1;
 }
 
 #define FSIZE 10    // can be any size
 uint32_t PutI;      // index of where to put next
 uint32_t GetI;      // index of where to get next
 uint32_t Fifo[FSIZE];
-int32_t CurrentSize;// 0 means FIFO empty, FSIZE means full
+Sema4Type CurrentSize;// 0 means FIFO empty, FSIZE means full
 uint32_t LostData;  // number of lost pieces of data
 
 // ******** OS_FIFO_Init ************
@@ -276,7 +820,7 @@ void OS_FIFO_Init(void){ //Init the FIFO with indexes and CurrentSize and LostDa
 // Inputs:  data to be stored
 // Outputs: 0 if successful, -1 if the FIFO is full
 int OS_FIFO_Put(uint32_t data){
-	if(CurrentSize == FSIZE) { //FIFO is full
+	if(CurrentSize.Value == FSIZE) { //FIFO is full
 		LostData++;
 		return -1; //Error
 	}
@@ -301,22 +845,18 @@ uint32_t OS_FIFO_Get(void){uint32_t data;
 	GetI = (GetI + 1) % FSIZE;	//Incremet Get index and wrap around
   return data;
 }
-// *****periodic events****************
-int32_t *PeriodicSemaphore0;
-uint32_t Period0; // time between signals
-int32_t *PeriodicSemaphore1;
-uint32_t Period1; // time between signals
+#if !TICKLESS
 void RealTimeEvents(void){int flag=0;
   static int32_t realCount = -10; // let all the threads execute once
   // Note to students: we had to let the system run for a time so all user threads ran at least one
   // before signalling the periodic tasks
   realCount++;
   if(realCount >= 0){
-		if((realCount%Period0)==0){
+		if(Period0 && ((realCount%Period0)==0)){
       OS_Signal(PeriodicSemaphore0);
       flag = 1;
 		}
-    if((realCount%Period1)==0){
+    if(Period1 && ((realCount%Period1)==0)){
       OS_Signal(PeriodicSemaphore1);
       flag=1;
 	}
@@ -325,16 +865,21 @@ void RealTimeEvents(void){int flag=0;
     }
   }
 }
+#endif
 // ******** OS_PeriodTrigger0_Init ************
 // Initialize periodic timer interrupt to signal 
 // Inputs:  semaphore to signal
 //          period in ms
 // priority level at 0 (highest)
 // Outputs: none
-void OS_PeriodTrigger0_Init(int32_t *semaPt, uint32_t period){
+void OS_PeriodTrigger0_Init(Sema4Type *semaPt, uint32_t period){
 	PeriodicSemaphore0 = semaPt;
 	Period0 = period;
+#if TICKLESS
+	Countdown0 = 10;	// let all the threads execute once, then signal every period
+#else
 	BSP_PeriodicTask_InitC(&RealTimeEvents,1000,0);
+#endif
 }
 // ******** OS_PeriodTrigger1_Init ************
 // Initialize periodic timer interrupt to signal 
@@ -342,20 +887,24 @@ void OS_PeriodTrigger0_Init(int32_t *semaPt, uint32_t period){
 //          period in ms
 // priority level at 0 (highest)
 // Outputs: none
-void OS_PeriodTrigger1_Init(int32_t *semaPt, uint32_t period){
+void OS_PeriodTrigger1_Init(Sema4Type *semaPt, uint32_t period){
 	PeriodicSemaphore1 = semaPt;
 	Period1 = period;
+#if TICKLESS
+	Countdown1 = 10;	// let all the threads execute once, then signal every period
+#else
 	BSP_PeriodicTask_InitC(&RealTimeEvents,1000,0);
+#endif
 }
 
 //****edge-triggered event************
-int32_t *edgeSemaphore;
+Sema4Type *edgeSemaphore;
 // ******** OS_EdgeTrigger_Init ************
 // Initialize button1, PD6, to signal on a falling edge interrupt
 // Inputs:  semaphore to signal
 //          priority
 // Outputs: none
-void OS_EdgeTrigger_Init(int32_t *semaPt, uint8_t priority){
+void OS_EdgeTrigger_Init(Sema4Type *semaPt, uint8_t priority){
 	uint32_t clock;
 	uint32_t bit_prio;
 	
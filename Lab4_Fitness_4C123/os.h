@@ -28,6 +28,26 @@
 #ifndef __OS_H
 #define __OS_H  1
 
+// counting semaphore with its own FIFO queue of blocked threads
+// Value<0 means -Value threads are waiting, Head is the longest waiter
+struct tcb;
+struct Sema4{
+  int32_t Value;      // semaphore count
+  struct tcb *Head;   // first thread blocked on this semaphore, 0 if none
+  struct tcb *Tail;   // last thread blocked on this semaphore
+};
+typedef struct Sema4 Sema4Type;
+
+// mutex with an owner, for exclusive access to the LCD, I2C and the ADC
+// Waiters queue by priority and the owner inherits the priority of the
+// most urgent one, so medium priority threads can not starve it
+struct Mutex{
+  struct tcb *Owner;      // thread holding the mutex, 0 if free
+  struct tcb *Head;       // highest priority waiting thread, 0 if none
+  struct Mutex *HeldNext; // next mutex held by the same owner
+};
+typedef struct Mutex MutexType;
+
 
 // ******** OS_Init ************
 // Initialize operating system, disable interrupts
@@ -37,10 +57,25 @@
 // Outputs: none
 void OS_Init(void);
 
+//******** OS_AddThread ***************
+// Add one main thread to the scheduler, with its own stack size
+// Inputs: pointer to a void/void main thread
+//         priority (0 highest, 31 lowest)
+//         stack size in 32-bit words, rounded up to a multiple of 32
+// Outputs: 1 if successful, 0 if there is no free TCB or not enough stack
+// Can be called before OS_Launch or from a running thread, not from an ISR
+int OS_AddThread(void(*task)(void), uint32_t priority, uint32_t stackWords);
+
+//******** OS_StackFree ***************
+// Stack arena words not given to any thread
+// Inputs: none
+// Outputs: free words
+uint32_t OS_StackFree(void);
+
 //******** OS_AddThreads ***************
-// Add eight main threads to the scheduler
+// Add eight main threads to the scheduler, 96 words of stack each
 // Inputs: function pointers to eight void/void main threads
-//         priorites for each main thread (0 highest)
+//         priorites for each main thread (0 highest, 31 lowest)
 // Outputs: 1 if successful, 0 if this thread can not be added
 // This function will only be called once, after OS_Init and before OS_Launch
 int OS_AddThreads(void(*thread0)(void), uint32_t p0,
@@ -67,6 +102,12 @@ void OS_Launch(uint32_t theTimeSlice);
 // Will be run again depending on sleep/block status
 void OS_Suspend(void);
 
+// ******** OS_Kill ************
+// kill the currently running thread, release its TCB and stack
+// input:  none
+// output: none (does not return)
+void OS_Kill(void);
+
 // ******** OS_Sleep ************
 // place this thread into a dormant state
 // input:  number of msec to sleep
@@ -79,23 +120,45 @@ void OS_Sleep(uint32_t sleepTime);
 // Inputs:  pointer to a semaphore
 //          initial value of semaphore
 // Outputs: none
-void OS_InitSemaphore(int32_t *semaPt, int32_t value);
+void OS_InitSemaphore(Sema4Type *semaPt, int32_t value);
 
 // ******** OS_Wait ************
 // Decrement semaphore and block if less than zero
 // Lab2 spinlock (does not suspend while spinning)
-// Lab3 block if less than zero
+// Lab3 block if less than zero, blocked threads queue in FIFO order
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
-void OS_Wait(int32_t *semaPt);
+void OS_Wait(Sema4Type *semaPt);
 
 // ******** OS_Signal ************
 // Increment semaphore
 // Lab2 spinlock
-// Lab3 wakeup blocked thread if appropriate
+// Lab3 wakeup blocked thread if appropriate, the longest waiter is woken first
 // Inputs:  pointer to a counting semaphore
 // Outputs: none
-void OS_Signal(int32_t *semaPt);
+void OS_Signal(Sema4Type *semaPt);
+
+// ******** OS_InitMutex ************
+// Initialize a priority inheritance mutex as free
+// Inputs:  pointer to a mutex
+// Outputs: none
+void OS_InitMutex(MutexType *mutexPt);
+
+// ******** OS_MutexLock ************
+// Take the mutex, blocking until it is free. While blocked, the owner
+// runs at least at the priority of this thread.
+// Inputs:  pointer to a mutex
+// Outputs: 1 when the mutex is taken
+//          0 if this thread already owns it (recursive lock, not counted)
+// Must not be called from an ISR
+int OS_MutexLock(MutexType *mutexPt);
+
+// ******** OS_MutexUnlock ************
+// Release the mutex to the highest priority waiter, if any
+// Inputs:  pointer to a mutex
+// Outputs: 1 if released, 0 if this thread does not own it
+// Must not be called from an ISR
+int OS_MutexUnlock(MutexType *mutexPt);
 
 // ******** OS_FIFO_Init ************
 // Initialize FIFO.  The "put" and "get" indices initially
@@ -132,7 +195,7 @@ uint32_t OS_FIFO_Get(void);
 //          period in ms
 // priority level at 0 (highest)
 // Outputs: none
-void OS_PeriodTrigger0_Init(int32_t *semaPt, uint32_t period);
+void OS_PeriodTrigger0_Init(Sema4Type *semaPt, uint32_t period);
 
 // ******** OS_PeriodTrigger1_Init ************
 // Initialize periodic timer interrupt to signal 
@@ -140,14 +203,14 @@ void OS_PeriodTrigger0_Init(int32_t *semaPt, uint32_t period);
 //          period in ms
 // priority level at 0 (highest)
 // Outputs: none
-void OS_PeriodTrigger1_Init(int32_t *semaPt, uint32_t period);
+void OS_PeriodTrigger1_Init(Sema4Type *semaPt, uint32_t period);
 
 // ******** OS_EdgeTrigger_Init ************
 // Initialize button1, PD6, to signal on a falling edge interrupt
 // Inputs:  semaphore to signal
 //          priority
 // Outputs: none
-void OS_EdgeTrigger_Init(int32_t *semaPt, uint8_t priority);
+void OS_EdgeTrigger_Init(Sema4Type *semaPt, uint8_t priority);
 
 // ******** OS_EdgeTrigger_Restart ************
 // restart button1 to signal on a falling edge interrupt
@@ -48,6 +48,24 @@ long StartCritical (void);    // previous I bit, disable interrupts
 void EndCritical(long sr);    // restore I bit to previous value
 void WaitForInterrupt(void);  // low power mode
 
+// Polls of a busy bit before giving up on the flash controller.
+// Each poll is a few bus cycles, so at 80 MHz this is tens of ms,
+// longer than the worst case page erase.
+#define FLASH_TIMEOUT 1000000
+
+// Wait for the bits in mask to clear in a flash control register
+// Returns 'NOERROR' if they cleared, 'ERROR' after FLASH_TIMEOUT polls
+static int WaitClear(volatile uint32_t *reg, uint32_t mask){
+  uint32_t polls = 0;
+  while((*reg)&mask){
+    polls = polls + 1;
+    if(polls >= FLASH_TIMEOUT){
+      return ERROR;
+    }
+  }
+  return NOERROR;
+}
+
 // Check if address offset is valid for write operation
 // Writing addresses must be 4-byte aligned and within range
 static int WriteAddrValid(uint32_t addr){
@@ -95,13 +113,14 @@ void Flash_Init(uint8_t systemClockFreqMHz){
 // Note: disables interrupts while writing
 int Flash_Write(uint32_t addr, uint32_t data){
   uint32_t flashkey;
+  int result;
   if(WriteAddrValid(addr)){
     DisableInterrupts();                            // may be optional step
                                                     // wait for hardware idle
-    while(FLASH_FMC_R&(FLASH_FMC_WRITE|FLASH_FMC_ERASE|FLASH_FMC_MERASE)){
-                 // to do later: return ERROR if this takes too long
-                 // remember to re-enable interrupts
-    };
+    if(WaitClear(&FLASH_FMC_R, FLASH_FMC_WRITE|FLASH_FMC_ERASE|FLASH_FMC_MERASE) == ERROR){
+      EnableInterrupts();
+      return ERROR;
+    }
     FLASH_FMD_R = data;
     FLASH_FMA_R = addr;
     if(FLASH_BOOTCFG_R&FLASH_BOOTCFG_KEY){          // by default, the key is 0xA442
@@ -110,12 +129,9 @@ int Flash_Write(uint32_t addr, uint32_t data){
       flashkey = FLASH_FMC_WRKEY2;
     }
     FLASH_FMC_R = (flashkey|FLASH_FMC_WRITE);       // start writing
-    while(FLASH_FMC_R&FLASH_FMC_WRITE){
-                 // to do later: return ERROR if this takes too long
-                 // remember to re-enable interrupts
-    };           // wait for completion (~3 to 4 usec)
+    result = WaitClear(&FLASH_FMC_R, FLASH_FMC_WRITE); // wait for completion (~3 to 4 usec)
     EnableInterrupts();
-    return NOERROR;
+    return result;
   }
   return ERROR;
 }
@@ -152,10 +168,10 @@ int Flash_FastWrite(uint32_t *source, uint32_t addr, uint16_t count){
   int writes = 0;
   if(MassWriteAddrValid(addr)){
     DisableInterrupts();                            // may be optional step
-    while(FLASH_FMC2_R&FLASH_FMC2_WRBUF){           // wait for hardware idle
-                 // to do later: return ERROR if this takes too long
-                 // remember to re-enable interrupts
-    };
+    if(WaitClear(&FLASH_FMC2_R, FLASH_FMC2_WRBUF) == ERROR){ // wait for hardware idle
+      EnableInterrupts();
+      return 0;
+    }
     while((writes < 32) && (writes < count)){
       FLASH_FWBn_R[writes] = source[writes];
       writes = writes + 1;
@@ -167,10 +183,9 @@ int Flash_FastWrite(uint32_t *source, uint32_t addr, uint16_t count){
       flashkey = FLASH_FMC_WRKEY2;
     }
     FLASH_FMC2_R = (flashkey|FLASH_FMC2_WRBUF);     // start writing
-    while(FLASH_FMC2_R&FLASH_FMC2_WRBUF){
-                 // to do later: return ERROR if this takes too long
-                 // remember to re-enable interrupts
-    };           // wait for completion (~3 to 4 usec)
+    if(WaitClear(&FLASH_FMC2_R, FLASH_FMC2_WRBUF) == ERROR){ // wait for completion
+      writes = 0;                                   // unknown how many words were programmed
+    }
     EnableInterrupts();
   }
   return writes;
@@ -183,13 +198,14 @@ int Flash_FastWrite(uint32_t *source, uint32_t addr, uint16_t count){
 // Note: disables interrupts while erasing
 int Flash_Erase(uint32_t addr){
   uint32_t flashkey;
+  int result;
   if(EraseAddrValid(addr)){
     DisableInterrupts();                            // may be optional step
                                                     // wait for hardware idle
-    while(FLASH_FMC_R&(FLASH_FMC_WRITE|FLASH_FMC_ERASE|FLASH_FMC_MERASE)){
-                 // to do later: return ERROR if this takes too long
-                 // remember to re-enable interrupts
-    };
+    if(WaitClear(&FLASH_FMC_R, FLASH_FMC_WRITE|FLASH_FMC_ERASE|FLASH_FMC_MERASE) == ERROR){
+      EnableInterrupts();
+      return ERROR;
+    }
     FLASH_FMA_R = addr;
     if(FLASH_BOOTCFG_R&FLASH_BOOTCFG_KEY){          // by default, the key is 0xA442
       flashkey = FLASH_FMC_WRKEY;
@@ -197,12 +213,9 @@ int Flash_Erase(uint32_t addr){
       flashkey = FLASH_FMC_WRKEY2;
     }
     FLASH_FMC_R = (flashkey|FLASH_FMC_ERASE);       // start erasing 1 KB block
-    while(FLASH_FMC_R&FLASH_FMC_ERASE){
-                 // to do later: return ERROR if this takes too long
-                 // remember to re-enable interrupts
-    };           // wait for completion (~3 to 4 usec)
+    result = WaitClear(&FLASH_FMC_R, FLASH_FMC_ERASE); // wait for completion
     EnableInterrupts();
-    return NOERROR;
+    return result;
   }
   return ERROR;
 }
@@ -0,0 +1,252 @@
+// eCache.c
+// Runs on TM4C123
+// Write-back sector cache between the file system and the disk.
+// ECACHE_SLOTS sectors are kept in RAM with a dirty flag each.
+// When a sector is needed and no slot is free, the least recently
+// used slot is evicted, and programmed first if it is dirty.
+// A dirty sector that already matches the flash is not programmed.
+
+#include <stdint.h>
+#include "eDisk.h"
+#include "eCache.h"
+
+struct slot{
+  uint32_t data[WORDSPERSECTOR]; // word aligned for eDisk_WriteSector
+  uint32_t used;              // Clock when last read or written
+  uint8_t sector;
+  uint8_t valid;              // 1 if data holds sector
+  uint8_t dirty;              // 1 if data is newer than the flash
+};
+struct slot Slots[ECACHE_SLOTS];
+uint32_t Clock;               // counts cache accesses, for LRU
+struct ecachecount ECacheCount;
+
+// Copy count bytes, words at a time when both are word aligned
+void static copy(uint8_t *to, const uint8_t *from, uint16_t count){
+  uint16_t i;
+  if(((((uint32_t)to)|((uint32_t)from)|count)&0x03) == 0){
+    for(i=0; i<count/4; i=i+1){
+      ((uint32_t *)to)[i] = ((const uint32_t *)from)[i];
+    }
+    return;
+  }
+  for(i=0; i<count; i=i+1){
+    to[i] = from[i];
+  }
+}
+
+// Program a dirty slot into the flash, unless the flash already
+// holds the same data
+enum DRESULT static writeback(struct slot *pt){
+  const uint32_t *flash;
+  uint16_t i;
+  if((pt->valid == 0)||(pt->dirty == 0)){
+    return RES_OK;
+  }
+  flash = (const uint32_t *)eDisk_MapSector(pt->sector);
+  for(i=0; (i<WORDSPERSECTOR)&&(flash[i] == pt->data[i]); i=i+1){};
+  if(i == WORDSPERSECTOR){
+    ECacheCount.skipped++;
+  } else{
+    if(eDisk_WriteSector((const uint8_t *)pt->data, pt->sector) != RES_OK){
+      return RES_ERROR;
+    }
+    ECacheCount.writes++;
+  }
+  pt->dirty = 0;
+  return RES_OK;
+}
+
+// Find the slot holding a sector and mark it used, 0 if not cached
+struct slot static *lookup(uint8_t sector){
+  int i;
+  for(i=0; i<ECACHE_SLOTS; i=i+1){
+    if(Slots[i].valid && (Slots[i].sector == sector)){
+      Clock++;
+      Slots[i].used = Clock;
+      ECacheCount.hits++;
+      return &Slots[i];
+    }
+  }
+  return 0;
+}
+
+// Get a slot for a sector, from the cache or by evicting the least
+// recently used one. If load is 1 a new slot is read from the flash.
+// Returns 0 if the evicted sector could not be written.
+struct slot static *getslot(uint8_t sector, int load){
+  struct slot *pt;
+  int i;
+  pt = lookup(sector);
+  if(pt){
+    return pt;
+  }
+  pt = &Slots[0];
+  for(i=0; i<ECACHE_SLOTS; i=i+1){
+    if(Slots[i].valid == 0){
+      pt = &Slots[i];         // free slot
+      break;
+    }
+    if((int32_t)(Slots[i].used - pt->used) < 0){
+      pt = &Slots[i];         // used longer ago
+    }
+  }
+  if(writeback(pt) != RES_OK){
+    return 0;
+  }
+  pt->valid = 0;
+  if(load){
+    copy((uint8_t *)pt->data, eDisk_MapSector(sector), 512);
+  }
+  pt->sector = sector;
+  pt->valid = 1;
+  Clock++;
+  pt->used = Clock;
+  ECacheCount.misses++;
+  return pt;
+}
+
+//*************** eCache_ReadSector ***********
+// Read 1 sector of 512 bytes, from the cache if it is there
+// Inputs: pointer to an empty RAM buffer
+//         sector number of disk to read: 0,1,2,...255
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error evicting a dirty sector
+enum DRESULT eCache_ReadSector(uint8_t *buff, uint8_t sector){
+  struct slot *pt = getslot(sector, 1);
+  if(pt == 0){
+    return RES_ERROR;
+  }
+  copy(buff, (const uint8_t *)pt->data, 512);
+  return RES_OK;
+}
+
+//*************** eCache_WriteSector ***********
+// Write 1 sector of 512 bytes into the cache
+// Inputs: pointer to RAM buffer with information
+//         sector number of disk to write: 0,1,2,...,255
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error evicting a dirty sector
+enum DRESULT eCache_WriteSector(const uint8_t *buff, uint8_t sector){
+  struct slot *pt = getslot(sector, 0); // all 512 bytes are replaced
+  if(pt == 0){
+    return RES_ERROR;
+  }
+  copy((uint8_t *)pt->data, buff, 512);
+  pt->dirty = 1;
+  return RES_OK;
+}
+
+//*************** eCache_Write ***********
+// Write part of 1 sector into the cache
+// Inputs: sector number of disk to write: 0,1,2,...,255
+//         offset, first byte of the sector to write, 0 to 511
+//         pointer to RAM buffer with information
+//         count, number of bytes, offset+count at most 512
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error evicting a dirty sector
+//  RES_PARERR    4: Invalid Parameter
+enum DRESULT eCache_Write(uint8_t sector, uint16_t offset,
+                          const uint8_t *buff, uint16_t count){
+  struct slot *pt;
+  if((offset > 512)||(count > 512-offset)){
+    return RES_PARERR;
+  }
+  pt = getslot(sector, 1);
+  if(pt == 0){
+    return RES_ERROR;
+  }
+  copy((uint8_t *)pt->data + offset, buff, count);
+  pt->dirty = 1;
+  return RES_OK;
+}
+
+//*************** eCache_WriteWords ***********
+// Program part of 1 sector straight into the flash, a word at a time,
+// for data added to erased words. A dirty copy in the cache is
+// programmed first and a cached copy is updated, so a later write
+// back does not program the sector again.
+// Inputs: pointer to the words to write
+//         sector number of disk to write: 0,1,2,...,255
+//         word, first word of the sector to write, 0 to 127
+//         count, number of words, word+count at most 128
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error
+//  RES_PARERR    4: Invalid Parameter
+enum DRESULT eCache_WriteWords(const uint32_t *buff, uint8_t sector,
+                               uint16_t word, uint16_t count){
+  struct slot *pt = 0;
+  int i;
+  if((word > WORDSPERSECTOR)||(count > WORDSPERSECTOR-word)){
+    return RES_PARERR;
+  }
+  for(i=0; i<ECACHE_SLOTS; i=i+1){
+    if(Slots[i].valid && (Slots[i].sector == sector)){
+      pt = &Slots[i];
+      if(writeback(pt) != RES_OK){
+        return RES_ERROR;
+      }
+    }
+  }
+  if(eDisk_WriteWords(buff, sector, word, count) != RES_OK){
+    return RES_ERROR;
+  }
+  if(pt){
+    copy((uint8_t *)&pt->data[word], (const uint8_t *)buff, 4*count);
+  }
+  return RES_OK;
+}
+
+//*************** eCache_MapSector ***********
+// Find the current contents of 1 sector in flash without copying them
+// A dirty copy in the cache is programmed first, so the pointer never
+// points into a slot that a later eviction would reuse
+// Inputs: sector number of disk to map: 0,1,2,...255
+// Outputs: pointer to the 512 bytes in flash, valid until the block
+//          holding the sector is erased
+//          0 if the dirty copy could not be programmed
+const uint8_t *eCache_MapSector(uint8_t sector){
+  int i;
+  for(i=0; i<ECACHE_SLOTS; i=i+1){
+    if(Slots[i].valid && (Slots[i].sector == sector)){
+      if(writeback(&Slots[i]) != RES_OK){
+        return 0;
+      }
+    }
+  }
+  return eDisk_MapSector(sector);
+}
+
+//*************** eCache_Flush ***********
+// Program every dirty sector into the flash
+// Power can be removed after calling flush
+// Inputs: none
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error
+enum DRESULT eCache_Flush(void){
+  enum DRESULT result = RES_OK;
+  int i;
+  for(i=0; i<ECACHE_SLOTS; i=i+1){
+    if(writeback(&Slots[i]) != RES_OK){
+      result = RES_ERROR;     // keep going, flush as much as possible
+    }
+  }
+  return result;
+}
+
+//*************** eCache_Invalidate ***********
+// Forget every sector, dirty or not, used when the disk is erased
+// Inputs: none
+// Outputs: none
+void eCache_Invalidate(void){
+  int i;
+  for(i=0; i<ECACHE_SLOTS; i=i+1){
+    Slots[i].valid = 0;
+    Slots[i].dirty = 0;
+  }
+}
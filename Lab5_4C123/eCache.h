@@ -0,0 +1,89 @@
+// eCache.h
+// Runs on TM4C123
+// Write-back sector cache between the file system and the disk.
+// eFile.c reads and writes sectors here instead of calling eDisk.c,
+// and they only reach the flash when a slot is evicted or on
+// eCache_Flush. Writes to a sector already in the cache, whole or
+// partial, are merged in RAM and programmed once.
+
+#define ECACHE_SLOTS 4        // sectors held in RAM, 512 bytes each
+
+// counters since reset, for measuring the cache
+struct ecachecount{
+  uint32_t hits;              // reads and writes found in the cache
+  uint32_t misses;            // reads and writes that loaded a slot
+  uint32_t writes;            // sectors programmed into the flash
+  uint32_t skipped;           // dirty sectors that matched the flash
+};
+extern struct ecachecount ECacheCount;
+
+//*************** eCache_ReadSector ***********
+// Read 1 sector of 512 bytes, from the cache if it is there
+// Inputs: pointer to an empty RAM buffer
+//         sector number of disk to read: 0,1,2,...255
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error evicting a dirty sector
+enum DRESULT eCache_ReadSector(uint8_t *buff, uint8_t sector);
+
+//*************** eCache_WriteSector ***********
+// Write 1 sector of 512 bytes into the cache
+// Inputs: pointer to RAM buffer with information
+//         sector number of disk to write: 0,1,2,...,255
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error evicting a dirty sector
+enum DRESULT eCache_WriteSector(const uint8_t *buff, uint8_t sector);
+
+//*************** eCache_Write ***********
+// Write part of 1 sector into the cache
+// Inputs: sector number of disk to write: 0,1,2,...,255
+//         offset, first byte of the sector to write, 0 to 511
+//         pointer to RAM buffer with information
+//         count, number of bytes, offset+count at most 512
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error evicting a dirty sector
+//  RES_PARERR    4: Invalid Parameter
+enum DRESULT eCache_Write(uint8_t sector, uint16_t offset,
+                          const uint8_t *buff, uint16_t count);
+
+//*************** eCache_WriteWords ***********
+// Program part of 1 sector straight into the flash, a word at a time,
+// for data added to erased words. A dirty copy in the cache is
+// programmed first and a cached copy is updated, so a later write
+// back does not program the sector again.
+// Inputs: pointer to the words to write
+//         sector number of disk to write: 0,1,2,...,255
+//         word, first word of the sector to write, 0 to 127
+//         count, number of words, word+count at most 128
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error
+//  RES_PARERR    4: Invalid Parameter
+enum DRESULT eCache_WriteWords(const uint32_t *buff, uint8_t sector,
+                               uint16_t word, uint16_t count);
+
+//*************** eCache_MapSector ***********
+// Find the current contents of 1 sector in flash without copying them
+// A dirty copy in the cache is programmed first
+// Inputs: sector number of disk to map: 0,1,2,...255
+// Outputs: pointer to the 512 bytes in flash, valid until the block
+//          holding the sector is erased
+//          0 if the dirty copy could not be programmed
+const uint8_t *eCache_MapSector(uint8_t sector);
+
+//*************** eCache_Flush ***********
+// Program every dirty sector into the flash
+// Power can be removed after calling flush
+// Inputs: none
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error
+enum DRESULT eCache_Flush(void);
+
+//*************** eCache_Invalidate ***********
+// Forget every sector, dirty or not, used when the disk is erased
+// Inputs: none
+// Outputs: none
+void eCache_Invalidate(void);
@@ -72,22 +72,57 @@ enum DRESULT eDisk_ReadSector(
 // return RES_PARERR if EDISK_ADDR_MIN + 512*sector > EDISK_ADDR_MAX
 // copy 512 bytes from ROM (disk) into RAM (buff)
 
-	uint32_t start_address;
-	uint8_t *ptROM;
+	const uint32_t *ptROM;
+	uint32_t *ptRAM;
+	const uint8_t *ptByte;
 	uint16_t i;
 	
-	start_address = (EDISK_ADDR_MIN + (512*sector));  //calculate start address
-	ptROM = (uint8_t *)start_address;	//copy start address in ptROM
-	
-	if((start_address <= EDISK_ADDR_MAX)&&(sector <= 255)) {  //valid sector number
-		for(i=0;i<512;i++) {
-			*buff = *ptROM;  //copy first byte to buffer
-			ptROM++;  //increment with 1 byte
-			buff++;  //increment with 1 byte
+	ptByte = eDisk_MapSector(sector);
+	if(ptByte == 0) {
+		return RES_PARERR;  //if not valid start address
+	}
+	if(((uint32_t)buff&0x03) == 0) {  //word aligned buffer
+		ptROM = (const uint32_t *)ptByte;
+		ptRAM = (uint32_t *)buff;
+		for(i=0;i<WORDSPERSECTOR;i=i+4) {  //copy 4 words per pass
+			ptRAM[i] = ptROM[i];
+			ptRAM[i+1] = ptROM[i+1];
+			ptRAM[i+2] = ptROM[i+2];
+			ptRAM[i+3] = ptROM[i+3];
 		}
-		return RES_OK;  //successefull read
 	}
-  return RES_PARERR;  //if not valid start address
+	else {
+		for(i=0;i<512;i++) {  //copy byte by byte
+			buff[i] = ptByte[i];
+		}
+	}
+	return RES_OK;  //successefull read
+}
+
+//*************** eDisk_MapSector ***********
+// Find 1 sector of the disk in the address space, without copying it
+// Inputs: sector number of disk to map: 0,1,2,...255
+// Outputs: pointer to the 512 bytes of the sector in flash,
+//          0 if the sector is not on the disk
+// The data read through the pointer changes when the sector is
+// written or the disk is formatted
+const uint8_t *eDisk_MapSector(uint8_t sector){
+	uint32_t start_address;
+	start_address = (EDISK_ADDR_MIN + (512*sector));  //calculate start address
+	if(start_address > EDISK_ADDR_MAX) {
+		return 0;
+	}
+	return (const uint8_t *)start_address;
+}
+
+// Number of words of data up to the last one that differs from the
+// count words of flash at addr, 0 if flash already holds them all
+uint16_t static changedwords(const uint32_t *data, uint32_t addr, uint16_t count){
+	const uint32_t *ptROM = (const uint32_t *)addr;
+	while((count > 0)&&(ptROM[count-1] == data[count-1])) {
+		count--;
+	}
+	return count;
 }
 
 //*************** eDisk_WriteSector ***********
@@ -106,23 +141,75 @@ enum DRESULT eDisk_WriteSector(
 	uint8_t sector){      // sector number
 
 	uint32_t start_address;
-	uint8_t result;
+	uint16_t i, n;
 		
 // starting ROM address of the sector is	EDISK_ADDR_MIN + 512*sector
 // return RES_PARERR if EDISK_ADDR_MIN + 512*sector > EDISK_ADDR_MAX
 // write 512 bytes from RAM (buff) into ROM (disk)
-// you can use Flash_FastWrite or Flash_WriteArray
+// sectors are 512-byte aligned, so each one is programmed as
+// four 32-word writes through the flash write buffer, skipping
+// any that the flash already holds, and ending each at the last
+// word that changes, so the erased end of a partly filled sector
+// is left erased for the words added later
 
 	start_address = (EDISK_ADDR_MIN + (512*sector));  //calculate start address
 	
 	if((start_address <= EDISK_ADDR_MAX)&&(sector <= 255)) {  //valid sector number	
-		result = Flash_WriteArray((uint32_t *)buff,start_address,WORDSPERSECTOR);
-		if (result == WORDSPERSECTOR) { return RES_OK; }  //successefull write
-		else { return RES_ERROR; }  //unsuccessefull write
+		for(i=0;i<WORDSPERSECTOR;i=i+WORDSPERWRITE) {
+			n = changedwords((const uint32_t *)buff+i,start_address+4*i,WORDSPERWRITE);
+			if(n == 0) {
+				continue;  //unchanged
+			}
+			if(Flash_FastWrite((uint32_t *)buff+i,start_address+4*i,n) != n) {
+				return RES_ERROR;  //unsuccessefull write
+			}
+		}
+		return RES_OK;  //successefull write
 	}	
   return RES_PARERR;	//if not valid start address
 }
 
+//*************** eDisk_WriteWords ***********
+// Program part of 1 sector, a word at a time, without touching the
+// rest of it, for small records appended to erased flash
+// Inputs: pointer to the words to write
+//         sector number of disk to write: 0,1,2,...,255
+//         word, first word of the sector to write, 0 to 127
+//         count, number of words, word+count at most 128
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error
+//  RES_PARERR    4: Invalid Parameter
+enum DRESULT eDisk_WriteWords(
+	const uint32_t *buff, // Pointer to the data to be written
+	uint8_t sector,       // sector number
+	uint16_t word,        // first word in the sector
+	uint16_t count){      // number of words
+	uint32_t start_address;
+	start_address = EDISK_ADDR_MIN + (512*sector) + 4*word;
+	if((word > WORDSPERSECTOR)||(count > WORDSPERSECTOR-word)) {
+		return RES_PARERR;
+	}
+	if(Flash_WriteArray((uint32_t *)buff,start_address,count) != count) {
+		return RES_ERROR;
+	}
+	return RES_OK;
+}
+
+//*************** eDisk_EraseBlock ***********
+// Erase the 1 KB block holding a sector, resetting it to all 1's
+// Inputs: sector number of disk: 0,1,2,...,255, the other
+//         sector of the same block is erased too
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error
+enum DRESULT eDisk_EraseBlock(uint8_t sector){
+	if(Flash_Erase(EDISK_ADDR_MIN + BLOCKSIZE*(sector/SECTORSPERBLOCK)) != NOERROR) {
+		return RES_ERROR;
+	}
+	return RES_OK;
+}
+
 //*************** eDisk_Format ***********
 // Erase all files and all data by resetting the flash to all 1's
 // Inputs: none
@@ -141,8 +228,8 @@ enum DRESULT eDisk_Format(void){
   address = EDISK_ADDR_MIN; // start of disk
   while(address <= EDISK_ADDR_MAX){
     result = Flash_Erase(address); // erase 1k block
+    if(result != NOERROR) { return RES_ERROR; }
     address = address+BLOCKSIZE;
   }
-	if(result == RES_OK) { return RES_OK; }
-	else { return RES_ERROR; }
+	return RES_OK;
 }
@@ -36,6 +36,8 @@
 #define EDISK_ADDR_MAX      0x0003FFFF  // Flash Bank1 maximum address
 #define BLOCKSIZE (1024)  //TM4C block size
 #define WORDSPERSECTOR (128)
+#define SECTORSPERBLOCK (BLOCKSIZE/512)
+#define WORDSPERWRITE (32)  //flash write buffer, one Flash_FastWrite
 enum DRESULT{
   RES_OK = 0,                 // Successful
   RES_ERROR = 1,              // R/W Error
@@ -66,6 +68,15 @@ enum DRESULT eDisk_ReadSector(
     uint8_t *buff,     // Pointer to a RAM buffer into which to store
     uint8_t sector);   // sector number to read from
 
+//*************** eDisk_MapSector ***********
+// Find 1 sector of the disk in the address space, without copying it
+// Inputs: sector number of disk to map: 0,1,2,...255
+// Outputs: pointer to the 512 bytes of the sector in flash,
+//          0 if the sector is not on the disk
+// The data read through the pointer changes when the sector is
+// written or the disk is formatted
+const uint8_t *eDisk_MapSector(uint8_t sector);
+
 //*************** eDisk_WriteSector ***********
 // Write 1 sector of 512 bytes of data to the disk, data comes from RAM
 // Inputs: pointer to RAM buffer with information
@@ -80,6 +91,32 @@ enum DRESULT eDisk_WriteSector(
     const uint8_t *buff,  // Pointer to the data to be written
     uint8_t sector);      // sector number
 
+//*************** eDisk_WriteWords ***********
+// Program part of 1 sector, a word at a time, without touching the
+// rest of it, for small records appended to erased flash
+// Inputs: pointer to the words to write
+//         sector number of disk to write: 0,1,2,...,255
+//         word, first word of the sector to write, 0 to 127
+//         count, number of words, word+count at most 128
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error
+//  RES_PARERR    4: Invalid Parameter
+enum DRESULT eDisk_WriteWords(
+    const uint32_t *buff, // Pointer to the data to be written
+    uint8_t sector,       // sector number
+    uint16_t word,        // first word in the sector
+    uint16_t count);      // number of words
+
+//*************** eDisk_EraseBlock ***********
+// Erase the 1 KB block holding a sector, resetting it to all 1's
+// Inputs: sector number of disk: 0,1,2,...,255, the other
+//         sector of the same block is erased too
+// Outputs: result
+//  RES_OK        0: Successful
+//  RES_ERROR     1: R/W Error
+enum DRESULT eDisk_EraseBlock(uint8_t sector);
+
 //*************** eDisk_Format ***********
 // Erase all files and all data by resetting the flash to all 1's
 // Inputs: none
@@ -5,114 +5,409 @@
 // August 29, 2016
 #include <stdint.h>
 #include "eDisk.h"
+#include "eCache.h"
+#include "eFile.h"
 
 uint8_t Buff[512]; // temporary buffer used during file I/O
 uint8_t Directory[256], FAT[256];
-int32_t bDirectoryLoaded =0; // 0 means disk on ROM is complete, 1 means RAM version active
+int32_t bDirectoryLoaded =0; // 0 means RAM must be loaded from the disk, 1 means RAM version active
 
-// Return the larger of two integers.
-int16_t max(int16_t a, int16_t b){
-  if(a > b){
-    return a;
-  }
-  return b;
+// Free sectors, rebuilt from the FAT by MountDirectory
+// Bit 31-(n%32) of FreeMap[n/32] is set when sector n is free,
+// so the lowest free sector in a word is found with a single CLZ.
+// Sectors from METASECTOR up hold the directory and FAT log and
+// are never free.
+uint32_t FreeMap[8];
+#define FREEBIT(n) (0x80000000>>((n)&0x1F))
+
+// Last sector and number of sectors of each file, kept in RAM only
+// and rebuilt from the FAT by MountDirectory, so appending and
+// OS_File_Size do not follow the chain. LastSector is 255 if empty.
+uint8_t LastSector[256], NumSectors[256];
+
+// Sectors of one file in order, so OS_File_Read finds any location
+// without following the chain. Built by OS_File_Read the first time
+// it reads file IndexFile, extended by appendfat, and dropped by
+// scanfat. 255 bytes of RAM cover any file, but only one at a time,
+// so reading two files in turn rebuilds it each time; use a
+// FileCursor for that.
+uint8_t Index[255];
+uint8_t IndexFile = 255; // 255 means no file is indexed
+
+// Bytes of data in the last sector of each file, 1 to 512, so a file
+// written with OS_File_WriteBytes can end part way through a sector.
+// 512 for an empty file and for files written a sector at a time.
+uint16_t Tail[256];
+
+// Directory and FAT are stored as a log in the top METABLOCKS erase
+// blocks rather than in one fixed sector. Each block starts with a
+// header word holding a sequence number, then a snapshot of every
+// Directory and FAT byte that is not 255, then the bytes changed by
+// each later flush. A snapshot or flush is a record of entries, one
+// word per byte, closed by a commit word:
+//   entry  bits 31-28 ENTRY, bits 16-8 offset (0-255 in Directory,
+//          256-511 in FAT), bits 7-0 new value, and for a Directory
+//          byte bits 25-17 hold the Tail of that file minus 1
+//   commit bits 31-28 COMMIT, bits 15-0 CRC of the block so far
+// so a flush programs only the words it adds, and a flush cut short
+// by a power failure has no valid commit and is ignored. Mount
+// replays the block with the highest sequence number that has a
+// valid commit, up to its last one. When a flush does not fit in the
+// block, the oldest block is erased and starts over with a snapshot;
+// the block before it stays valid until that snapshot commits, and
+// the erases rotate through the region. Each used sector is either
+// the first of its file or follows another in the FAT, so a snapshot
+// is at most one word per data sector and always fits in a block.
+// Mount reads each block once, so it takes the same time whatever
+// the log holds.
+// Near a full disk a snapshot fills most of a block, so the log
+// starts a new block every few flushes. Rotating those through
+// METABLOCKS blocks spreads the directory erases, so a log block
+// wears no faster than a data block (see wear.c). The price is
+// 4 more sectors of the disk, 244 left for data, and a mount that
+// reads 6 blocks.
+#define METABLOCKS    6
+
+// The TExaS Lab 5 grader reads the directory and FAT from sector 255,
+// in the layout before the log: Directory in its first 256 bytes and
+// FAT in the rest. Build with GRADERLAYOUT 1 to run the grader. The
+// top block then keeps that copy, out of the log and the data, and
+// each flush programs the words of it that changed, so a word can be
+// programmed up to 4 times between formats. Mount still reads the log.
+#ifndef GRADERLAYOUT
+#define GRADERLAYOUT  0
+#endif
+#define COPYSECTOR    255 // copy for the grader, if GRADERLAYOUT is 1
+#define METASECTOR    (256-(METABLOCKS+GRADERLAYOUT)*SECTORSPERBLOCK) // first log sector
+#define WORDSPERBLOCK (BLOCKSIZE/4)
+#define HEADER        0x40000000 // bits 23-0 are the sequence number
+#define ENTRY         0x50000000
+#define COMMIT        0x60000000
+#define TAGMASK       0xF0000000
+#define FULLTAIL      0x03FE0000 // entry bits for a Tail of 512
+uint8_t SavedDirectory[256], SavedFAT[256]; // as last logged
+uint16_t SavedTail[256];
+uint32_t MetaBlock;    // block of the region being appended to
+uint32_t MetaNext;     // next free word in it, WORDSPERBLOCK if none
+uint32_t MetaSequence; // sequence number in its header
+uint16_t MetaCRC;      // CRC of its words up to MetaNext
+
+// Log entry for Directory or FAT byte 'offset', 0 to 511
+uint32_t static entry(uint8_t *directory, uint8_t *fat, uint16_t *tail, uint16_t offset){
+	if(offset < 256) {
+		return ENTRY|((uint32_t)((tail[offset]-1)&0x1FF)<<17)|(offset<<8)|directory[offset];
+	}
+	return ENTRY|(offset<<8)|fat[offset-256];
+}
+
+// First word of block 'block' of the log, in flash
+const uint32_t static *mapblock(uint32_t block){
+	return (const uint32_t *)eDisk_MapSector(METASECTOR + SECTORSPERBLOCK*block);
+}
+
+// CRC-16-CCITT of the 4 bytes of a word, continuing from crc
+uint16_t static crcword(uint16_t crc, uint32_t word){
+	int i;
+	for(i=0;i<32;i++) {
+		if(((crc>>15)^(word>>31))&1) {
+			crc = (crc<<1)^0x1021;
+		}
+		else {
+			crc = crc<<1;
+		}
+		word = word<<1;
+	}
+	return crc;
+}
+
+// Number of words at the start of the block, header included, up to
+// and including its last valid commit, or 0 if it has none.
+// Sets *clean to 1 if every word after that is still erased.
+uint32_t static committed(const uint32_t *block, int *clean, uint16_t *crc){
+	uint32_t i, end = 0, word;
+	uint16_t sum = crcword(0xFFFF, block[0]);
+	for(i=1;i<WORDSPERBLOCK;i++) {
+		word = block[i];
+		if((word&TAGMASK) == COMMIT) {
+			if(word != (COMMIT|sum)) {
+				break;  //torn record
+			}
+			end = i+1;
+			*crc = crcword(sum, word);
+		}
+		else if(((word&TAGMASK) != ENTRY)||(word&0x0C000000)) {
+			break;  //erased, or not an entry
+		}
+		sum = crcword(sum, word);
+	}
+	*clean = (end != 0);
+	for(i=end;(i<WORDSPERBLOCK)&&*clean;i++) {
+		*clean = (block[i] == 0xFFFFFFFF);
+	}
+	return end;
+}
+
+// Rebuild Directory, FAT and Tail from the newest block with a
+// valid commit, an empty disk if there is none
+// Outputs: 1 if a block was found
+int static loadlog(void){
+	const uint32_t *block;
+	uint32_t b, i, end = 0, word;
+	int found = 0, clean = 0, c;
+	uint16_t crc = 0xFFFF;
+	for(i=0;i<256;i++) {
+		Directory[i] = 255;
+		FAT[i] = 255;
+		Tail[i] = 512;
+	}
+	for(b=0;b<METABLOCKS;b++) {
+		block = mapblock(b);
+		if((block[0]&TAGMASK) != HEADER) {
+			continue;
+		}
+		if(found && ((int32_t)((block[0]-(HEADER|MetaSequence))<<8) <= 0)) {
+			continue;  //older than the one found
+		}
+		i = committed(block, &c, &crc);
+		if(i) {
+			found = 1;
+			MetaBlock = b;
+			MetaSequence = block[0]&0x00FFFFFF;
+			MetaCRC = crc;
+			end = i;
+			clean = c;
+		}
+	}
+	if(found == 0) {
+		MetaBlock = METABLOCKS-1;
+		MetaNext = WORDSPERBLOCK;  //the next flush starts block 0
+		MetaSequence = 0;
+		return 0;
+	}
+	block = mapblock(MetaBlock);
+	for(b=1;b<end;b++) {
+		word = block[b];
+		if((word&TAGMASK) != ENTRY) {
+			continue;  //commit
+		}
+		i = (word>>8)&0x1FF;  //offset
+		if(i < 256) {
+			Directory[i] = word&0xFF;
+			Tail[i] = ((word>>17)&0x1FF)+1;
+		}
+		else {
+			FAT[i-256] = word&0xFF;
+		}
+	}
+	MetaNext = clean ? end : WORDSPERBLOCK;  //never write after a torn word
+	return 1;
+}
+
+// Program the next word of the log
+enum DRESULT static logword(uint32_t word){
+	uint8_t sector = METASECTOR + SECTORSPERBLOCK*MetaBlock + MetaNext/WORDSPERSECTOR;
+	if(eDisk_WriteWords(&word, sector, MetaNext%WORDSPERSECTOR, 1) != RES_OK) {
+		return RES_ERROR;
+	}
+	MetaNext++;
+	MetaCRC = crcword(MetaCRC, word);
+	return RES_OK;
+}
+
+// Program the entries of every byte that differs from the saved
+// copy, or from 255 for a snapshot, then the commit
+enum DRESULT static logrecord(int snapshot){
+	uint16_t i;
+	uint32_t word, old;
+	for(i=0;i<512;i++) {
+		word = entry(Directory, FAT, Tail, i);
+		old = snapshot ? (ENTRY|((i < 256) ? FULLTAIL : 0)|(i<<8)|255) : entry(SavedDirectory, SavedFAT, SavedTail, i);
+		if((word != old)&&(logword(word) != RES_OK)) {
+			return RES_ERROR;
+		}
+	}
+	return logword(COMMIT|MetaCRC);
+}
+
+// Erase the oldest block and write a snapshot of Directory and FAT
+// there, which becomes the newest block once its commit is written.
+// If a step fails the snapshot is left pending: MetaNext is set to
+// WORDSPERBLOCK so the next flush starts a snapshot again, and
+// MetaBlock steps back so it erases the same block, never the newest
+// block with a commit, before programming anything.
+enum DRESULT static logsnapshot(void){
+	MetaBlock = (MetaBlock+1)%METABLOCKS;
+	MetaSequence = (MetaSequence+1)&0x00FFFFFF;
+	MetaNext = 0;
+	MetaCRC = 0xFFFF;
+	if((eDisk_EraseBlock(METASECTOR + SECTORSPERBLOCK*MetaBlock) != RES_OK)||
+	   (logword(HEADER|MetaSequence) != RES_OK)||(logrecord(1) != RES_OK)) {
+		MetaBlock = (MetaBlock+METABLOCKS-1)%METABLOCKS;
+		MetaSequence = (MetaSequence-1)&0x00FFFFFF;
+		MetaNext = WORDSPERBLOCK;  //snapshot pending
+		return RES_ERROR;
+	}
+	return RES_OK;
+}
+
+// Log the Directory and FAT bytes that changed since the last call,
+// or a snapshot in a new block if they do not fit in this one
+enum DRESULT static logchanges(void){
+	uint16_t i, count = 0;
+	for(i=0;i<512;i++) {
+		if(entry(Directory, FAT, Tail, i) != entry(SavedDirectory, SavedFAT, SavedTail, i)) {
+			count++;
+		}
+	}
+	if(count == 0) {
+		return RES_OK;  //nothing to write
+	}
+	if(MetaNext+count+1 > WORDSPERBLOCK) {
+		if(logsnapshot() != RES_OK) {
+			return RES_ERROR;
+		}
+	}
+	else if(logrecord(0) != RES_OK) {
+		MetaNext = WORDSPERBLOCK;  //never append after a failed record
+		return RES_ERROR;
+	}
+	for(i=0;i<256;i++) {
+		SavedDirectory[i] = Directory[i];
+		SavedFAT[i] = FAT[i];
+		SavedTail[i] = Tail[i];
+	}
+	return RES_OK;
+}
+
+#if GRADERLAYOUT
+// Word i of sector 255 in the layout the grader reads
+uint32_t static graderword(uint16_t i){
+	const uint8_t *pt = (i < 64) ? &Directory[4*i] : &FAT[4*i-256];
+	return pt[0]|(pt[1]<<8)|(pt[2]<<16)|((uint32_t)pt[3]<<24);
 }
+
+// Program the words of the copy in COPYSECTOR that differ from
+// Directory and FAT. Bytes only change from 255 between formats, so
+// the copy is erased first only if a power failure tore a word of it.
+enum DRESULT static gradercopy(void){
+	const uint32_t *copy = (const uint32_t *)eDisk_MapSector(COPYSECTOR);
+	uint32_t word;
+	uint16_t i;
+	for(i=0;i<WORDSPERSECTOR;i++) {
+		if(graderword(i)&~copy[i]) {  //needs a bit back to 1
+			if(eDisk_EraseBlock(COPYSECTOR) != RES_OK) {
+				return RES_ERROR;
+			}
+			break;
+		}
+	}
+	for(i=0;i<WORDSPERSECTOR;i++) {
+		word = graderword(i);
+		if((word != copy[i])&&(eDisk_WriteWords(&word, COPYSECTOR, i, 1) != RES_OK)) {
+			return RES_ERROR;
+		}
+	}
+	return RES_OK;
+}
+#endif
+
+// Rebuild FreeMap, LastSector and NumSectors from Directory and FAT.
+// A chain ends early at a sector already in use, so a corrupt FAT
+// with a loop or two files sharing a sector can not hang the mount,
+// which follows at most one FAT entry per sector.
+void static scanfat(void){
+	uint16_t i, count;
+	uint8_t sector;
+	for(i=0;i<8;i++) {
+		FreeMap[i] = 0xFFFFFFFF;
+	}
+	for(i=METASECTOR;i<256;i++) {
+		FreeMap[i/32] &= ~FREEBIT(i);	//directory and FAT log
+	}
+	for(i=0;i<256;i++) {
+		LastSector[i] = 255;
+		sector = Directory[i];
+		for(count=0;(sector < METASECTOR)&&(FreeMap[sector/32]&FREEBIT(sector))&&(i != 255);count++) {
+			FreeMap[sector/32] &= ~FREEBIT(sector);
+			LastSector[i] = sector;
+			sector = FAT[sector];
+		}
+		NumSectors[i] = count;
+	}
+	IndexFile = 255;
+}
+
 //*****MountDirectory******
 // if directory and FAT are not loaded in RAM,
 // bring it into RAM from disk
 void MountDirectory(void){ 
 	uint16_t i = 0;
 // if bDirectoryLoaded is 0, 
-//    read disk sector 255 and populate Directory and FAT
+//    replay the log to populate Directory and FAT
 //    set bDirectoryLoaded=1
 // if bDirectoryLoaded is 1, simply return
-// **write this function**
 
 	
 	if (bDirectoryLoaded == 0) { //If DIR & FAT is in ROM
-		eDisk_ReadSector(Buff,255);
+		loadlog();
 		for(i=0;i<256;i++) {
-			Directory[i] = Buff[i];	//Read first part of buffer to directory
-		}
-		for(i=256;i<512;i++) {
-			FAT[i-256] = Buff[i];	//Read first part of buffer to FAT
+			SavedDirectory[i] = Directory[i];
+			SavedFAT[i] = FAT[i];
+			SavedTail[i] = Tail[i];
 		}
+		scanfat();
 		bDirectoryLoaded = 1;
 	}
 	else { return; }
 	return;
-	/* 
-	//Alternative aproach to mount directory
-	volatile uint8_t *DirAddr = (volatile uint8_t *)(EDISK_ADDR_MAX - 511); // address of directory
-	volatile uint8_t *FATAddr = (volatile uint8_t *)(EDISK_ADDR_MAX - 255); // address of FAT
-	if(bDirectoryLoaded==0){
-		for (int i = 0; i < 256; i++){
-			Directory[i] = *DirAddr;
-			FAT[i] = *FATAddr;
-			DirAddr++;
-			FATAddr++;
-		}
-		bDirectoryLoaded=1;
-	}
-	return;	*/
-}
-
-// Return the index of the last sector in the file
-// associated with a given starting sector.
-// Note: This function will loop forever without returning
-// if the file has no end (i.e. the FAT is corrupted).
-uint8_t lastsector(uint8_t start){
-// **write this function**
-	while ((FAT[start] != 255)&&(start != 255)){
-		start = FAT[start];
-	}		
-	if(FAT[start] == 255){  //last sector of that file
-		return start;
-	}
-	if (start == 255){  // navigated through all FAT
-		return 255; 
+}
+
+// Return 1 if every word of the sector is erased
+int static erased(uint8_t sector){
+	const uint32_t *pt = (const uint32_t *)eDisk_MapSector(sector);
+	uint16_t i;
+	for(i=0;i<WORDSPERSECTOR;i++) {
+		if(pt[i] != 0xFFFFFFFF) {
+			return 0;
+		}
 	}
-	return 255;
+	return 1;
 }
 
-// Return the index of the first free sector.
-// Note: This function will loop forever without returning
-// if a file has no end or if (Directory[255] != 255)
-// (i.e. the FAT is corrupted).
+// Return the index of the first free sector,
+// or 255 if the disk is full.
+// A free sector that is not erased, left by a power failure
+// during a flush, can not be programmed and is skipped until
+// the next format.
 uint8_t findfreesector(void){
-// **write this function**
-	int8_t fs = -1;  //free sector
-	uint8_t i = 0;
-	uint8_t ls = 0;  //last sector
-	while(ls != 255) {//until one file end is found
-		ls = lastsector(Directory[i]); //Find the last sector of the current file in directory
-		if (ls == 255) { return (fs+1);} //return the next sector number
-		fs = max(fs,ls);
-		
-		i++;  //move to next file in directory  
+	uint8_t i, n;
+	for(i=0;i<8;i++) {
+		while(FreeMap[i]) {
+			n = 32*i + __clz(FreeMap[i]);
+			if(erased(n)) {
+				return n;
+			}
+			FreeMap[i] &= ~FREEBIT(n);
+		}
 	}
-  return 0; // replace this line
+	return 255;
 }
 
 // Append a sector index 'n' at the end of file 'num'.
 // This helper function is part of OS_File_Append(), which
 // should have already verified that there is free space,
 // so it always returns 0 (successful).
-// Note: This function will loop forever without returning
-// if the file has no end (i.e. the FAT is corrupted).
 uint8_t appendfat(uint8_t num, uint8_t n){
-// **write this function**
-  //AleGaa
-	uint8_t i = 0;
-	i = Directory[num];
-	if(i == 255) { Directory[num] = n; } //New file added
+	if(LastSector[num] == 255) { Directory[num] = n; } //New file added
 	else {
-		while(FAT[i] != 255) {  //Not last sector of the file
-			i = FAT[i];  //Move to next linked sector
-		}
-		FAT[i] = n;  //New sector added to the file
+		FAT[LastSector[num]] = n;  //New sector added to the file
 	}
-  return 0; // replace this line
+	if(IndexFile == num) {
+		Index[NumSectors[num]] = n;
+	}
+	LastSector[num] = n;
+	NumSectors[num]++;
+  return 0;
 }
 
 //********OS_File_New*************
@@ -146,44 +441,66 @@ uint8_t OS_File_New(void){
 // Errors:  none
 // Function finished
 uint8_t OS_File_Size(uint8_t num){
-  uint8_t	size = 1;
-	uint8_t file_sector;
-	
-	file_sector = Directory[num];  //get first sector number
-	
-	if(file_sector == 255) {  //empty
-		return 0;
+	if(!bDirectoryLoaded) {
+		MountDirectory(); 	//Read DIR and FAT from ROM to RAM
 	}
-	
-	while(FAT[file_sector] != 255) {  //while not last sector of the file
-		file_sector = FAT[file_sector];  //move to next sector of the file
-		size++;
+  return NumSectors[num];
+}
+
+uint8_t static storeopen(uint8_t num);
+
+// Program buf into a free sector and add it at the end of file 'num'
+// Outputs: 0 if successful
+// Errors:  255 on failure or disk full
+uint8_t static appendsector(uint8_t num, const uint8_t *buf){
+  uint8_t n = 0;
+	n = findfreesector();
+	if (n == 255) {
+		return 255;	//disk full
 	}
-  return size; // replace this line
+	if (eCache_WriteSector(buf,n) != RES_OK) {
+		return 255;
+	}
+	FreeMap[n/32] &= ~FREEBIT(n);	//in use
+	appendfat(num,n);
+	Tail[num] = 512;
+  return 0;
 }
 
 //********OS_File_Append*************
 // Save 512 bytes into the file
+// If the file is open, the bytes written to it and not yet stored
+// are stored first. A partial last sector is kept as it is, so its
+// unwritten bytes (0xFF) become part of the file.
 // Inputs:  num, 8-bit file number, 0 to 254
 //          buf, pointer to 512 bytes of data
 // Outputs: 0 if successful
 // Errors:  255 on failure or disk full
 uint8_t OS_File_Append(uint8_t num, uint8_t buf[512]){
-// **write this function**
-  uint8_t n = 0;
-	n = findfreesector();
-	if (n == 255) {
-		return 0;
+	if(!bDirectoryLoaded) {
+		MountDirectory(); 	//Read DIR and FAT from ROM to RAM
 	}
-	else {
-		eDisk_WriteSector(buf,n);
-		appendfat(num,n);
+	if(storeopen(num)) {
+		return 255;
 	}
-  return 0;
+	return appendsector(num, buf);
+}
+
+// Follow the chain of file 'num' once and record its sectors in Index
+void static buildindex(uint8_t num){
+	uint8_t i, sector;
+	sector = Directory[num];
+	for(i=0;i<NumSectors[num];i++) {
+		Index[i] = sector;
+		sector = FAT[sector];
+	}
+	IndexFile = num;
 }
 
 //********OS_File_Read*************
 // Read 512 bytes from the file
+// The first read of a file indexes it, after which any location
+// of that file is found in O(1)
 // Inputs:  num, 8-bit file number, 0 to 254
 //          location, logical address, 0 to 254
 //          buf, pointer to 512 empty spaces in RAM
@@ -192,61 +509,441 @@ uint8_t OS_File_Append(uint8_t num, uint8_t buf[512]){
 // Function finished
 uint8_t OS_File_Read(uint8_t num, uint8_t location,
                      uint8_t buf[512]){
-  uint8_t file_sector = 0;
-	uint8_t count = 0;
+	MountDirectory();
+	if(location >= NumSectors[num]) {
+		return 255;  //no data
+	}
+	if(IndexFile != num) {
+		buildindex(num);
+	}
+	eCache_ReadSector(buf,Index[location]);  //read from cache or ROM
+  return 0; //successful read
+}
 
-	file_sector = Directory[num];  //first sector of the file num
-	if(location == 0) {  //need to read the 1st block of the file
-		eDisk_ReadSector(buf,file_sector);  //read from ROM
-		return 0;  //successful read
+//********OS_File_Map*************
+// Find 512 bytes of the file on the disk, without copying them
+// If the sector is waiting in the cache it is programmed first, so
+// the pointer is always into flash
+// Inputs:  num, 8-bit file number, 0 to 254
+//          location, logical address, 0 to 254
+// Outputs: pointer to the data in flash, valid until the disk
+//          is formatted
+// Errors:  0 on failure because no data or the sector could not
+//          be programmed
+const uint8_t *OS_File_Map(uint8_t num, uint8_t location){
+	MountDirectory();
+	if(location >= NumSectors[num]) {
+		return 0;  //no data
+	}
+	if(IndexFile != num) {
+		buildindex(num);
+	}
+	return eCache_MapSector(Index[location]);
+}
+
+//********OS_File_Rewind*************
+// Point a cursor at the first sector of a file
+// Inputs:  cursor, pointer to a cursor owned by the caller
+//          num, 8-bit file number, 0 to 254
+// Outputs: none
+void OS_File_Rewind(FileCursor *cursor, uint8_t num){
+	cursor->num = num;
+	cursor->sector = 255;
+}
+
+//********OS_File_ReadNext*************
+// Read the next 512 bytes of the file and advance the cursor
+// Only one FAT entry is followed per call, so reading a whole file
+// is one pass over its chain. Sectors appended after the cursor
+// reaches the end are read by later calls.
+// Inputs:  cursor, set by OS_File_Rewind
+//          buf, pointer to 512 empty spaces in RAM
+// Outputs: 0 if successful
+// Errors:  255 at the end of the file, the cursor does not move
+uint8_t OS_File_ReadNext(FileCursor *cursor, uint8_t buf[512]){
+	uint8_t next;
+	MountDirectory();
+	if(cursor->sector == 255) {
+		next = (NumSectors[cursor->num] == 0) ? 255 : Directory[cursor->num];
+	}
+	else {
+		next = (LastSector[cursor->num] == cursor->sector) ? 255 : FAT[cursor->sector];
+	}
+	if(next == 255) {
+		return 255;  //no more data
+	}
+	eCache_ReadSector(buf,next);  //read from cache or ROM
+	cursor->sector = next;
+	return 0;
+}
+
+// Files open for byte access. Each has a sector buffer of its own,
+// so small records collect in RAM and a sector goes to the cache
+// only when it fills, when another sector of the file is read, when
+// OS_File_Append adds a sector to the file, or on close and flush. Bytes are only ever added at the end of a
+// file, so the buffer with data not yet stored always holds the last
+// sector, and a partial last sector is completed in place by
+// programming only the words from the one holding its first erased
+// byte.
+struct openfile{
+	uint8_t open;      // 1 if in use
+	uint8_t num;       // file number, 0 to 254
+	uint8_t location;  // sector of the file in buf, 255 if none
+	uint8_t dirty;     // 1 if buf has data that is not stored
+	uint8_t moved;     // 1 if buf must be stored in a new sector
+	uint16_t count;    // bytes of data in buf
+	uint32_t position; // next byte to read
+	uint8_t buf[512];  // word aligned, after position
+};
+struct openfile OpenFile[NUMOPEN];
+
+// Sector of file 'num' that the next byte written goes in
+uint8_t static endlocation(uint8_t num){
+	if((NumSectors[num] == 0)||(Tail[num] == 512)) {
+		return NumSectors[num];
 	}
+	return NumSectors[num]-1;
+}
 
-	while(count != location) {
-		if(FAT[file_sector] == 255) {  //if the current block is the last and attempting to read other one
-			return 255;  //no data
+// Bytes in file 'num', including those not stored yet
+uint32_t static filelength(uint8_t num){
+	uint32_t bytes = 0;
+	uint8_t i;
+	if(NumSectors[num]) {
+		bytes = 512*(uint32_t)(NumSectors[num]-1) + Tail[num];
+	}
+	for(i=0;i<NUMOPEN;i++) {
+		if(OpenFile[i].open && OpenFile[i].dirty && (OpenFile[i].num == num)) {
+			bytes = 512*(uint32_t)OpenFile[i].location + OpenFile[i].count;
 		}
-		file_sector = FAT[file_sector];  //move to next block of the file
-		count++;
 	}
-	eDisk_ReadSector(buf,file_sector);  //read from ROM	
-  return 0; //successful read
+	return bytes;
+}
+
+// Bring sector 'location' of the file into the buffer, or an empty
+// buffer for the sector after the last. The bytes past the data in
+// the last sector must be erased to be programmed in place; if a
+// power failure during an earlier flush left some programmed, the
+// sector is moved to a new one when stored.
+void static load(struct openfile *f, uint8_t location){
+	uint16_t i;
+	f->location = location;
+	f->moved = 0;
+	f->count = 0;
+	if(location < NumSectors[f->num]) {
+		OS_File_Read(f->num, location, f->buf);
+		f->count = (location+1 < NumSectors[f->num]) ? 512 : Tail[f->num];
+	}
+	for(i=f->count;i<512;i++) {
+		if(f->buf[i] != 0xFF) {
+			f->moved = (location < NumSectors[f->num]);
+			f->buf[i] = 0xFF;
+		}
+	}
+}
+
+// Write the buffer to the cache if it has data not stored yet
+// Outputs: 0 if successful
+// Errors:  255 on failure or disk full, the data stays in the buffer
+uint8_t static store(struct openfile *f){
+	uint8_t num = f->num, n;
+	uint16_t first;
+	if(f->dirty == 0) {
+		return 0;
+	}
+	if(f->location == NumSectors[num]) {  //a new sector
+		if(appendsector(num, f->buf)) {
+			return 255;
+		}
+	}
+	else if(f->moved == 0) {  //the last sector, in place
+		first = Tail[num]/4;  //the word holding the first erased byte
+		if(eCache_WriteWords((const uint32_t *)f->buf + first, LastSector[num],
+		                     first, (f->count+3)/4 - first) != RES_OK) {
+			return 255;
+		}
+	}
+	else {  //the last sector, copied to a free one
+		n = findfreesector();
+		if((n == 255)||(eCache_WriteSector(f->buf, n) != RES_OK)) {
+			return 255;
+		}
+		FreeMap[n/32] &= ~FREEBIT(n);	//in use, the old one is skipped until format
+		if(IndexFile != num) {
+			buildindex(num);
+		}
+		if(NumSectors[num] == 1) {
+			Directory[num] = n;
+		}
+		else {
+			FAT[Index[NumSectors[num]-2]] = n;
+		}
+		Index[NumSectors[num]-1] = n;
+		LastSector[num] = n;
+		f->moved = 0;
+	}
+	Tail[num] = f->count;
+	f->dirty = 0;
+	return 0;
+}
+
+// Store the buffer of file 'num' if it is open, before a sector is
+// added to the file some other way
+// Outputs: 0 if successful
+// Errors:  255 on failure or disk full
+uint8_t static storeopen(uint8_t num){
+	uint8_t i;
+	for(i=0;i<NUMOPEN;i++) {
+		if(OpenFile[i].open && (OpenFile[i].num == num)) {
+			return store(&OpenFile[i]);
+		}
+	}
+	return 0;
+}
+
+//********OS_File_Open*************
+// Open a file for reading and writing bytes
+// Inputs:  num, 8-bit file number, 0 to 254
+// Outputs: file descriptor, 0 to NUMOPEN-1, positioned at byte 0
+// Errors:  255 if the file is already open or NUMOPEN files are open
+uint8_t OS_File_Open(uint8_t num){
+	uint8_t i, fd = 255;
+	struct openfile *f;
+	MountDirectory();
+	if(num == 255) {
+		return 255;
+	}
+	for(i=0;i<NUMOPEN;i++) {
+		if(OpenFile[i].open) {
+			if(OpenFile[i].num == num) {
+				return 255;  //already open
+			}
+		}
+		else if(fd == 255) {
+			fd = i;
+		}
+	}
+	if(fd != 255) {
+		f = &OpenFile[fd];
+		f->open = 1;
+		f->num = num;
+		f->location = 255;
+		f->dirty = 0;
+		f->moved = 0;
+		f->count = 0;
+		f->position = 0;
+	}
+	return fd;
+}
+
+//********OS_File_WriteBytes*************
+// Add bytes to the end of an open file
+// The bytes collect in the buffer of the file, which is stored a
+// sector at a time, or when partly full by OS_File_Close and
+// OS_File_Flush. The read position does not move.
+// Inputs:  fd, file descriptor from OS_File_Open
+//          ptr, pointer to the bytes
+//          len, number of bytes
+// Outputs: 0 if successful
+// Errors:  255 on failure or disk full, after adding the bytes that fit
+uint8_t OS_File_WriteBytes(uint8_t fd, const uint8_t *ptr, uint32_t len){
+	struct openfile *f;
+	uint32_t i, n;
+	if((fd >= NUMOPEN)||(OpenFile[fd].open == 0)) {
+		return 255;
+	}
+	f = &OpenFile[fd];
+	MountDirectory();
+	while(len) {
+		if(f->location != endlocation(f->num)) {
+			if(store(f)) {
+				return 255;
+			}
+			load(f, endlocation(f->num));
+		}
+		n = 512 - f->count;
+		if(n > len) {
+			n = len;
+		}
+		for(i=0;i<n;i++) {
+			f->buf[f->count+i] = ptr[i];
+		}
+		f->count += n;
+		f->dirty = 1;
+		ptr += n;
+		len -= n;
+		if((f->count == 512)&&store(f)) {
+			return 255;
+		}
+	}
+	return 0;
+}
+
+//********OS_File_ReadBytes*************
+// Read bytes from an open file at its position, which moves past them
+// Bytes not yet stored by OS_File_WriteBytes are read as well.
+// Inputs:  fd, file descriptor from OS_File_Open
+//          ptr, pointer to len empty spaces in RAM
+//          len, number of bytes wanted
+// Outputs: number of bytes read, less than len at the end of the file
+// Errors:  0 if fd is not open
+uint32_t OS_File_ReadBytes(uint8_t fd, uint8_t *ptr, uint32_t len){
+	struct openfile *f;
+	uint32_t i, n, offset, total = 0;
+	if((fd >= NUMOPEN)||(OpenFile[fd].open == 0)) {
+		return 0;
+	}
+	f = &OpenFile[fd];
+	MountDirectory();
+	n = filelength(f->num) - f->position;
+	if(len > n) {
+		len = n;
+	}
+	while(len) {
+		if(f->location != f->position/512) {
+			if(store(f)) {
+				break;
+			}
+			load(f, f->position/512);
+		}
+		offset = f->position%512;
+		n = 512 - offset;
+		if(n > len) {
+			n = len;
+		}
+		for(i=0;i<n;i++) {
+			ptr[i] = f->buf[offset+i];
+		}
+		f->position += n;
+		total += n;
+		ptr += n;
+		len -= n;
+	}
+	return total;
+}
+
+//********OS_File_Seek*************
+// Move the read position of an open file
+// Inputs:  fd, file descriptor from OS_File_Open
+//          position, byte offset from the start of the file
+// Outputs: 0 if successful
+// Errors:  255 if fd is not open or position is past the end
+uint8_t OS_File_Seek(uint8_t fd, uint32_t position){
+	if((fd >= NUMOPEN)||(OpenFile[fd].open == 0)) {
+		return 255;
+	}
+	MountDirectory();
+	if(position > filelength(OpenFile[fd].num)) {
+		return 255;
+	}
+	OpenFile[fd].position = position;
+	return 0;
+}
+
+//********OS_File_Length*************
+// Check the size of this file in bytes
+// Inputs:  num, 8-bit file number, 0 to 254
+// Outputs: number of bytes, including any not stored yet
+// Errors:  none
+uint32_t OS_File_Length(uint8_t num){
+	MountDirectory();
+	return filelength(num);
+}
+
+//********OS_File_Close*************
+// Store the partial last sector of an open file and release fd
+// Call OS_File_Flush before power can be removed.
+// Inputs:  fd, file descriptor from OS_File_Open
+// Outputs: 0 if successful
+// Errors:  255 on failure or disk full, the file stays open
+uint8_t OS_File_Close(uint8_t fd){
+	if((fd >= NUMOPEN)||(OpenFile[fd].open == 0)) {
+		return 255;
+	}
+	MountDirectory();
+	if(store(&OpenFile[fd])) {
+		return 255;
+	}
+	OpenFile[fd].open = 0;
+	return 0;
 }
 
 //********OS_File_Flush*************
 // Update working buffers onto the disk
 // Power can be removed after calling flush
+// The partial last sectors of open files are stored first, then
+// the data sectors are programmed before the directory, so the
+// directory never points at data that is not on the disk.
+// Only the Directory and FAT bytes that changed are written. The
+// copy in RAM stays loaded, so the next call does not mount again.
 // Inputs:  none
 // Outputs: 0 if success
 // Errors:  255 on disk write failure
 // Finished function
 uint8_t OS_File_Flush(void){
-	uint16_t i;
-	if (bDirectoryLoaded) {
-		for(i=0;i<256;i++) {
-			Buff[i] = Directory[i];  //save directory in first 256 bytes
-   		Buff[i+256] = FAT[i];
+	uint8_t i;
+	for(i=0;i<NUMOPEN;i++) {
+		if (OpenFile[i].open && store(&OpenFile[i])) {
+			return 255;
 		}
-		if (eDisk_WriteSector(Buff, 255) !=RES_OK ) { 	//write to ROM
+	}
+	if (eCache_Flush() != RES_OK) {	//data sectors to ROM
+		return 255;
+	}
+	if (bDirectoryLoaded) {
+		if (logchanges() != RES_OK ) { 	//append to the log in ROM
 			return 255;
 		}
-		else {
-			bDirectoryLoaded=0;  //Dir and FAT are now in ROM
+#if GRADERLAYOUT
+		if (gradercopy() != RES_OK ) { 	//sector 255 for the grader
+			return 255;
 		}
+#endif
 	}
-  return 0; // replace this line
+  return 0;
 }
 
 //********OS_File_Format*************
 // Erase all files and all data
+// Open files are closed without storing them.
 // Inputs:  none
 // Outputs: 0 if success
 // Errors:  255 on disk write failure
 // Finished function
 uint8_t OS_File_Format(void){
-// call eDiskFormat
+// erase the data blocks and log an empty directory
 // clear bDirectoryLoaded to zero
 
-	eDisk_Format();
+	uint16_t i;
+	eCache_Invalidate();  //nothing cached is on the disk anymore
 	bDirectoryLoaded = 0;
-  return 0; // replace this line
+	for(i=0;i<NUMOPEN;i++) {
+		OpenFile[i].open = 0;
+	}
+	for(i=0;i<METASECTOR;i=i+SECTORSPERBLOCK) {  //data blocks
+		if (eDisk_EraseBlock(i) != RES_OK) {
+			return 255;
+		}
+	}
+#if GRADERLAYOUT
+	if (eDisk_EraseBlock(COPYSECTOR) != RES_OK) {  //empty copy for the grader
+		return 255;
+	}
+#endif
+	if (loadlog() == 0) {  //no log yet, clear out whatever is there
+		for(i=METASECTOR;i<256;i=i+SECTORSPERBLOCK) {
+			if (eDisk_EraseBlock(i) != RES_OK) {
+				return 255;
+			}
+		}
+	}
+	for(i=0;i<256;i++) {
+		Directory[i] = 255;
+		FAT[i] = 255;
+		Tail[i] = 512;
+	}
+	if (logsnapshot() != RES_OK) {  //an empty snapshot in a new block
+		return 255;
+	}
+  return 0;
 }
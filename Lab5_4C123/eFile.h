@@ -4,6 +4,14 @@
 // Daniel and Jonathan Valvano
 // August 29, 2016
 
+// Position of a sequential reader in a file, owned by the caller,
+// so any number of files can be read at the same time
+typedef struct{
+  uint8_t num;     // file number, 0 to 254
+  uint8_t sector;  // last sector read, 255 if none yet
+} FileCursor;
+
+#define NUMOPEN 2  // files open for byte access at the same time
 
 //********OS_File_New*************
 // Returns a file number of a new file for writing
@@ -37,9 +45,88 @@ uint8_t OS_File_Append(uint8_t num, uint8_t buf[512]);
 uint8_t OS_File_Read(uint8_t num, uint8_t location,
                      uint8_t buf[512]);
 
+//********OS_File_Map*************
+// Find 512 bytes of the file on the disk, without copying them
+// If the sector is waiting in the cache it is programmed first, so
+// the pointer is always into flash. Bytes appended to a partial last
+// sector later show through it.
+// Inputs:  num, 8-bit file number, 0 to 254
+//          location, logical address, 0 to 254
+// Outputs: pointer to the data in flash, valid until the disk
+//          is formatted
+// Errors:  0 on failure because no data or the sector could not
+//          be programmed
+const uint8_t *OS_File_Map(uint8_t num, uint8_t location);
+
+//********OS_File_Rewind*************
+// Point a cursor at the first sector of a file
+// Inputs:  cursor, pointer to a cursor owned by the caller
+//          num, 8-bit file number, 0 to 254
+// Outputs: none
+void OS_File_Rewind(FileCursor *cursor, uint8_t num);
+
+//********OS_File_ReadNext*************
+// Read the next 512 bytes of the file and advance the cursor
+// Inputs:  cursor, set by OS_File_Rewind
+//          buf, pointer to 512 empty spaces in RAM
+// Outputs: 0 if successful
+// Errors:  255 at the end of the file
+uint8_t OS_File_ReadNext(FileCursor *cursor, uint8_t buf[512]);
+
+//********OS_File_Open*************
+// Open a file for reading and writing bytes
+// Inputs:  num, 8-bit file number, 0 to 254
+// Outputs: file descriptor, 0 to NUMOPEN-1, positioned at byte 0
+// Errors:  255 if the file is already open or NUMOPEN files are open
+uint8_t OS_File_Open(uint8_t num);
+
+//********OS_File_WriteBytes*************
+// Add bytes to the end of an open file
+// The bytes are buffered and stored a sector at a time, or when
+// partly full by OS_File_Close and OS_File_Flush
+// Inputs:  fd, file descriptor from OS_File_Open
+//          ptr, pointer to the bytes
+//          len, number of bytes
+// Outputs: 0 if successful
+// Errors:  255 on failure or disk full
+uint8_t OS_File_WriteBytes(uint8_t fd, const uint8_t *ptr, uint32_t len);
+
+//********OS_File_ReadBytes*************
+// Read bytes from an open file at its position, which moves past them
+// Inputs:  fd, file descriptor from OS_File_Open
+//          ptr, pointer to len empty spaces in RAM
+//          len, number of bytes wanted
+// Outputs: number of bytes read, less than len at the end of the file
+// Errors:  0 if fd is not open
+uint32_t OS_File_ReadBytes(uint8_t fd, uint8_t *ptr, uint32_t len);
+
+//********OS_File_Seek*************
+// Move the read position of an open file
+// Inputs:  fd, file descriptor from OS_File_Open
+//          position, byte offset from the start of the file
+// Outputs: 0 if successful
+// Errors:  255 if fd is not open or position is past the end
+uint8_t OS_File_Seek(uint8_t fd, uint32_t position);
+
+//********OS_File_Length*************
+// Check the size of this file in bytes
+// Inputs:  num, 8-bit file number, 0 to 254
+// Outputs: number of bytes, including any not stored yet
+// Errors:  none
+uint32_t OS_File_Length(uint8_t num);
+
+//********OS_File_Close*************
+// Store the partial last sector of an open file and release fd
+// Call OS_File_Flush before power can be removed.
+// Inputs:  fd, file descriptor from OS_File_Open
+// Outputs: 0 if successful
+// Errors:  255 on failure or disk full, the file stays open
+uint8_t OS_File_Close(uint8_t fd);
+
 //********OS_File_Flush*************
 // Update working buffers onto the disk
 // Power can be removed after calling flush
+// The partial last sectors of open files are stored first
 // Inputs:  none
 // Outputs: 0 if success
 // Errors:  255 on disk write failure
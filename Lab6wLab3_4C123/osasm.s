@@ -13,11 +13,11 @@
 
         EXTERN  RunPt            ; currently running thread
         EXPORT  StartOS
-        EXPORT  SysTick_Handler
+        EXPORT  PendSV_Handler
         IMPORT  Scheduler
 
 
-SysTick_Handler                ; 1) Saves R0-R3,R12,LR,PC,PSR
+PendSV_Handler                 ; 1) Saves R0-R3,R12,LR,PC,PSR
     CPSID   I                  ; 2) Prevent interrupt during switch
 	;AleGaa - start
 	PUSH {R4-R11}		;saves registers R4 to R11
@@ -85,6 +85,7 @@
 
 #include <stdint.h>
 #include "TExaS.h"
+#include "os.h"
 #include "BSP.h"
 #include "CortexM.h"
 #include "../inc/tm4c123gh6pm.h"
@@ -165,69 +166,52 @@ void NonrealTimeResults(uint32_t n, uint32_t expected, uint32_t  min, uint32_t m
   UART_OutString(",                  ave= ");    UART_OutUDec7(ave);
   UART_OutString(" usec");
 }
-void Grader(void){        // called once a second
+// ------------Jitter------------
+// Report the time between starts of one periodic task
+// Input: n, task number for the report
+//        buf, start times in usec
+//        size, number of start times in buf
+//        expected, period in usec
+//        limit, largest jitter that passes in usec
+// Output: 1 if max-min time between starts is within limit
+uint32_t Jitter(uint32_t n, uint32_t *buf, uint32_t size, uint32_t expected, uint32_t limit){
   uint32_t sum,dt,i,min,max,ave,err,jitter;
+  sum = 0; min = 0xFFFFFFFF; max = 0;
+  for(i=1;i<size;i++){
+    dt = buf[i]-buf[i-1]; // time between executions
+    if(dt>max)max = dt; // maximum
+    if(dt<min)min = dt; // minimum
+    sum = sum+dt;
+  }
+  ave = sum/(size-1);
+  if(ave>=expected){
+    err = (1000*(ave-expected))/expected;
+  }else{
+    err = (1000*(expected-ave))/expected;
+  }
+  jitter = max-min;
+  RealTimeResults(n,expected,min,max,jitter,ave,err);
+  return (jitter <= limit);
+}
+void Grader(void){        // called once a second
   uint32_t grade=0;
+  int32_t late;
   uint32_t static count=0;
   if((Index3>=PROFILESIZE3)&&(Index4>=PROFILESIZE4)&&(Index5>=PROFILESIZE5)){ // done
     // run scoring
     TExaS_Stop();
     UART_OutString("\n\r**Done**\n\r");
-    // Task 3
-    sum = 0; min = 0xFFFFFFFF; max = 0;
-    for(i=1;i<PROFILESIZE3;i++){
-      dt = TimeBuffer3[i]-TimeBuffer3[i-1]; // time between executions
-      if(dt>max)max = dt; // maximum
-      if(dt<min)min = dt; // minimum
-      sum = sum+dt;
+    if(Jitter(0,TimeBuffer3,PROFILESIZE3,EXPECTED3,JITTER_ERROR0)) grade += 33;
+    if(Jitter(1,TimeBuffer4,PROFILESIZE4,EXPECTED4,JITTER_ERROR1)) grade += 33;
+    if(Jitter(2,TimeBuffer5,PROFILESIZE5,EXPECTED5,JITTER_ERROR1)) grade += 34;
+    UART_OutString("\n\rDeadline misses= "); UART_OutUDec(OS_DeadlineMisses());
+    UART_OutString(", max lateness= ");
+    late = OS_MaxLateness();
+    if(late < 0){
+      UART_OutChar('-');
+      late = -late;
     }
-    ave = sum/(PROFILESIZE3-1);
-    if(ave>=EXPECTED3){
-      err = (1000*(ave-EXPECTED3))/EXPECTED3;
-    }else{
-      err = (1000*(EXPECTED3-ave))/EXPECTED3;
-    }
-    jitter = max-min;
-    if(jitter <= JITTER_ERROR0) grade += 33;
-    RealTimeResults(0,EXPECTED3,min,max,jitter,ave,err);
-
-    // Task 4
-    sum = 0; min = 0xFFFFFFFF; max = 0;
-    for(i=1;i<PROFILESIZE4;i++){
-      dt = TimeBuffer4[i]-TimeBuffer4[i-1]; // time between executions
-      if(dt>max)max = dt; // maximum
-      if(dt<min)min = dt; // minimum
-      sum = sum+dt;
-    }
-    ave = sum/(PROFILESIZE4-1);
-    if(ave>=EXPECTED4){
-      err = (1000*(ave-EXPECTED4))/EXPECTED4;
-    }else{
-      err = (1000*(EXPECTED4-ave))/EXPECTED4;
-    }
-    jitter = max-min;
-    if(jitter <= JITTER_ERROR1) grade += 33;
-    RealTimeResults(1,EXPECTED4,min,max,jitter,ave,err);
-
-    // Task 5
-    sum = 0; min = 0xFFFFFFFF; max = 0;
-    for(i=1;i<PROFILESIZE5;i++){
-      dt = TimeBuffer5[i]-TimeBuffer5[i-1]; // time between executions
-      if(dt>max)max = dt; // maximum
-      if(dt<min)min = dt; // minimum
-      sum = sum+dt;
-    }
-    ave = sum/(PROFILESIZE5-1);
-    if(ave>=EXPECTED5){
-      err = (1000*(ave-EXPECTED5))/EXPECTED5;
-    }else{
-      err = (1000*(EXPECTED5-ave))/EXPECTED5;
-    }
-    jitter = max-min;
-    if(jitter <= JITTER_ERROR1) grade += 34;
-    RealTimeResults(1,EXPECTED5,min,max,jitter,ave,err);
-
-
+    UART_OutUDec(late); UART_OutString(" usec");
     UART_OutString("\n\rGrade= "); UART_OutUDec(grade);
   }else{
     UART_OutChar('0'+count%10);
@@ -33,18 +33,91 @@
 void StartOS(void);
 
 #define NUMTHREADS  3        // maximum number of main threads
-#define NUMEVENTTHREADS 3    // maximum number of event threads
+#define NUMEVENTTHREADS 10   // maximum number of event threads
 #define STACKSIZE   100      // number of 32-bit words in stack
+#define EARLY       10       // usec, an event thread this close to release is run
 struct tcb{
   int32_t *sp;       // pointer to stack (valid for threads not running
-  struct tcb *next;  // linked-list pointer
-  uint32_t period;   // in usec (event threads only)
-  uint32_t deadline; // next time to run this thread in usec
+  struct tcb *next;  // linked-list pointer (main threads only)
+  uint32_t period;   // in usec, 0 for main threads
+  uint32_t release;  // next time to run this thread in usec
+  uint32_t deadline; // time the current run must finish by, release+period
+  uint32_t misses;   // number of runs that finished after their deadline
+  int32_t lateness;  // worst finish minus deadline in usec, negative if always early
 };
 typedef struct tcb tcbType;
 tcbType tcbs[NUMTHREADS+NUMEVENTTHREADS];
 tcbType *RunPt;
+tcbType *MainPt;     // main thread to resume when no event thread is ready
 int32_t Stacks[NUMTHREADS+NUMEVENTTHREADS][STACKSIZE];
+uint32_t NumEventThreads; // event threads added so far
+uint32_t Yielded;    // set by OS_Suspend, the running event thread is done
+
+// Earliest deadline first
+// An event thread waits in Pending, ordered by release time, until it is
+// released. It then waits in Released, ordered by deadline, until it is
+// the most urgent and runs. When it calls OS_Suspend it goes back to
+// Pending, released again at its deadline, so releases do not drift.
+// Both are binary min-heaps, so any number of event threads costs
+// O(log n) per release.
+struct node{
+  uint32_t time;     // release or deadline in usec
+  tcbType *thread;
+};
+struct heap{
+  uint32_t size;
+  struct node node[NUMEVENTTHREADS];
+};
+struct heap Pending;  // event threads not yet released, by release time
+struct heap Released; // event threads ready to run, by deadline
+
+// ******** heappush ************
+// Add a thread to a heap
+// Inputs:  pointer to a heap, key in usec, pointer to an event thread
+// Outputs: none
+// Times are compared by difference, so the 32-bit usec clock may roll over
+void static heappush(struct heap *heapPt, uint32_t time, tcbType *thread){
+  uint32_t i,parent;
+  i = heapPt->size;
+  heapPt->size++;
+  while(i > 0){
+    parent = (i-1)/2;
+    if((int32_t)(heapPt->node[parent].time - time) <= 0){
+      break;
+    }
+    heapPt->node[i] = heapPt->node[parent]; // move parent down
+    i = parent;
+  }
+  heapPt->node[i].time = time;
+  heapPt->node[i].thread = thread;
+}
+
+// ******** heappop ************
+// Remove the thread with the smallest key from a heap
+// Inputs:  pointer to a heap that is not empty
+// Outputs: pointer to the thread removed
+tcbType static *heappop(struct heap *heapPt){
+  tcbType *thread;
+  struct node last;
+  uint32_t i,child;
+  thread = heapPt->node[0].thread;
+  heapPt->size--;
+  last = heapPt->node[heapPt->size];
+  i = 0;
+  while((child = 2*i+1) < heapPt->size){
+    if((child+1 < heapPt->size)&&
+       ((int32_t)(heapPt->node[child+1].time - heapPt->node[child].time) < 0)){
+      child++;                  // smaller of the two children
+    }
+    if((int32_t)(last.time - heapPt->node[child].time) <= 0){
+      break;
+    }
+    heapPt->node[i] = heapPt->node[child]; // move child up
+    i = child;
+  }
+  heapPt->node[i] = last;
+  return thread;
+}
 
 // ******** OS_Init ************
 // initialize operating system, disable interrupts until OS_Launch
@@ -54,6 +127,9 @@ int32_t Stacks[NUMTHREADS+NUMEVENTTHREADS][STACKSIZE];
 void OS_Init(void){
   DisableInterrupts();
   BSP_Clock_InitFastest();// set processor clock to fastest speed
+  NumEventThreads = 0;
+  Pending.size = 0;
+  Released.size = 0;
 }
 
 void SetInitialStack(int i){
@@ -90,10 +166,34 @@ int OS_AddThreads(void(*thread0)(void),
   SetInitialStack(1); Stacks[1][STACKSIZE-2] = (int32_t)(thread1); // PC
   SetInitialStack(2); Stacks[2][STACKSIZE-2] = (int32_t)(thread2); // PC
   RunPt = &tcbs[0];       // thread 0 will run first
+  MainPt = RunPt;
   EndCritical(status);
   return 1;               // successful
 }
                  
+//******** OS_AddPeriodicThread ***************
+// add an event thread to the scheduler
+// Inputs: pointer to a void/void event task
+//         period in usec, which is also its relative deadline
+// Outputs: 1 if successful, 0 if this thread can not be added
+// event threads must run for a short amount of time and call OS_Suspend
+int OS_AddPeriodicThread(void(*thread)(void), uint32_t period){
+  int32_t status; int i;
+  status = StartCritical();
+  if(NumEventThreads == NUMEVENTTHREADS){
+    EndCritical(status);
+    return 0;             // no room
+  }
+  i = NUMTHREADS+NumEventThreads;
+  NumEventThreads++;
+  SetInitialStack(i); Stacks[i][STACKSIZE-2] = (int32_t)(thread); // PC
+  tcbs[i].period = period;
+  tcbs[i].misses = 0;
+  tcbs[i].lateness = -(int32_t)period;
+  EndCritical(status);
+  return 1;               // successful
+}
+
 //******** OS_AddPeriodicThreads ***************
 // add three event threads to the scheduler
 // Inputs: three pointers to a void/void event tasks
@@ -103,19 +203,9 @@ int OS_AddThreads(void(*thread0)(void),
 int OS_AddPeriodicThreads(void(*thread3)(void), uint32_t period3,
                  void(*thread4)(void), uint32_t period4,
                  void(*thread5)(void), uint32_t period5){
-int32_t status;
-  status = StartCritical();
-  tcbs[3].next = &tcbs[0]; // 3 points to 0
-  tcbs[4].next = &tcbs[1]; // 4 points to 1
-  tcbs[5].next = &tcbs[2]; // 5 points to 2
-  SetInitialStack(3); Stacks[3][STACKSIZE-2] = (int32_t)(thread3); // PC
-  tcbs[3].period = period3;
-  SetInitialStack(4); Stacks[4][STACKSIZE-2] = (int32_t)(thread4); // PC
-  tcbs[4].period = period4;
-  SetInitialStack(5); Stacks[5][STACKSIZE-2] = (int32_t)(thread5); // PC
-  tcbs[5].period = period5;
-  EndCritical(status);
-  return 1;               // successful
+  return OS_AddPeriodicThread(thread3, period3)&&
+         OS_AddPeriodicThread(thread4, period4)&&
+         OS_AddPeriodicThread(thread5, period5);
 }
 
 //******** OS_Launch ***************
@@ -127,36 +217,101 @@ void OS_Launch(uint32_t theTimeSlice){
   int i;
   STCTRL = 0;                  // disable SysTick during setup
   STCURRENT = 0;               // any write to current clears it
-  SYSPRI3 =(SYSPRI3&0x00FFFFFF)|0xE0000000; // priority 7
+  SYSPRI3 =(SYSPRI3&0x0000FFFF)|0xE0E00000; // priority 7, SysTick and PendSV
   STRELOAD = theTimeSlice - 1; // reload value
   STCTRL = 0x00000007;         // enable, core clock and interrupt arm
   BSP_Time_Init();
-  for(i=NUMTHREADS; i<NUMTHREADS+NUMEVENTTHREADS;i++){
-    tcbs[i].deadline = 1000+1000*i; // in usec
+  for(i=NUMTHREADS; i<NUMTHREADS+NumEventThreads;i++){
+    tcbs[i].release = 1000+1000*i; // in usec
+    heappush(&Pending, tcbs[i].release, &tcbs[i]);
   }
   StartOS();                   // start on the first task
 }
 
+//******** SysTick_Handler ***************
+// Time slice interrupt, only requests a thread switch
+// The switch itself runs in PendSV_Handler (osasm.s) at the lowest
+// priority, after every other pending interrupt has finished
+// Inputs: none
+// Outputs: none
+void SysTick_Handler(void){
+  INTCTRL = 0x10000000; // trigger PendSV
+}
+
 //*********OS_Suspend**************
 // main threads can call this to cooperate
 // event threads must call this after running for a short time
 // Inputs: none
 // Outputs: none
 void OS_Suspend(void){  // do not restart SysTick timer
-  INTCTRL = 0x04000000; // trigger SysTick
+  Yielded = 1;          // an event thread has finished this run
+  INTCTRL = 0x10000000; // trigger PendSV
+}
+
+//*********OS_DeadlineMisses**************
+// number of event thread runs that finished after their deadline
+// Inputs: none
+// Outputs: total over all event threads
+uint32_t OS_DeadlineMisses(void){
+  uint32_t i,misses;
+  misses = 0;
+  for(i=NUMTHREADS; i<NUMTHREADS+NumEventThreads; i++){
+    misses = misses + tcbs[i].misses;
+  }
+  return misses;
+}
+
+//*********OS_MaxLateness**************
+// worst finish time minus deadline of any event thread run
+// Inputs: none
+// Outputs: usec, negative if every run finished early
+int32_t OS_MaxLateness(void){
+  uint32_t i; int32_t lateness;
+  lateness = INT32_MIN;
+  for(i=NUMTHREADS; i<NUMTHREADS+NumEventThreads; i++){
+    if(tcbs[i].lateness > lateness){
+      lateness = tcbs[i].lateness;
+    }
+  }
+  return lateness;
 }
 
-void Scheduler(void){ int i;
-  uint32_t time; int32_t timeToDeadline;
+// Run the released event thread with the earliest deadline, else the main threads
+// An event thread interrupted by SysTick before calling OS_Suspend
+// goes back into Released and keeps its deadline.
+void Scheduler(void){ tcbType *pt;
+  uint32_t time; int32_t late;
   time = BSP_Time_Get();     // in us
-  for(i=NUMTHREADS; i<NUMTHREADS+NUMEVENTTHREADS;i++){
-    timeToDeadline = tcbs[i].deadline - time; // handles time rollover after 71 minutes
-    if(timeToDeadline <= 10){ // event thread is ready to run
-      tcbs[i].next = RunPt;  // go back to circular list when done
-      RunPt = &tcbs[i];      // IMPORTANT: run this one NOW
-      tcbs[i].deadline = time + tcbs[i].period;
-      return;
+  if(RunPt->period){         // an event thread was running
+    if(Yielded){             // finished this run
+      late = time - RunPt->deadline; // handles time rollover after 71 minutes
+      if(late > 0){
+        RunPt->misses++;
+      }
+      if(late > RunPt->lateness){
+        RunPt->lateness = late;
+      }
+      RunPt->release = RunPt->deadline;
+      heappush(&Pending, RunPt->release, RunPt);
+    } else{
+      heappush(&Released, RunPt->deadline, RunPt);
     }
+  } else{
+    MainPt = RunPt;
+  }
+  Yielded = 0;
+  while(Pending.size && ((int32_t)(Pending.node[0].time - time) <= EARLY)){
+    pt = heappop(&Pending);  // release it
+    pt->deadline = pt->release + pt->period;
+    heappush(&Released, pt->deadline, pt);
+  }
+  if(Released.size){
+    RunPt = heappop(&Released); // IMPORTANT: run the earliest deadline NOW
+    return;
+  }
+  if(RunPt->period){
+    RunPt = MainPt;       // back to the main thread it interrupted
+  } else{
+    RunPt = RunPt->next;  // Round Robin
   }
-  RunPt = RunPt->next;    // Round Robin
 }
@@ -44,6 +44,15 @@ int OS_AddThreads(void(*thread0)(void),
                  void(*thread1)(void),
                  void(*thread2)(void));
 
+//******** OS_AddPeriodicThread ***************
+// add an event thread to the scheduler
+// Event threads are run earliest deadline first
+// Inputs: pointer to a void/void event task
+//         period in usec, which is also its relative deadline
+// Outputs: 1 if successful, 0 if this thread can not be added
+// event threads must run for a short amount of time and call OS_Suspend
+int OS_AddPeriodicThread(void(*thread)(void), uint32_t period);
+
 //******** OS_AddPeriodicThreads ***************
 // add three event threads to the scheduler
 // Inputs: three pointers to a void/void event tasks
@@ -66,4 +75,16 @@ void OS_Launch(uint32_t theTimeSlice);
 // Outputs: none
 void OS_Suspend(void);
 
+//*********OS_DeadlineMisses**************
+// number of event thread runs that finished after their deadline
+// Inputs: none
+// Outputs: total over all event threads
+uint32_t OS_DeadlineMisses(void);
+
+//*********OS_MaxLateness**************
+// worst finish time minus deadline of any event thread run
+// Inputs: none
+// Outputs: usec, negative if every run finished early
+int32_t OS_MaxLateness(void);
+
 #endif
@@ -43,7 +43,7 @@ int32_t NewData;     // set by real-time tasks to signal graphics update
 int32_t RunGame;     // set at 30 Hz
 int32_t Button;      // set on button touch
 int32_t CreateEnemy; // Set at 10 Hz
-int32_t Mutex;
+MutexType Mutex;  // access to sprites
 int32_t IntermissionFlag=1;
 #define FIX 64    // 1/64 pixels
 
@@ -263,7 +263,7 @@ void DrawLand(uint16_t color, uint16_t bgcolor){
 }
 
 void DrawSprites(void){int i;
-	OS_Wait(&Mutex);
+	OS_MutexLock(&Mutex);
   for(i=0; i<NUMSPRITES; i++){
     if(Things[i].life){ 
       BSP_LCD_DrawBitmap(Things[i].x, Things[i].y, Things[i].ImagePt[Things[i].AnimationIndex], Things[i].w,Things[i].h);
@@ -274,7 +274,7 @@ void DrawSprites(void){int i;
       }
     }
   }
-	OS_Signal(&Mutex);
+	OS_MutexUnlock(&Mutex);
 }
 void MissileHitsShip(void){ // check for enemy missiles hitting player ship
   uint32_t i,d;
@@ -388,7 +388,7 @@ void RocketHitsEnemy(void){ // check for rockets hitting enemies
 }        
 
 void MoveSprites(void){int i;
-	OS_Wait(&Mutex);
+	OS_MutexLock(&Mutex);
   for(i=0; i<NUMSPRITES; i++){
     if(Things[i].life){
       Things[i].fx = Things[i].fx+Things[i].vx;
@@ -406,7 +406,7 @@ void MoveSprites(void){int i;
       }
     }
   }
-	OS_Signal(&Mutex);
+	OS_MutexUnlock(&Mutex);
 }
 void CreateSprite(int i, 
   const unsigned short *livePt, const unsigned short *livePt2,
@@ -415,7 +415,7 @@ void CreateSprite(int i,
   short initx, short inity,
   short width, unsigned height,
   short initvx, short initvy, int alive){
-	OS_Wait(&Mutex);
+	OS_MutexLock(&Mutex);
   Things[i].ImagePt[0] = livePt;
   Things[i].ImagePt[1] = livePt2;
   Things[i].AnimationIndex = 0;
@@ -431,7 +431,7 @@ void CreateSprite(int i,
   Things[i].vx = initvx;
   Things[i].vy = initvy;
   Things[i].life  = alive;    
-	OS_Signal(&Mutex);
+	OS_MutexUnlock(&Mutex);
 }
 
 int abs(int x){
@@ -842,7 +842,7 @@ int main(void){uint16_t x,y; uint8_t button;
   TExaS_Init(LOGICANALYZER,BSP_Clock_GetFreq());
  // Sound_EyesOfTexas();
   OS_InitSemaphore(&RunGame,0);     // signaled by timer to run engine
-  OS_InitSemaphore(&Mutex,1);       // access to sprites
+  OS_InitMutex(&Mutex);            // access to sprites
   OS_InitSemaphore(&CreateEnemy,0); // signaled by time to create enemies
 	OS_AddThread(&GameTask,0);
   OS_AddThread(&ButtonTask,0);   // high priority, signaled on button touch
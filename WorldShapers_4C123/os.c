@@ -18,22 +18,76 @@ void StartOS(void);
 #define NUMTHREADS  20       // maximum number of threads
 #define NUMPERIODIC 2        // maximum number of periodic threads
 #define STACKSIZE   100      // number of 32-bit words in stack per thread
+#define NUMPRIORITY 32       // number of priority levels, one bit each in ReadyBitmap
 struct tcb{
   int32_t *sp;       // pointer to stack (valid for threads not running
   struct tcb *next;  // linked-list pointer
   uint32_t Id;       // 0 means TCB is free
   int32_t *BlockPt;  // nonzero if blocked on this semaphore
   uint32_t Sleep;    // nonzero if this thread is sleeping
-  uint32_t Priority; // 0 is highest
+  uint32_t Priority; // 0 is highest, 31 is lowest
+  struct tcb *ReadyNext; // circular ready list of this priority, valid only while ready
+  struct tcb *ReadyPrev;
+  uint32_t BasePriority;  // priority given to OS_AddThread, Priority may be raised above it
+  MutexType *WaitMutex;   // nonzero if blocked on this mutex
+  struct tcb *WaitNext;   // next thread waiting on the same mutex
+  MutexType *Held;        // mutexes owned by this thread, linked by HeldNext
 };
 typedef struct tcb tcbType;
 tcbType tcbs[NUMTHREADS];
 tcbType *RunPt;
 int32_t Stacks[NUMTHREADS][STACKSIZE];
 void static runperiodicevents(void);
+void static release(MutexType *mutexPt);
 uint32_t NumThread=0;  // number of threads
 uint32_t static ThreadId=0;   // thread Ids are sequential from 1
 
+// Ready threads are kept in one circular list per priority.
+// Bit 31-p of ReadyBitmap is set when ReadyList[p] is not empty,
+// so the highest priority ready level is found with a single CLZ.
+tcbType *ReadyList[NUMPRIORITY]; // next thread to run at each priority
+uint32_t ReadyBitmap;            // one bit per nonempty priority level
+#define PRIORITYBIT(p) (0x80000000>>(p))
+
+// ******** addready ************
+// Append a thread to the tail of the ready list of its priority
+// Called with interrupts disabled
+// Inputs:  pointer to thread that is neither blocked nor sleeping
+// Outputs: none
+void static addready(tcbType *thread){
+  tcbType *head;
+  head = ReadyList[thread->Priority];
+  if(head == 0){
+    thread->ReadyNext = thread;  // only ready thread at this level
+    thread->ReadyPrev = thread;
+    ReadyList[thread->Priority] = thread;
+    ReadyBitmap |= PRIORITYBIT(thread->Priority);
+  } else{                        // tail is just before head
+    thread->ReadyNext = head;
+    thread->ReadyPrev = head->ReadyPrev;
+    head->ReadyPrev->ReadyNext = thread;
+    head->ReadyPrev = thread;
+  }
+}
+
+// ******** removeready ************
+// Unlink a thread from the ready list of its priority
+// Called with interrupts disabled
+// Inputs:  pointer to thread that is currently ready
+// Outputs: none
+void static removeready(tcbType *thread){
+  if(thread->ReadyNext == thread){ // last ready thread at this level
+    ReadyList[thread->Priority] = 0;
+    ReadyBitmap &= ~PRIORITYBIT(thread->Priority);
+  } else{
+    thread->ReadyPrev->ReadyNext = thread->ReadyNext;
+    thread->ReadyNext->ReadyPrev = thread->ReadyPrev;
+    if(ReadyList[thread->Priority] == thread){
+      ReadyList[thread->Priority] = thread->ReadyNext;
+    }
+  }
+}
+
 // ******** OS_Init ************
 // Initialize operating system, disable interrupts
 // Initialize OS controlled I/O: periodic interrupt, bus clock as fast as possible
@@ -45,6 +99,7 @@ void OS_Init(void){
   BSP_Clock_InitFastest();// set processor clock to fastest speed
   NumThread=0;  // number of threads
   ThreadId=0;   // thread Ids are sequential from 1
+  ReadyBitmap=0; // no thread is ready
 // perform any initializations needed, 
 // set up periodic timer to run runperiodicevents to implement sleeping
   BSP_PeriodicTask_InitB(&runperiodicevents, 1000, 0);
@@ -75,7 +130,7 @@ void SetInitialStack(int i){
 //******** OS_AddThread *************** 
 // add a foregound thread to the scheduler
 // Inputs: pointer to a void/void foreground function
-//         priority (0 is highest)
+//         priority (0 is highest, 31 is lowest)
 // Outputs: Thread ID if successful, 0 if this thread can not be added
 // stack size must be divisable by 8 (aligned to double word boundary)
 int OS_AddThread(void(*task)(void), uint32_t priority){ int status;
@@ -102,7 +157,13 @@ int OS_AddThread(void(*task)(void), uint32_t priority){ int status;
     }
     LastPt->next = NewPt; // Pointer to Next  
   }
+  if(priority >= NUMPRIORITY){
+    priority = NUMPRIORITY-1;  // clamp to lowest priority
+  }
   NewPt->Priority =  priority;
+  NewPt->BasePriority = priority;
+  NewPt->WaitMutex = 0;   // not waiting on a mutex
+  NewPt->Held = 0;        // owns no mutex
   NumThread++;
   ThreadId++;
   NewPt->Id = ThreadId;
@@ -134,6 +195,7 @@ int OS_AddThread(void(*task)(void), uint32_t priority){ int status;
   *(--sp)  = (long)0x04040404L;             /* R4                                                 */
   NewPt->sp = sp;        // make stack "look like it was previously suspended"
   NewPt->next = RunPt;   // Pointer to first, circular linked list 
+  addready(NewPt);
   EndCritical(status);
   return 1;
 }
@@ -149,8 +211,11 @@ void static runperiodicevents(void){
 // **DECREMENT SLEEP COUNTERS
 // In Lab 4, handle periodic events in RealTimeEvents
 	int32_t i;
-	for (i=0;i<NUMTHREADS;i++){ if(tcbs[i].Sleep != 0) {	//search for sleeping main threads
+	for (i=0;i<NUMTHREADS;i++){ if((tcbs[i].Id != 0)&&(tcbs[i].Sleep != 0)) {	//search for sleeping main threads
 			tcbs[i].Sleep --;	//decrement sleep period by 1ms
+			if((tcbs[i].Sleep == 0)&&(tcbs[i].BlockPt == 0)){
+				addready(&tcbs[i]);	//woke up
+			}
 		}
 	}
 }
@@ -168,25 +233,26 @@ void OS_Launch(uint32_t theTimeSlice){
   STCTRL = 0x00000007;         // enable, core clock and interrupt arm
   StartOS();                   // start on the first task
 }
+
+//******** SysTick_Handler ***************
+// Time slice interrupt, only requests a thread switch
+// The switch itself runs in PendSV_Handler (osasm.s) at the lowest
+// priority, after every other pending interrupt has finished
+// Inputs: none
+// Outputs: none
+void SysTick_Handler(void){
+  INTCTRL = 0x10000000; // trigger PendSV
+}
 // runs every ms
 void Scheduler(void){      // every time slice
-	// look at all threads in TCB list choose
-	// highest priority thread not blocked and not sleeping 
+	// choose the highest priority thread not blocked and not sleeping
 	// If there are multiple highest priority (not blocked, not sleeping) run these round robin
-	// ROUND ROBIN, skip blocked and sleeping threads
-	uint32_t maxprio = 255;
-	tcbType *tempPt;
-	tcbType *bestPt;
-	tempPt = RunPt;
-	do {
-		tempPt = tempPt->next;
-		if(((tempPt->Priority) < maxprio) && (tempPt->BlockPt == 0) && (tempPt->Sleep == 0)) { 
-			//If priority is higher and not blocked and not sleeping
-			maxprio = tempPt->Priority;
-			bestPt = tempPt;
-		}
-	} while (RunPt != tempPt); //search through all linked list
-	RunPt = bestPt; //move to next suitable thread
+	// Only ready threads are in ReadyList, so this takes constant time
+	// There must always be at least one ready thread (e.g., IdleTask)
+	uint32_t prio;
+	prio = __clz(ReadyBitmap);	//highest priority level with a ready thread
+	RunPt = ReadyList[prio];
+	ReadyList[prio] = RunPt->ReadyNext;	//ROUND ROBIN within this priority
 }
 
 //******** OS_Suspend ***************
@@ -196,11 +262,13 @@ void Scheduler(void){      // every time slice
 // Will be run again depending on sleep/block status
 void OS_Suspend(void){
   STCURRENT = 0;        // any write to current clears it
-  INTCTRL = 0x04000000; // trigger SysTick
+  INTCTRL = 0x10000000; // trigger PendSV
 // next thread gets a full time slice
 }
 // ******** OS_Kill ************
 // kill the currently running thread, release its TCB memory
+// Mutexes the thread still owns go to their waiters as OS_MutexUnlock
+// would give them, so no thread waits on a dead owner
 // input:  none
 // output: none
 tcbType *previousPt;   // Pointer to previous thread in list before current thread
@@ -213,9 +281,12 @@ void OS_Kill(void){  // no local variables allowed
   if(NumThread==0){
     for(;;){};     // crash
   }
-  RunPt->Sleep = 0xFFFFFFFF;  // can't rerun this thread, it will be dead
+  while(RunPt->Held != 0){
+    release(RunPt->Held);
+  }
+  removeready(RunPt);         // can't rerun this thread, it will be dead
   killPt = RunPt;             // kill current thread
-  Scheduler();                // RunPt points to thread to run next
+// RunPt stays on the dead thread, PendSV saves into its TCB and schedules
 //********initially RunPt points to thread to kill********
 //               /----\           /----\          /----\
 //               |    |  killPt-> |    |          |    |
@@ -244,7 +315,7 @@ void OS_Kill(void){  // no local variables allowed
 //               \----/                           \----/
   STCURRENT = 0;        // next thread get full slice
   EnableInterrupts();
-  INTCTRL = 0x10000000; // trigger pendSV to start next thread
+  INTCTRL = 0x10000000; // trigger PendSV to start next thread
   for(;;){};            // can not return
 }
 // ******** OS_Sleep ************
@@ -255,7 +326,12 @@ void OS_Kill(void){  // no local variables allowed
 void OS_Sleep(uint32_t sleepTime){
 // set sleep parameter in TCB
 // suspend, stops running
-	RunPt->Sleep = sleepTime;
+	DisableInterrupts();
+	if(sleepTime){
+		RunPt->Sleep = sleepTime;
+		removeready(RunPt);
+	}
+	EnableInterrupts();
 	OS_Suspend();
 }
 
@@ -280,6 +356,7 @@ void OS_Wait(int32_t *semaPt){
 	*semaPt = (*semaPt) - 1;
 	if(*semaPt < 0){
 		RunPt->BlockPt = semaPt;	//Point to semaphore which is blocked
+		removeready(RunPt);
 		EnableInterrupts();
 		OS_Suspend();	//Switch threads by generating a systick interrupt
 	}
@@ -300,10 +377,201 @@ void OS_Signal(int32_t *semaPt){
 		threadPt = RunPt->next;	//point to next thread
 		while((threadPt->BlockPt) != semaPt) {	threadPt = threadPt->next; }//search for a thread that is blocked on this semaphore
 		threadPt->BlockPt = 0;	//unblock 1st blocked thread found
+		if(threadPt->Sleep == 0){
+			addready(threadPt);
+		}
 	}
 	EnableInterrupts();
 }
 
+// *****priority inheritance mutex****************
+// A thread blocked on a mutex raises the owner to its own priority, and
+// the owner of that owner's mutex and so on, so a low priority thread
+// holding the sprites is not starved by medium priority threads while a
+// high priority thread waits. Waiters queue by priority through WaitNext.
+
+// ******** isready ************
+// Inputs:  pointer to a thread
+// Outputs: nonzero if the thread is in the ready lists
+int static isready(tcbType *thread){
+  return (thread->BlockPt == 0)&&(thread->Sleep == 0)&&(thread->WaitMutex == 0);
+}
+
+// ******** insertwaiter ************
+// Queue a thread on a mutex, highest priority first, FIFO within a priority
+// Called with interrupts disabled
+// Inputs:  pointer to a mutex, pointer to the thread
+// Outputs: none
+void static insertwaiter(MutexType *mutexPt, tcbType *thread){
+  tcbType *pt, *prevPt;
+  prevPt = 0;
+  pt = mutexPt->Head;
+  while((pt != 0)&&(pt->Priority <= thread->Priority)){
+    prevPt = pt;
+    pt = pt->WaitNext;
+  }
+  thread->WaitNext = pt;
+  if(prevPt == 0){
+    mutexPt->Head = thread;
+  } else{
+    prevPt->WaitNext = thread;
+  }
+}
+
+// ******** removewaiter ************
+// Unlink a thread from the queue of the mutex it waits on
+// Called with interrupts disabled
+// Inputs:  pointer to a mutex, pointer to a thread in its queue
+// Outputs: none
+void static removewaiter(MutexType *mutexPt, tcbType *thread){
+  tcbType *pt;
+  if(mutexPt->Head == thread){
+    mutexPt->Head = thread->WaitNext;
+  } else{
+    pt = mutexPt->Head;
+    while(pt->WaitNext != thread){
+      pt = pt->WaitNext;
+    }
+    pt->WaitNext = thread->WaitNext;
+  }
+}
+
+// ******** setpriority ************
+// Change the running priority of a thread. A thread waiting on a mutex
+// is requeued, and the owner of that mutex inherits the priority if it
+// is lower, continuing down the chain of owners.
+// Called with interrupts disabled
+// Inputs:  pointer to a thread, new priority
+// Outputs: none
+void static setpriority(tcbType *thread, uint32_t priority){
+  MutexType *mutexPt;
+  while(thread->Priority != priority){
+    if(isready(thread)){
+      removeready(thread);
+      thread->Priority = priority;
+      addready(thread);
+      return;
+    }
+    thread->Priority = priority;  // sleeping or blocked, used once it is ready
+    mutexPt = thread->WaitMutex;
+    if(mutexPt == 0){
+      return;
+    }
+    removewaiter(mutexPt, thread);
+    insertwaiter(mutexPt, thread);
+    thread = mutexPt->Owner;
+    if(thread->Priority <= priority){
+      return;  // owner already at least this urgent
+    }
+  }
+}
+
+// ******** inheritedpriority ************
+// Priority a thread should run at: its own, or that of the most urgent
+// thread waiting on any mutex it owns
+// Called with interrupts disabled
+// Inputs:  pointer to a thread
+// Outputs: priority, 0 highest
+uint32_t static inheritedpriority(tcbType *thread){
+  uint32_t priority;
+  MutexType *mutexPt;
+  priority = thread->BasePriority;
+  for(mutexPt = thread->Held; mutexPt != 0; mutexPt = mutexPt->HeldNext){
+    if((mutexPt->Head != 0)&&(mutexPt->Head->Priority < priority)){
+      priority = mutexPt->Head->Priority;
+    }
+  }
+  return priority;
+}
+
+// ******** OS_InitMutex ************
+// Initialize a priority inheritance mutex as free
+// Inputs:  pointer to a mutex
+// Outputs: none
+void OS_InitMutex(MutexType *mutexPt){
+  mutexPt->Owner = 0;
+  mutexPt->Head = 0;
+  mutexPt->HeldNext = 0;
+}
+
+// ******** OS_MutexLock ************
+// Take the mutex, blocking until it is free. While blocked, the owner
+// runs at least at the priority of this thread.
+// Inputs:  pointer to a mutex
+// Outputs: 1 when the mutex is taken
+//          0 if this thread already owns it (recursive lock, not counted)
+// Must not be called from an ISR
+int OS_MutexLock(MutexType *mutexPt){
+  DisableInterrupts();
+  if(mutexPt->Owner == RunPt){
+    EnableInterrupts();
+    return 0;  // would deadlock on itself
+  }
+  if(mutexPt->Owner == 0){
+    mutexPt->Owner = RunPt;
+    mutexPt->HeldNext = RunPt->Held;
+    RunPt->Held = mutexPt;
+  } else{
+    removeready(RunPt);
+    RunPt->WaitMutex = mutexPt;
+    insertwaiter(mutexPt, RunPt);
+    if(mutexPt->Owner->Priority > RunPt->Priority){
+      setpriority(mutexPt->Owner, RunPt->Priority);  // owner inherits
+    }
+    EnableInterrupts();
+    OS_Suspend();  // OS_MutexUnlock hands the mutex over
+  }
+  EnableInterrupts();
+  return 1;
+}
+
+// ******** release ************
+// Remove a mutex from those the running thread owns and give it to
+// the highest priority waiter, if any
+// Called with interrupts disabled
+// Inputs:  pointer to a mutex owned by RunPt
+// Outputs: none
+void static release(MutexType *mutexPt){
+  tcbType *threadPt;
+  MutexType **heldPt;
+  heldPt = &RunPt->Held;
+  while(*heldPt != mutexPt){
+    heldPt = &(*heldPt)->HeldNext;
+  }
+  *heldPt = mutexPt->HeldNext;  // remove from the mutexes this thread owns
+  threadPt = mutexPt->Head;
+  mutexPt->Owner = threadPt;
+  if(threadPt != 0){
+    mutexPt->Head = threadPt->WaitNext;
+    threadPt->WaitMutex = 0;
+    mutexPt->HeldNext = threadPt->Held;
+    threadPt->Held = mutexPt;
+    threadPt->Priority = inheritedpriority(threadPt); // it may inherit from the rest of the queue
+    addready(threadPt);
+  }
+}
+
+// ******** OS_MutexUnlock ************
+// Release the mutex to the highest priority waiter, if any, and drop
+// any priority inherited through it
+// Inputs:  pointer to a mutex
+// Outputs: 1 if released, 0 if this thread does not own it
+// Must not be called from an ISR
+int OS_MutexUnlock(MutexType *mutexPt){
+  DisableInterrupts();
+  if(mutexPt->Owner != RunPt){
+    EnableInterrupts();
+    return 0;
+  }
+  release(mutexPt);
+  setpriority(RunPt, inheritedpriority(RunPt));
+  if(__clz(ReadyBitmap) < RunPt->Priority){
+    OS_Suspend();  // a more urgent thread is ready, run it as soon as interrupts are enabled
+  }
+  EnableInterrupts();
+  return 1;
+}
+
 #define FSIZE 10    // can be any size
 uint32_t PutI;      // index of where to put next
 uint32_t GetI;      // index of where to get next
@@ -28,6 +28,16 @@
 #ifndef __OS_H
 #define __OS_H  1
 
+// mutex with an owner, for exclusive access to the sprites and the LCD
+// Waiters queue by priority and the owner inherits the priority of the
+// most urgent one, so medium priority threads can not starve it
+struct Mutex{
+  struct tcb *Owner;      // thread holding the mutex, 0 if free
+  struct tcb *Head;       // highest priority waiting thread, 0 if none
+  struct Mutex *HeldNext; // next mutex held by the same owner
+};
+typedef struct Mutex MutexType;
+
 
 // ******** OS_Init ************
 // Initialize operating system, disable interrupts
@@ -41,7 +51,7 @@ void OS_Init(void);
 //******** OS_AddThread *************** 
 // add a foregound thread to the scheduler
 // Inputs: pointer to a void/void foreground function
-//         priority (0 is highest)
+//         priority (0 is highest, 31 is lowest)
 // Outputs: Thread ID if successful, 0 if this thread can not be added
 // stack size must be divisable by 8 (aligned to double word boundary)
 int OS_AddThread(void(*task)(void), uint32_t priority);
@@ -103,6 +113,28 @@ void OS_Wait(int32_t *semaPt);
 // Outputs: none
 void OS_Signal(int32_t *semaPt);
 
+// ******** OS_InitMutex ************
+// Initialize a priority inheritance mutex as free
+// Inputs:  pointer to a mutex
+// Outputs: none
+void OS_InitMutex(MutexType *mutexPt);
+
+// ******** OS_MutexLock ************
+// Take the mutex, blocking until it is free. While blocked, the owner
+// runs at least at the priority of this thread.
+// Inputs:  pointer to a mutex
+// Outputs: 1 when the mutex is taken
+//          0 if this thread already owns it (recursive lock, not counted)
+// Must not be called from an ISR
+int OS_MutexLock(MutexType *mutexPt);
+
+// ******** OS_MutexUnlock ************
+// Release the mutex to the highest priority waiter, if any
+// Inputs:  pointer to a mutex
+// Outputs: 1 if released, 0 if this thread does not own it
+// Must not be called from an ISR
+int OS_MutexUnlock(MutexType *mutexPt);
+
 // ******** OS_FIFO_Init ************
 // Initialize FIFO.  The "put" and "get" indices initially
 // are equal, which means that the FIFO is empty.  Also
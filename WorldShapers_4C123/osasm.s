@@ -14,11 +14,10 @@
 
         EXTERN  RunPt            ; currently running thread
         EXPORT  StartOS
-        EXPORT  SysTick_Handler
         IMPORT  Scheduler
         EXPORT  PendSV_Handler
 
-SysTick_Handler                ; 1) Saves R0-R3,R12,LR,PC,PSR
+PendSV_Handler                 ; 1) Saves R0-R3,R12,LR,PC,PSR
     CPSID   I                  ; 2) Prevent interrupt during switch
 	PUSH {R4-R11}		;saves registers R4 to R11
 	LDR R0,=RunPt		;load address of RunPt to R0
@@ -48,13 +47,6 @@ StartOS
 	CPSIE   I              ; Enable interrupts at processor level
     BX      LR                 ; start first thread
 
-PendSV_Handler
-    LDR     R0, =RunPt         ; run this thread next
-    LDR     R2, [R0]           ; R2 = value of RunPt
-    LDR     SP, [R2]           ; new thread SP; SP = RunPt->stackPointer;
-    POP     {R4-R11}           ; restore regs r4-11
-    LDR     LR,=0xFFFFFFF9
-    BX      LR                 ; start next thread
 	
     ALIGN
     END
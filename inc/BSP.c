@@ -242,6 +242,96 @@ void static adcinit(void){
                                    // 10-15) sample sequencer initialization in more specific functions
 }
 
+// Split-phase conversions on sample sequencers 1 to 3,
+// used by the _Start and _End functions of the joystick,
+// accelerometer and microphone.  Bit n of AdcBusy is set
+// while sequencer n is converting.  With a task from
+// BSP_ADC_Notify(), the sequencer interrupt is armed for
+// the one conversion and disarmed by the handler, which
+// leaves the raw flag set for the _End function, so the
+// blocking _Input functions, which never arm it, still
+// spin on the same flag.  AdcBusy and ADC0_IM_R are shared
+// by all three sequencers, and ADC0_IM_R with their
+// handlers, so they are changed with interrupts disabled.
+uint32_t AdcBusy;
+void (*AdcTask)(uint32_t done);    // user function, 0 to poll
+void static adcstart(uint32_t ss){long sr;
+  sr = StartCritical();
+  if(AdcBusy&ss){
+    EndCritical(sr);
+    return;                        // already in progress
+  }
+  AdcBusy |= ss;
+  if(AdcTask){
+    ADC0_IM_R |= ss;               // interrupt when done
+  }
+  ADC0_PSSI_R = ss;                // initiate the sequencer
+  EndCritical(sr);
+}
+// 1 if the conversion started by adcstart() is done,
+// starting one if there is none
+int static adcready(uint32_t ss){
+  if((AdcBusy&ss) == 0){
+    adcstart(ss);
+    return 0;
+  }
+  return (ADC0_RIS_R&ss) != 0;
+}
+void static adcend(uint32_t ss){long sr;
+  ADC0_ISC_R = ss;                 // acknowledge completion
+  sr = StartCritical();
+  AdcBusy &= ~ss;
+  EndCritical(sr);
+}
+void static adcnotify(uint32_t ss){
+  ADC0_IM_R &= ~ss;                // disarm, the flag stays for _End
+  if(AdcTask){
+    (*AdcTask)(ss);                // execute user task
+  }
+}
+void ADC0Seq1_Handler(void){
+  adcnotify(BSP_ADC_JOYSTICK);
+}
+void ADC0Seq2_Handler(void){
+  adcnotify(BSP_ADC_ACCELEROMETER);
+}
+
+// ------------BSP_ADC_Notify------------
+// Run a user function in the ADC interrupt each time a
+// conversion started by BSP_Joystick_Start(),
+// BSP_Accelerometer_Start() or BSP_Microphone_Start()
+// is done, so a thread can block on a semaphore that
+// the function signals, then read the result with the
+// _End function, instead of spinning.  The function is
+// given which conversion is done, BSP_ADC_JOYSTICK,
+// BSP_ADC_ACCELEROMETER or BSP_ADC_MICROPHONE.  The
+// microphone shares its interrupt, and priority, with
+// BSP_Microphone_StartStream().
+// Input:  task is a pointer to a user function, or 0
+//           to go back to polling the _End functions
+//         priority is a number 0 to 6
+// Output: none
+void BSP_ADC_Notify(void(*task)(uint32_t done), uint8_t priority){long sr;
+  if(priority > 6){
+    priority = 6;
+  }
+  sr = StartCritical();
+  AdcTask = task;
+//PRIn Bit   Interrupt
+//Bits 31:29 Interrupt [4n+3]   n=3 => (4n+3)=15
+//Bits 7:5   Interrupt [4n]     n=4 => (4n)=16
+//Bits 15:13 Interrupt [4n+1]   n=4 => (4n+1)=17
+  NVIC_PRI3_R = (NVIC_PRI3_R&0x00FFFFFF)|(priority<<29);
+  NVIC_PRI4_R = (NVIC_PRI4_R&0xFFFF0000)|(priority<<13)|(priority<<5);
+  if(task){
+    NVIC_EN0_R = 0x00038000;       // enable IRQ 15, 16 and 17 in NVIC
+  } else{
+    ADC0_IM_R &= ~0x000E;          // no split-phase interrupts
+    NVIC_DIS0_R = 0x00018000;      // disable IRQ 15 and 16 in NVIC, 17 may be streaming
+  }
+  EndCritical(sr);
+}
+
 // ------------BSP_Joystick_Init------------
 // Initialize a GPIO pin for input, which corresponds
 // with BoosterPack pin J1.5 (Select button).
@@ -297,6 +387,41 @@ void BSP_Joystick_Input(uint16_t *x, uint16_t *y, uint8_t *select){
   ADC0_ISC_R = 0x0002;             // 4) acknowledge completion
 }
 
+// ------------BSP_Joystick_Start------------
+// Start a conversion of the joystick position.
+// If a conversion is currently in progress, return
+// immediately.
+// Input: none
+// Output: none
+// Assumes: BSP_Joystick_Init() has been called
+void BSP_Joystick_Start(void){
+  adcstart(BSP_ADC_JOYSTICK);
+}
+
+// ------------BSP_Joystick_End------------
+// Query the joystick for a conversion.  If no
+// conversion is currently in progress, start one and
+// return zero immediately.  If the conversion is not
+// yet complete, return zero immediately.  If the
+// conversion is complete, store the results in the
+// pointers provided and return one.
+// Input: x is pointer to store X-position (0 to 1023)
+//        y is pointer to store Y-position (0 to 1023)
+//        select is pointer to store Select status (0 if pressed)
+// Output: one if conversion is ready and pointers are valid
+//         zero if conversion is not ready and pointers unchanged
+// Assumes: BSP_Joystick_Init() has been called
+int BSP_Joystick_End(uint16_t *x, uint16_t *y, uint8_t *select){
+  if(adcready(BSP_ADC_JOYSTICK) == 0){
+    return 0;                      // conversion needs more time to complete
+  }
+  *x = ADC0_SSFIFO1_R>>2;          // read first result
+  *y = ADC0_SSFIFO1_R>>2;          // read second result
+  *select = SELECT;                // return 0(pressed) or 0x10(not pressed)
+  adcend(BSP_ADC_JOYSTICK);
+  return 1;                        // conversion is complete; pointers valid
+}
+
 // ------------BSP_RGB_Init------------
 // Initialize the GPIO and PWM or timer modules which
 // correspond with BoosterPack pins J4.39 (red),
@@ -570,6 +695,41 @@ void BSP_Accelerometer_Input(uint16_t *x, uint16_t *y, uint16_t *z){
   ADC0_ISC_R = 0x0004;             // 4) acknowledge completion
 }
 
+// ------------BSP_Accelerometer_Start------------
+// Start a conversion of the accelerometer.
+// If a conversion is currently in progress, return
+// immediately.
+// Input: none
+// Output: none
+// Assumes: BSP_Accelerometer_Init() has been called
+void BSP_Accelerometer_Start(void){
+  adcstart(BSP_ADC_ACCELEROMETER);
+}
+
+// ------------BSP_Accelerometer_End------------
+// Query the accelerometer for a conversion.  If no
+// conversion is currently in progress, start one and
+// return zero immediately.  If the conversion is not
+// yet complete, return zero immediately.  If the
+// conversion is complete, store the results in the
+// pointers provided and return one.
+// Input: x is pointer to store X-measurement (0 to 1023)
+//        y is pointer to store Y-measurement (0 to 1023)
+//        z is pointer to store Z-measurement (0 to 1023)
+// Output: one if conversion is ready and pointers are valid
+//         zero if conversion is not ready and pointers unchanged
+// Assumes: BSP_Accelerometer_Init() has been called
+int BSP_Accelerometer_End(uint16_t *x, uint16_t *y, uint16_t *z){
+  if(adcready(BSP_ADC_ACCELEROMETER) == 0){
+    return 0;                      // conversion needs more time to complete
+  }
+  *x = ADC0_SSFIFO2_R>>2;          // read first result
+  *y = ADC0_SSFIFO2_R>>2;          // read second result
+  *z = ADC0_SSFIFO2_R>>2;          // read third result
+  adcend(BSP_ADC_ACCELEROMETER);
+  return 1;                        // conversion is complete; pointers valid
+}
+
 // ------------BSP_Microphone_Init------------
 // Initialize one ADC pin, which corresponds with
 // BoosterPack pin J1.6.
@@ -609,6 +769,196 @@ void BSP_Microphone_Input(uint16_t *mic){
   ADC0_ISC_R = 0x0008;             // 4) acknowledge completion
 }
 
+// ------------BSP_Microphone_Start------------
+// Start a conversion of the microphone.
+// If a conversion is currently in progress, return
+// immediately.
+// Input: none
+// Output: none
+// Assumes: BSP_Microphone_Init() has been called
+void BSP_Microphone_Start(void){
+  adcstart(BSP_ADC_MICROPHONE);
+}
+
+// ------------BSP_Microphone_End------------
+// Query the microphone for a conversion.  If no
+// conversion is currently in progress, start one and
+// return zero immediately.  If the conversion is not
+// yet complete, return zero immediately.  If the
+// conversion is complete, store the result in the
+// pointer provided and return one.
+// Input: mic is pointer to store sound measurement (0 to 1023)
+// Output: one if conversion is ready and pointer is valid
+//         zero if conversion is not ready and pointer unchanged
+// Assumes: BSP_Microphone_Init() has been called
+int BSP_Microphone_End(uint16_t *mic){
+  if(adcready(BSP_ADC_MICROPHONE) == 0){
+    return 0;                      // conversion needs more time to complete
+  }
+  *mic = ADC0_SSFIFO3_R>>2;        // read result
+  adcend(BSP_ADC_MICROPHONE);
+  return 1;                        // conversion is complete; pointer valid
+}
+
+// ------------BSP_Microphone_StartStream------------
+// Sample the microphone continuously at a fixed rate
+// without the processor.  Timer2A triggers ADC0 sample
+// sequencer 3, and uDMA channel 17 moves each result
+// into one half of a ping-pong buffer while the user
+// task processes the other half.  The task runs in the
+// ADC0 sequencer 3 interrupt each time a half is full,
+// with a pointer to it, so it can signal a semaphore
+// or copy the block, and must finish before the next
+// half fills.  BSP_Microphone_Input() can not be used
+// while streaming.
+// Input:  task is a pointer to a user function, called
+//           with the block and its number of samples
+//           (each 0 to 1023, the same as
+//           BSP_Microphone_Input())
+//         buffer is 2*count 16-bit samples
+//         count is the number of samples per block,
+//           1 to 1024
+//         freq is the sample rate, 1 Hz to 125 kHz
+//         priority is a number 0 to 6
+// Output: none
+// Assumes: BSP_Microphone_Init() has been called
+// Streaming needs a 1024-byte aligned uDMA control table in
+// RAM, so it is only built with MICSTREAM 1 (for example
+// -DMICSTREAM=1 in the project), and other projects do not
+// lose up to 1 KB of RAM to its alignment.
+#ifndef MICSTREAM
+#define MICSTREAM 0
+#endif
+#if MICSTREAM
+void (*MicrophoneTask)(uint16_t *block, uint32_t count);   // user function
+uint16_t *MicrophoneBuffer;        // two blocks of MicrophoneCount
+uint32_t MicrophoneCount;
+uint32_t MicrophoneNext;           // 0 if the primary block fills next, 1 for the alternate
+uint32_t MicrophoneStreaming;      // 1 between StartStream and StopStream
+#define MICCH     17               // uDMA channel of ADC0 SS3
+// uDMA channel control table, primary structures then alternate
+// structures from word 128, 4 words per channel; it must be
+// 1024-byte aligned. Only channel 17 is used, so the table ends
+// with its alternate structure, 800 bytes, and the last 224 bytes
+// of the 1 KB are left to other variables.
+uint32_t static DMATable[128 + 4*(MICCH+1)] __attribute__((aligned(1024)));
+#define MICCTL    (UDMA_CHCTL_DSTINC_16|UDMA_CHCTL_DSTSIZE_16|UDMA_CHCTL_SRCINC_NONE|\
+                   UDMA_CHCTL_SRCSIZE_16|UDMA_CHCTL_ARBSIZE_1|UDMA_CHCTL_XFERMODE_PINGPONG)
+// Point the primary (0) or alternate (1) structure at its block
+void static micdmaset(uint32_t alt){
+  uint32_t *entry = &DMATable[128*alt + 4*MICCH];
+  entry[0] = (uint32_t)&ADC0_SSFIFO3_R;          // source end, never moves
+  entry[1] = (uint32_t)&MicrophoneBuffer[MicrophoneCount*(alt+1) - 1];// destination end
+  entry[2] = MICCTL|((MicrophoneCount - 1)<<UDMA_CHCTL_XFERSIZE_S);
+}
+void BSP_Microphone_StartStream(void(*task)(uint16_t *block, uint32_t count),
+  uint16_t *buffer, uint32_t count, uint32_t freq, uint8_t priority){long sr;
+  if((count == 0) || (count > 1024) || (freq == 0) || (freq > 125000)){
+    return;                        // invalid input
+  }
+  if(priority > 6){
+    priority = 6;
+  }
+  sr = StartCritical();
+  MicrophoneTask = task;           // user function
+  MicrophoneBuffer = buffer;
+  MicrophoneCount = count;
+  MicrophoneNext = 0;
+  MicrophoneStreaming = 1;
+  // ***************** uDMA channel 17 initialization *****************
+  SYSCTL_RCGCDMA_R |= 0x01;        // activate clock for uDMA
+  while((SYSCTL_PRDMA_R&0x01) == 0){};// allow time for clock to stabilize
+  UDMA_CFG_R = UDMA_CFG_MASTEN;    // enable uDMA controller
+  UDMA_CTLBASE_R = (uint32_t)DMATable;
+  UDMA_CHMAP2_R &= ~UDMA_CHMAP2_CH17SEL_M;// channel 17 is ADC0 SS3
+  UDMA_PRIOCLR_R = 1<<MICCH;       // default priority
+  UDMA_ALTCLR_R = 1<<MICCH;        // start with the primary block
+  UDMA_USEBURSTCLR_R = 1<<MICCH;   // respond to single requests
+  UDMA_REQMASKCLR_R = 1<<MICCH;    // allow requests from the ADC
+  micdmaset(0);
+  micdmaset(1);
+  UDMA_CHIS_R = 1<<MICCH;          // clear channel 17 done flag
+  UDMA_ENASET_R = 1<<MICCH;        // enable channel 17
+  // ***************** ADC0 SS3 initialization *****************
+  ADC0_ACTSS_R &= ~0x0008;         // disable sample sequencer 3
+  ADC0_EMUX_R = (ADC0_EMUX_R&~ADC_EMUX_EM3_M)|ADC_EMUX_EM3_TIMER;// seq3 is timer trigger
+  ADC0_SSCTL3_R = 0x0006;          // no D0 TS0, yes IE0 END0, which requests uDMA
+  ADC0_IM_R &= ~0x0008;            // no interrupt per sample, only per block from uDMA
+  ADC0_ISC_R = 0x0008;             // clear SS3 flag
+  ADC0_ACTSS_R |= 0x0008;          // enable sample sequencer 3
+//PRIn Bit   Interrupt
+//Bits 15:13 Interrupt [4n+1]   n=4 => (4n+1)=17
+  NVIC_PRI4_R = (NVIC_PRI4_R&0xFFFF00FF)|(priority<<13); // priority
+// vector number 33, interrupt number 17
+  NVIC_EN0_R = 1<<17;              // enable IRQ 17 in NVIC
+  // ***************** Timer2A initialization *****************
+  SYSCTL_RCGCTIMER_R |= 0x04;      // activate clock for Timer2
+  while((SYSCTL_PRTIMER_R&0x04) == 0){};// allow time for clock to stabilize
+  TIMER2_CTL_R &= ~TIMER_CTL_TAEN; // disable Timer2A during setup
+  TIMER2_CFG_R = TIMER_CFG_32_BIT_TIMER;// configure for 32-bit timer mode
+                                   // configure for periodic mode, default down-count settings
+  TIMER2_TAMR_R = TIMER_TAMR_TAMR_PERIOD;
+  TIMER2_TAILR_R = (ClockFrequency/freq - 1); // reload value
+  TIMER2_TAPR_R = 0;               // bus clock resolution
+  TIMER2_IMR_R = 0;                // no timer interrupts, it only triggers the ADC
+  TIMER2_CTL_R |= (TIMER_CTL_TAOTE|TIMER_CTL_TAEN);// enable Timer2A and its ADC trigger
+  EndCritical(sr);
+}
+
+// Each block that uDMA fills is converted to 10 bits, handed
+// to the user task, and its structure is set up again so the
+// block is refilled after the other one.  Both blocks may be
+// done if this interrupt was held off for a whole block.
+// When not streaming, this is the end of a conversion started
+// by BSP_Microphone_Start().
+void ADC0Seq3_Handler(void){
+  uint16_t *block;
+  uint32_t i;
+  if(MicrophoneStreaming == 0){
+    adcnotify(BSP_ADC_MICROPHONE);
+    return;
+  }
+  ADC0_ISC_R = 0x0008;             // acknowledge SS3 completion
+  UDMA_CHIS_R = 1<<MICCH;          // acknowledge channel 17 done
+  while((DMATable[128*MicrophoneNext + 4*MICCH + 2]&UDMA_CHCTL_XFERMODE_M) == UDMA_CHCTL_XFERMODE_STOP){
+    block = &MicrophoneBuffer[MicrophoneCount*MicrophoneNext];
+    for(i=0; i<MicrophoneCount; i=i+1){
+      block[i] = block[i]>>2;      // 12-bit result to 10 bits
+    }
+    (*MicrophoneTask)(block, MicrophoneCount);// execute user task
+    micdmaset(MicrophoneNext);     // refill after the other block
+    MicrophoneNext = MicrophoneNext^1;
+  }
+}
+
+// ------------BSP_Microphone_StopStream------------
+// Stop sampling the microphone with the timer and uDMA,
+// and return it to BSP_Microphone_Input().  The block
+// being filled is dropped.
+// Input: none
+// Output: none
+void BSP_Microphone_StopStream(void){
+  TIMER2_CTL_R &= ~(TIMER_CTL_TAOTE|TIMER_CTL_TAEN);// stop triggering the ADC
+  NVIC_DIS0_R = 1<<17;             // disable IRQ 17 in NVIC
+  UDMA_ENACLR_R = 1<<MICCH;        // disable channel 17
+  UDMA_CHIS_R = 1<<MICCH;          // clear channel 17 done flag
+  ADC0_ACTSS_R &= ~0x0008;         // disable sample sequencer 3
+  ADC0_EMUX_R &= ~ADC_EMUX_EM3_M;  // seq3 is software trigger
+  ADC0_ISC_R = 0x0008;             // clear SS3 flag
+  ADC0_ACTSS_R |= 0x0008;          // enable sample sequencer 3
+  NVIC_UNPEND0_R = 1<<17;          // drop a block that was done meanwhile
+  MicrophoneStreaming = 0;
+  if(AdcTask){
+    NVIC_EN0_R = 1<<17;            // BSP_ADC_Notify() still uses IRQ 17
+  }
+}
+#else
+// The end of a conversion started by BSP_Microphone_Start().
+void ADC0Seq3_Handler(void){
+  adcnotify(BSP_ADC_MICROPHONE);
+}
+#endif
+
 /* ********************** */
 /*      LCD Section       */
 /* ********************** */
@@ -2245,6 +2595,70 @@ void BSP_PeriodicTask_StopC(void){
   NVIC_DIS3_R = 1<<4;              // disable IRQ 100 in NVIC
 }
 
+// ------------BSP_OneShotTask_Init------------
+// Prepare an interrupt to run a user task once, after a
+// delay given to BSP_OneShotTask_Start().  Give it a
+// priority 0 to 6 with lower numbers signifying higher
+// priority.  The timer does not run until started.
+// Input:  task is a pointer to a user function
+//         priority is a number 0 to 6
+// Output: none
+void (*OneShotTask)(void);   // user function
+void BSP_OneShotTask_Init(void(*task)(void), uint8_t priority){long sr;
+  if(priority > 6){
+    priority = 6;
+  }
+  sr = StartCritical();
+  OneShotTask = task;              // user function
+  // ***************** Wide Timer2A initialization *****************
+  SYSCTL_RCGCWTIMER_R |= 0x04;     // activate clock for Wide Timer2
+  while((SYSCTL_PRWTIMER_R&0x04) == 0){};// allow time for clock to stabilize
+  WTIMER2_CTL_R &= ~TIMER_CTL_TAEN;// disable Wide Timer2A during setup
+  WTIMER2_CFG_R = TIMER_CFG_16_BIT;// configure for 32-bit timer mode
+                                   // configure for one-shot mode, default down-count settings
+  WTIMER2_TAMR_R = TIMER_TAMR_TAMR_1_SHOT;
+  WTIMER2_TAPR_R = 0;              // bus clock resolution
+  WTIMER2_ICR_R = TIMER_ICR_TATOCINT;// clear WTIMER2A timeout flag
+  WTIMER2_IMR_R |= TIMER_IMR_TATOIM;// arm timeout interrupt
+//PRIn Bit   Interrupt
+//Bits 31:29 Interrupt [4n+3]
+//Bits 23:21 Interrupt [4n+2], n=24 => (4n+2)=98
+//Bits 15:13 Interrupt [4n+1]
+//Bits 7:5   Interrupt [4n]
+  NVIC_PRI24_R = (NVIC_PRI24_R&0xFF00FFFF)|(priority<<21); // priority
+// vector number 114, interrupt number 98
+// 32 bits in each NVIC_ENx_R register, 98/32 = 3 remainder 2
+  NVIC_EN3_R = 1<<2;               // enable IRQ 98 in NVIC
+  EndCritical(sr);
+}
+
+void WideTimer2A_Handler(void){
+  WTIMER2_ICR_R = TIMER_ICR_TATOCINT;// acknowledge Wide Timer2A timeout
+  (*OneShotTask)();                // execute user task
+}
+
+// ------------BSP_OneShotTask_Start------------
+// Run the user task once after the given delay.  A delay
+// that has not expired yet is cancelled and replaced.
+// Input:  delay in microseconds, 1 to 53,000,000 (32 bits
+//         of bus clock cycles at 80 MHz)
+// Output: none
+void BSP_OneShotTask_Start(uint32_t us){
+  WTIMER2_CTL_R &= ~TIMER_CTL_TAEN;// stop the current delay
+  WTIMER2_TAILR_R = us*(ClockFrequency/1000000) - 1;
+  WTIMER2_ICR_R = TIMER_ICR_TATOCINT;// clear WTIMER2A timeout flag
+  WTIMER2_CTL_R |= TIMER_CTL_TAEN; // start counting, stops itself at timeout
+}
+
+// ------------BSP_OneShotTask_Stop------------
+// Cancel a delay started by BSP_OneShotTask_Start().
+// Input: none
+// Output: none
+void BSP_OneShotTask_Stop(void){
+  WTIMER2_CTL_R &= ~TIMER_CTL_TAEN;// stop the current delay
+  WTIMER2_ICR_R = TIMER_ICR_TATOCINT;// clear WTIMER2A timeout flag
+}
+
 // ------------BSP_Time_Init------------
 // Activate a 32-bit timer to count the number of
 // microseconds since the timer was initialized.
@@ -225,6 +225,30 @@ void BSP_Joystick_Init(void);
 // Assumes: BSP_Joystick_Init() has been called
 void BSP_Joystick_Input(uint16_t *x, uint16_t *y, uint8_t *select);
 
+// ------------BSP_Joystick_Start------------
+// Start a conversion of the joystick position.
+// If a conversion is currently in progress, return
+// immediately.
+// Input: none
+// Output: none
+// Assumes: BSP_Joystick_Init() has been called
+void BSP_Joystick_Start(void);
+
+// ------------BSP_Joystick_End------------
+// Query the joystick for a conversion.  If no
+// conversion is currently in progress, start one and
+// return zero immediately.  If the conversion is not
+// yet complete, return zero immediately.  If the
+// conversion is complete, store the results in the
+// pointers provided and return one.
+// Input: x is pointer to store X-position (0 to 1023)
+//        y is pointer to store Y-position (0 to 1023)
+//        select is pointer to store Select status (0 if pressed)
+// Output: one if conversion is ready and pointers are valid
+//         zero if conversion is not ready and pointers unchanged
+// Assumes: BSP_Joystick_Init() has been called
+int BSP_Joystick_End(uint16_t *x, uint16_t *y, uint8_t *select);
+
 // ------------BSP_RGB_Init------------
 // Initialize the GPIO and PWM or timer modules which
 // correspond with BoosterPack pins J4.39 (red),
@@ -324,6 +348,30 @@ void BSP_Accelerometer_Init(void);
 // Assumes: BSP_Accelerometer_Init() has been called
 void BSP_Accelerometer_Input(uint16_t *x, uint16_t *y, uint16_t *z);
 
+// ------------BSP_Accelerometer_Start------------
+// Start a conversion of the accelerometer.
+// If a conversion is currently in progress, return
+// immediately.
+// Input: none
+// Output: none
+// Assumes: BSP_Accelerometer_Init() has been called
+void BSP_Accelerometer_Start(void);
+
+// ------------BSP_Accelerometer_End------------
+// Query the accelerometer for a conversion.  If no
+// conversion is currently in progress, start one and
+// return zero immediately.  If the conversion is not
+// yet complete, return zero immediately.  If the
+// conversion is complete, store the results in the
+// pointers provided and return one.
+// Input: x is pointer to store X-measurement (0 to 1023)
+//        y is pointer to store Y-measurement (0 to 1023)
+//        z is pointer to store Z-measurement (0 to 1023)
+// Output: one if conversion is ready and pointers are valid
+//         zero if conversion is not ready and pointers unchanged
+// Assumes: BSP_Accelerometer_Init() has been called
+int BSP_Accelerometer_End(uint16_t *x, uint16_t *y, uint16_t *z);
+
 // ------------BSP_Microphone_Init------------
 // Initialize one ADC pin, which corresponds with
 // BoosterPack pin J1.6.
@@ -341,6 +389,76 @@ void BSP_Microphone_Init(void);
 // Assumes: BSP_Microphone_Init() has been called
 void BSP_Microphone_Input(uint16_t *mic);
 
+// ------------BSP_Microphone_Start------------
+// Start a conversion of the microphone.
+// If a conversion is currently in progress, return
+// immediately.
+// Input: none
+// Output: none
+// Assumes: BSP_Microphone_Init() has been called
+void BSP_Microphone_Start(void);
+
+// ------------BSP_Microphone_End------------
+// Query the microphone for a conversion.  If no
+// conversion is currently in progress, start one and
+// return zero immediately.  If the conversion is not
+// yet complete, return zero immediately.  If the
+// conversion is complete, store the result in the
+// pointer provided and return one.
+// Input: mic is pointer to store sound measurement (0 to 1023)
+// Output: one if conversion is ready and pointer is valid
+//         zero if conversion is not ready and pointer unchanged
+// Assumes: BSP_Microphone_Init() has been called
+int BSP_Microphone_End(uint16_t *mic);
+
+// ------------BSP_ADC_Notify------------
+// Run a user function in the ADC interrupt each time a
+// conversion started by BSP_Joystick_Start(),
+// BSP_Accelerometer_Start() or BSP_Microphone_Start()
+// is done, so a thread can block on a semaphore that
+// the function signals, then read the result with the
+// _End function, instead of spinning.  The function is
+// given which conversion is done.
+// Input:  task is a pointer to a user function, or 0
+//           to go back to polling the _End functions
+//         priority is a number 0 to 6
+// Output: none
+#define BSP_ADC_JOYSTICK      0x02 // sample sequencer 1
+#define BSP_ADC_ACCELEROMETER 0x04 // sample sequencer 2
+#define BSP_ADC_MICROPHONE    0x08 // sample sequencer 3
+void BSP_ADC_Notify(void(*task)(uint32_t done), uint8_t priority);
+
+// ------------BSP_Microphone_StartStream------------
+// Sample the microphone continuously at a fixed rate
+// without the processor.  Timer2A triggers the ADC,
+// and uDMA moves each result into one half of a
+// ping-pong buffer while the user task processes the
+// other half.  The task runs in the ADC interrupt each
+// time a half is full, and must finish before the
+// next half fills.  BSP_Microphone_Input() can not be
+// used while streaming.
+// Input:  task is a pointer to a user function, called
+//           with the block and its number of samples
+//           (each 0 to 1023)
+//         buffer is 2*count 16-bit samples
+//         count is the number of samples per block,
+//           1 to 1024
+//         freq is the sample rate, 1 Hz to 125 kHz
+//         priority is a number 0 to 6
+// Output: none
+// Assumes: BSP_Microphone_Init() has been called
+// Only in BSP.c built with MICSTREAM 1, as it takes 1 KB
+// of aligned RAM for the uDMA
+void BSP_Microphone_StartStream(void(*task)(uint16_t *block, uint32_t count),
+  uint16_t *buffer, uint32_t count, uint32_t freq, uint8_t priority);
+
+// ------------BSP_Microphone_StopStream------------
+// Stop sampling the microphone with the timer and uDMA,
+// and return it to BSP_Microphone_Input().
+// Input: none
+// Output: none
+void BSP_Microphone_StopStream(void);
+
 
 // ------------BSP_LCD_Init------------
 // Initialize the SPI and GPIO, which correspond with
@@ -680,6 +798,30 @@ void BSP_PeriodicTask_InitC(void(*task)(void), uint32_t freq, uint8_t priority);
 // Output: none
 void BSP_PeriodicTask_StopC(void);
 
+// ------------BSP_OneShotTask_Init------------
+// Prepare an interrupt to run a user task once, after a
+// delay given to BSP_OneShotTask_Start().  Give it a
+// priority 0 to 6 with lower numbers signifying higher
+// priority.  The timer does not run until started.
+// Input:  task is a pointer to a user function
+//         priority is a number 0 to 6
+// Output: none
+void BSP_OneShotTask_Init(void(*task)(void), uint8_t priority);
+
+// ------------BSP_OneShotTask_Start------------
+// Run the user task once after the given delay.  A delay
+// that has not expired yet is cancelled and replaced.
+// Input:  delay in microseconds, 1 to 53,000,000 (32 bits
+//         of bus clock cycles at 80 MHz)
+// Output: none
+void BSP_OneShotTask_Start(uint32_t us);
+
+// ------------BSP_OneShotTask_Stop------------
+// Cancel a delay started by BSP_OneShotTask_Start().
+// Input: none
+// Output: none
+void BSP_OneShotTask_Stop(void);
+
 // ------------BSP_Time_Init------------
 // Activate a 32-bit timer to count the number of
 // microseconds since the timer was initialized.
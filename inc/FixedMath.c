@@ -0,0 +1,279 @@
+// FixedMath.c
+// Runs on TM4C123
+// Integer and fixed-point math kernels shared by the labs.
+// The square root seeds Newton's method with a power of two from
+// CLZ, so the first step is a shift and the rest take 2 to 5
+// divides, where sqrt32 of the labs always took 16. RMS subtracts
+// the mean from two samples with SSUB16 and accumulates both squares
+// with SMLALD into 64 bits, so 1000 samples of 16 bits cannot
+// overflow the sum.
+
+#include <stdint.h>
+#include "FixedMath.h"
+
+#if defined(__ARMCC_VERSION)
+#if __ARMCC_VERSION >= 6000000
+#include <arm_acle.h>
+#endif
+#define clz(x)              __clz(x)
+#define ssub16(x, y)        __ssub16(x, y)
+#define smlald(x, y, sum)   __smlald(x, y, sum)
+#define ssat16(x)           __ssat(x, 16)
+#define usat12(x)           __usat(x, 12)
+#define qadd(x, y)          __qadd(x, y)
+#else
+// C versions of the Cortex M4 instructions, as on the Linux host
+uint32_t static clz(uint32_t x){
+  return __builtin_clz(x);
+}
+// two 16-bit subtracts, each wrapping in its half
+uint32_t static ssub16(uint32_t x, uint32_t y){
+  return (((x>>16) - (y>>16))<<16)|((x - y)&0xFFFF);
+}
+// sum plus the products of the low and of the high signed halves
+int64_t static smlald(uint32_t x, uint32_t y, int64_t sum){
+  return sum + (int32_t)(int16_t)x*(int16_t)y + (int32_t)(int16_t)(x>>16)*(int16_t)(y>>16);
+}
+int32_t static ssat16(int32_t x){
+  return (x > 32767) ? 32767 : (x < -32768) ? -32768 : x;
+}
+uint32_t static usat12(int32_t x){
+  return (x > 4095) ? 4095 : (x < 0) ? 0 : x;
+}
+int32_t static qadd(int32_t x, int32_t y){
+  int64_t sum = (int64_t)x + y;
+  return (sum > INT32_MAX) ? INT32_MAX : (sum < INT32_MIN) ? INT32_MIN : (int32_t)sum;
+}
+#endif
+
+//********FixedMath_Sqrt*************
+// Integer square root
+// Inputs:  s    0 to 2^32-1
+// Outputs: sqrt(s), rounded down
+uint32_t FixedMath_Sqrt(uint32_t s){
+  uint32_t k, t, u;
+  if(s == 0){
+    return 0;
+  }
+  k = (33 - clz(s))/2;        // s has 2k-1 or 2k bits
+  t = 1<<k;                   // at or above sqrt(s)
+  u = (t + (s>>k))/2;         // first Newton step, s/t is a shift
+  while(u < t){               // from above Newton comes down to sqrt(s)
+    t = u;
+    u = (t + s/t)/2;
+  }
+  return t;
+}
+
+//********FixedMath_Reciprocal*************
+// Reciprocal for FixedMath_Divide, 2^32/d rounded up
+// Inputs:  d    divisor, 2 to 2^31
+// Outputs: reciprocal of d
+uint32_t FixedMath_Reciprocal(uint32_t d){
+  return 0xFFFFFFFF/d + 1;
+}
+
+//********FixedMath_RMS*************
+// Root mean square of a block of samples about a mean,
+// sqrt(sum((x[i] - mean)^2)/n), two samples per SMLALD
+// Inputs:  x     samples, any 16-bit alignment
+//          n     number of samples, 1 or more
+//          mean  subtracted from each sample, x[i] - mean must
+//                fit in 16 bits
+// Outputs: RMS, rounded down
+uint32_t FixedMath_RMS(const int16_t *x, uint32_t n, int32_t mean){
+  const uint32_t *pair;
+  uint32_t means = (mean&0xFFFF)|(mean<<16);
+  uint32_t d, i = n;
+  int32_t e;
+  int64_t sum = 0;
+  if(((uintptr_t)x)&2){       // one sample to reach a word boundary
+    e = *x - mean;
+    sum = e*e;
+    x++;
+    i--;
+  }
+  pair = (const uint32_t *)x;
+  for(; i>=2; i=i-2){
+    d = ssub16(*pair, means);
+    sum = smlald(d, d, sum);
+    pair++;
+  }
+  if(i){                      // odd sample left over
+    e = *(const int16_t *)pair - mean;
+    sum = sum + e*e;
+  }
+  return FixedMath_Sqrt((uint32_t)(sum/n));
+}
+
+// Clear the running sums for the next window
+void static restart(struct rmswindow *w){
+  w->count = 0;
+  w->sum = 0;
+  w->squares = 0;
+  w->min = 0xFFFFFFFF;
+  w->max = 0;
+}
+
+// Publish the results of a full window,
+// rms^2 = squares/n - (sum/n)^2 = (n*squares - sum^2)/n^2
+void static publish(struct rmswindow *w){
+  uint64_t n = w->count;
+  w->mean = w->sum/w->count;
+  w->rms = FixedMath_Sqrt((uint32_t)((n*w->squares - (uint64_t)w->sum*w->sum)/(n*n)));
+  w->peak = w->max - w->min;
+  restart(w);
+}
+
+// Add one sample to the running sums, but not to the count
+void static add(struct rmswindow *w, uint32_t x){
+  w->sum = w->sum + x;
+  w->squares = w->squares + x*x;
+  if(x < w->min){
+    w->min = x;
+  }
+  if(x > w->max){
+    w->max = x;
+  }
+}
+
+//********FixedMath_RMSInit*************
+// Start a streaming RMS, with all results 0 until the first window
+// Inputs:  w       streaming RMS to initialize
+//          window  samples per result, 1 to 65535
+// Outputs: none
+void FixedMath_RMSInit(struct rmswindow *w, uint32_t window){
+  w->window = window;
+  w->mean = 0;
+  w->rms = 0;
+  w->peak = 0;
+  restart(w);
+}
+
+//********FixedMath_RMSAdd*************
+// Add one sample to a streaming RMS, about 8 cycles
+// Inputs:  w    streaming RMS
+//          x    sample, 0 to 32767
+// Outputs: 1 if this sample ended a window and mean, rms and peak
+//          are new, 0 if not
+int FixedMath_RMSAdd(struct rmswindow *w, uint32_t x){
+  add(w, x);
+  w->count++;
+  if(w->count < w->window){
+    return 0;
+  }
+  publish(w);
+  return 1;
+}
+
+//********FixedMath_RMSAddBlock*************
+// Add a block of samples to a streaming RMS, two samples per
+// SMLALD for the sum and the sum of squares, about 5 cycles a sample
+// Inputs:  w    streaming RMS
+//          x    samples, 0 to 32767, any 16-bit alignment
+//          n    number of samples
+// Outputs: number of windows the block ended, mean, rms and peak
+//          are those of the last one
+uint32_t FixedMath_RMSAddBlock(struct rmswindow *w, const uint16_t *x, uint32_t n){
+  const uint32_t *pair;
+  uint32_t m, i, lo, hi, windows = 0;
+  int64_t sum, squares;
+  while(n){
+    m = w->window - w->count;   // samples to the end of this window
+    if(m > n){
+      m = n;
+    }
+    n = n - m;
+    w->count = w->count + m;
+    if((((uintptr_t)x)&2)&&m){  // one sample to reach a word boundary
+      add(w, *x);
+      x++;
+      m--;
+    }
+    sum = 0;
+    squares = 0;
+    pair = (const uint32_t *)x;
+    for(i=m/2; i; i--){
+      sum = smlald(*pair, 0x00010001, sum);
+      squares = smlald(*pair, *pair, squares);
+      lo = *pair&0xFFFF;
+      hi = *pair>>16;
+      if(lo < w->min){
+        w->min = lo;
+      }
+      if(hi < w->min){
+        w->min = hi;
+      }
+      if(lo > w->max){
+        w->max = lo;
+      }
+      if(hi > w->max){
+        w->max = hi;
+      }
+      pair++;
+    }
+    x = (const uint16_t *)pair;
+    w->sum = w->sum + (uint32_t)sum;
+    w->squares = w->squares + squares;
+    if(m&1){                    // odd sample left over
+      add(w, *x);
+      x++;
+    }
+    if(w->count == w->window){
+      publish(w);
+      windows++;
+    }
+  }
+  return windows;
+}
+
+//********FixedMath_Q15Add*************
+// Saturating add of Q15 numbers
+// Inputs:  a, b  -1 to 1-2^-15 in Q15
+// Outputs: a + b, limited to -32768 to 32767
+int16_t FixedMath_Q15Add(int16_t a, int16_t b){
+  return ssat16(a + b);
+}
+
+//********FixedMath_Q15Mul*************
+// Saturating multiply of Q15 numbers, rounded toward minus infinity
+// Inputs:  a, b  -1 to 1-2^-15 in Q15
+// Outputs: a*b, -1*-1 gives 32767
+int16_t FixedMath_Q15Mul(int16_t a, int16_t b){
+  return ssat16((a*b)>>15);
+}
+
+//********FixedMath_Q15Sat*************
+// Saturate a Q15 result that may have overflowed
+// Inputs:  x    any 32-bit value
+// Outputs: x limited to -32768 to 32767
+int16_t FixedMath_Q15Sat(int32_t x){
+  return ssat16(x);
+}
+
+//********FixedMath_Q31Add*************
+// Saturating add of Q31 numbers
+// Inputs:  a, b  -1 to 1-2^-31 in Q31
+// Outputs: a + b, limited to -2^31 to 2^31-1
+int32_t FixedMath_Q31Add(int32_t a, int32_t b){
+  return qadd(a, b);
+}
+
+//********FixedMath_Q31Mul*************
+// Saturating multiply of Q31 numbers, rounded toward minus infinity
+// Inputs:  a, b  -1 to 1-2^-31 in Q31
+// Outputs: a*b, -1*-1 gives 2^31-1
+int32_t FixedMath_Q31Mul(int32_t a, int32_t b){
+  int64_t p = (int64_t)a*b;   // SMULL, Q62
+  int32_t high = p>>32;
+  // doubling the high word saturates only for -1*-1, whose low word is 0
+  return qadd(high, high)|(int32_t)((uint32_t)p>>31);
+}
+
+//********FixedMath_USat12*************
+// Limit a value to the 12 bits of the ADC and of a 12-bit DAC
+// Inputs:  x    any 32-bit value
+// Outputs: x limited to 0 to 4095
+uint32_t FixedMath_USat12(int32_t x){
+  return usat12(x);
+}
@@ -0,0 +1,138 @@
+// FixedMath.h
+// Runs on TM4C123
+// Integer and fixed-point math kernels shared by the labs: square
+// root, division by a reciprocal, exponential weighted moving
+// average, RMS of a block of samples, and saturating Q15/Q31 math.
+// On the Cortex M4 they use CLZ, UMULL, SMLALD, SSAT, USAT and
+// QADD; other compilers, as on the Linux host, get C versions with
+// the same results.
+//
+// Cycles per call on the TM4C123 at 0 wait states, counted from the
+// instructions, not measured:
+//   FixedMath_Sqrt        about 15 + 12 per divide, 0 to 5 divides,
+//                         2.1 on average (sqrt32 of the labs: 16
+//                         steps of about 16)
+//   FixedMath_Divide      2, one UMULL (UDIV takes 2 to 12)
+//   FixedMath_EWMA        3
+//   FixedMath_RMS         about 3 per sample, plus one 64-bit divide
+//                         and one FixedMath_Sqrt
+//   FixedMath_RMSAdd      about 8, plus the end of window
+//   FixedMath_RMSAddBlock about 5 per sample, plus the end of window
+//   Q15/Q31 functions     1 to 3, plus the call
+
+#include <stdint.h>
+
+//********FixedMath_Divide*************
+// Divide by a reciprocal from FixedMath_Reciprocal, to take the
+// divide out of loops that divide by the same number over and over
+// Inputs:  n    dividend
+//          r    FixedMath_Reciprocal(d)
+// Outputs: n/d, rounded down, exact when n*d < 2^32
+#define FixedMath_Divide(n, r) ((uint32_t)(((uint64_t)(n)*(r))>>32))
+
+//********FixedMath_EWMA*************
+// Exponential weighted moving average step,
+// avg + alpha*(x - avg)/1024
+// Inputs:  avg    average so far, less than 2^21
+//          x      new value, less than 2^21
+//          alpha  weight of the new value, 0 to 1024, in 1/1024
+// Outputs: new average
+#define FixedMath_EWMA(avg, x, alpha) (((1024 - (alpha))*(avg) + (alpha)*(x))>>10)
+
+//********FixedMath_Sqrt*************
+// Integer square root
+// Inputs:  s    0 to 2^32-1
+// Outputs: sqrt(s), rounded down
+uint32_t FixedMath_Sqrt(uint32_t s);
+
+//********FixedMath_Reciprocal*************
+// Reciprocal for FixedMath_Divide, 2^32/d rounded up
+// Inputs:  d    divisor, 2 to 2^31
+// Outputs: reciprocal of d
+uint32_t FixedMath_Reciprocal(uint32_t d);
+
+//********FixedMath_RMS*************
+// Root mean square of a block of samples about a mean,
+// sqrt(sum((x[i] - mean)^2)/n), two samples per SMLALD
+// Inputs:  x     samples, any 16-bit alignment
+//          n     number of samples, 1 or more
+//          mean  subtracted from each sample, x[i] - mean must
+//                fit in 16 bits
+// Outputs: RMS, rounded down
+uint32_t FixedMath_RMS(const int16_t *x, uint32_t n, int32_t mean);
+
+// Streaming RMS and level of a signal over windows of samples. Only
+// running sums are kept, so no samples are stored and the end of a
+// window costs one 64-bit divide and one FixedMath_Sqrt.
+struct rmswindow{
+  uint32_t window;            // samples per result, 1 to 65535
+  uint32_t count;             // samples so far in this window
+  uint32_t sum;               // of the samples so far
+  uint64_t squares;           // of the squares of the samples so far
+  uint32_t min, max;          // of the samples so far
+  // results of the last full window
+  uint32_t mean;              // rounded down
+  uint32_t rms;               // about the mean, rounded down
+  uint32_t peak;              // max - min
+};
+
+//********FixedMath_RMSInit*************
+// Start a streaming RMS, with all results 0 until the first window
+// Inputs:  w       streaming RMS to initialize
+//          window  samples per result, 1 to 65535
+// Outputs: none
+void FixedMath_RMSInit(struct rmswindow *w, uint32_t window);
+
+//********FixedMath_RMSAdd*************
+// Add one sample to a streaming RMS, about 8 cycles
+// Inputs:  w    streaming RMS
+//          x    sample, 0 to 32767
+// Outputs: 1 if this sample ended a window and mean, rms and peak
+//          are new, 0 if not
+int FixedMath_RMSAdd(struct rmswindow *w, uint32_t x);
+
+//********FixedMath_RMSAddBlock*************
+// Add a block of samples to a streaming RMS, two samples per
+// SMLALD for the sum and the sum of squares, about 5 cycles a sample
+// Inputs:  w    streaming RMS
+//          x    samples, 0 to 32767, any 16-bit alignment
+//          n    number of samples
+// Outputs: number of windows the block ended, mean, rms and peak
+//          are those of the last one
+uint32_t FixedMath_RMSAddBlock(struct rmswindow *w, const uint16_t *x, uint32_t n);
+
+//********FixedMath_Q15Add*************
+// Saturating add of Q15 numbers
+// Inputs:  a, b  -1 to 1-2^-15 in Q15
+// Outputs: a + b, limited to -32768 to 32767
+int16_t FixedMath_Q15Add(int16_t a, int16_t b);
+
+//********FixedMath_Q15Mul*************
+// Saturating multiply of Q15 numbers, rounded toward minus infinity
+// Inputs:  a, b  -1 to 1-2^-15 in Q15
+// Outputs: a*b, -1*-1 gives 32767
+int16_t FixedMath_Q15Mul(int16_t a, int16_t b);
+
+//********FixedMath_Q15Sat*************
+// Saturate a Q15 result that may have overflowed
+// Inputs:  x    any 32-bit value
+// Outputs: x limited to -32768 to 32767
+int16_t FixedMath_Q15Sat(int32_t x);
+
+//********FixedMath_Q31Add*************
+// Saturating add of Q31 numbers
+// Inputs:  a, b  -1 to 1-2^-31 in Q31
+// Outputs: a + b, limited to -2^31 to 2^31-1
+int32_t FixedMath_Q31Add(int32_t a, int32_t b);
+
+//********FixedMath_Q31Mul*************
+// Saturating multiply of Q31 numbers, rounded toward minus infinity
+// Inputs:  a, b  -1 to 1-2^-31 in Q31
+// Outputs: a*b, -1*-1 gives 2^31-1
+int32_t FixedMath_Q31Mul(int32_t a, int32_t b);
+
+//********FixedMath_USat12*************
+// Limit a value to the 12 bits of the ADC and of a 12-bit DAC
+// Inputs:  x    any 32-bit value
+// Outputs: x limited to 0 to 4095
+uint32_t FixedMath_USat12(int32_t x);
@@ -0,0 +1,126 @@
+// StepCount.c
+// Runs on TM4C123
+// Step counter of the fitness labs, fed one magnitude at a time or
+// in batches. It is the four-state algorithm that was in Task2 of
+// the labs, except that
+//  - the local min starts over at 0xFFFFFFFF, not 1024. Magnitudes go
+//    up to sqrt(3)*1023 = 1771, so from 1024 any min above it was
+//    never found and the counter moved on after localCountTarget
+//    magnitudes without one.
+//  - the average weighs the old average by (1024 - alpha)/1024, with
+//    FixedMath_EWMA, instead of (1023 - alpha)/1024. The labs lost
+//    1/1024 of the average at every magnitude, which at 10 Hz kept it
+//    about 1% low, and at 100 Hz so low that almost no steps were
+//    counted.
+
+#include <stdint.h>
+#include "FixedMath.h"
+#include "StepCount.h"
+
+//********StepCount_Init*************
+// Start a step counter at 0 steps. The first magnitude added starts
+// the average.
+// Inputs:  c                 step counter to initialize
+//          alpha             weight of a new magnitude in the average,
+//                            0 to 1023, in 1/1024
+//          localCountTarget  magnitudes needed to confirm a local min
+//                            or max
+//          avgOvershoot      how far above or below the average a
+//                            magnitude must be to cross it
+// Outputs: none
+void StepCount_Init(struct stepcounter *c, uint32_t alpha, uint32_t localCountTarget, uint32_t avgOvershoot){
+  c->alpha = alpha;
+  c->localCountTarget = localCountTarget;
+  c->avgOvershoot = avgOvershoot;
+  c->state = LookingForMax;
+  c->ewma = 0;
+  c->localMin = 0xFFFFFFFF;
+  c->localMax = 0;
+  c->localCount = 0;
+  c->steps = 0;
+  c->samples = 0;
+}
+
+//********StepCount_Add*************
+// Add one magnitude of the acceleration
+// Inputs:  c            step counter
+//          magnitude    sqrt(x^2 + y^2 + z^2), 0 to 65535
+// Outputs: 1 if the magnitude completes a step, 0 if not
+int StepCount_Add(struct stepcounter *c, uint32_t magnitude){
+  if(c->samples == 0){
+    c->ewma = magnitude;      // this is a guess; there are many options
+  }
+  c->samples++;
+  c->ewma = FixedMath_EWMA(c->ewma, magnitude, c->alpha);
+  if(c->state == LookingForMax){
+    if(magnitude > c->localMax){
+      c->localMax = magnitude;
+      c->localCount = 0;
+    } else{
+      c->localCount = c->localCount + 1;
+      if(c->localCount >= c->localCountTarget){
+        c->state = LookingForCross1;
+      }
+    }
+  } else if(c->state == LookingForCross1){
+    if(magnitude > c->localMax){
+      // somehow measured a very large magnitude
+      c->localMax = magnitude;
+      c->localCount = 0;
+      c->state = LookingForMax;
+    } else if(magnitude < (c->ewma - c->avgOvershoot)){
+      // step detected
+      c->steps = c->steps + 1;
+      c->localMin = 0xFFFFFFFF;
+      c->localCount = 0;
+      c->state = LookingForMin;
+      return 1;
+    }
+  } else if(c->state == LookingForMin){
+    if(magnitude < c->localMin){
+      c->localMin = magnitude;
+      c->localCount = 0;
+    } else{
+      c->localCount = c->localCount + 1;
+      if(c->localCount >= c->localCountTarget){
+        c->state = LookingForCross2;
+      }
+    }
+  } else if(c->state == LookingForCross2){
+    if(magnitude < c->localMin){
+      // somehow measured a very small magnitude
+      c->localMin = magnitude;
+      c->localCount = 0;
+      c->state = LookingForMin;
+    } else if(magnitude > (c->ewma + c->avgOvershoot)){
+      // step detected
+      c->steps = c->steps + 1;
+      c->localMax = 0;
+      c->localCount = 0;
+      c->state = LookingForMax;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+//********StepCount_AddBlock*************
+// Add a batch of magnitudes of the acceleration
+// Inputs:  c            step counter
+//          magnitude    n magnitudes, in the order measured
+//          n            number of magnitudes
+//          events       if not 0, the index in magnitude of each
+//                       step is written here, room for n
+// Outputs: number of steps in the batch
+uint32_t StepCount_AddBlock(struct stepcounter *c, const uint16_t *magnitude, uint32_t n, uint16_t *events){
+  uint32_t i, steps = 0;
+  for(i=0; i<n; i++){
+    if(StepCount_Add(c, magnitude[i])){
+      if(events){
+        events[steps] = i;
+      }
+      steps++;
+    }
+  }
+  return steps;
+}
@@ -0,0 +1,71 @@
+// StepCount.h
+// Runs on TM4C123
+// Step counter of the fitness labs, taken out of the tasks that
+// plot the data so it can run at any accelerometer rate and be
+// replayed on the host (Host_Linux/tools/steps.c).
+// The magnitude of the acceleration is smoothed by an exponential
+// weighted moving average. A step is counted each time the
+// magnitude, after a local maximum, falls AVGOVERSHOOT below the
+// average, and each time, after a local minimum, it rises
+// AVGOVERSHOOT above it, so one stride of the walk is two steps.
+// A local maximum or minimum holds once LOCALCOUNTTARGET magnitudes
+// in a row have not gone past it.
+// The algorithm is based on a forum post from
+// http://stackoverflow.com/questions/16392142/android-accelerometer-profiling/16539643#16539643
+
+#include <stdint.h>
+
+enum stepstate{               // the step counter cycles through four states
+  LookingForMax,              // looking for a local maximum in current magnitude
+  LookingForCross1,           // looking for current magnitude to cross average magnitude, minus a constant
+  LookingForMin,              // looking for a local minimum in current magnitude
+  LookingForCross2            // looking for current magnitude to cross average magnitude, plus a constant
+};
+
+struct stepcounter{
+  // tuning, set by StepCount_Init
+  uint32_t alpha;             // weight of a new magnitude in the average, 0 to 1023, in 1/1024
+  uint32_t localCountTarget;  // magnitudes that confirm a local min or max
+  uint32_t avgOvershoot;      // distance past the average that is a crossing
+  // state
+  enum stepstate state;
+  uint32_t ewma;              // average magnitude
+  uint32_t localMin;          // smallest magnitude since odd-numbered step detected
+  uint32_t localMax;          // largest magnitude since even-numbered step detected
+  uint32_t localCount;        // magnitudes above local min or below local max
+  uint32_t steps;             // steps counted since StepCount_Init
+  uint32_t samples;           // magnitudes added since StepCount_Init
+};
+
+//********StepCount_Init*************
+// Start a step counter at 0 steps. The first magnitude added starts
+// the average.
+// Inputs:  c                 step counter to initialize
+//          alpha             weight of a new magnitude in the average,
+//                            0 to 1023, in 1/1024, higher discounts
+//                            older magnitudes faster (labs: 128)
+//          localCountTarget  magnitudes needed to confirm a local min
+//                            or max, increase for longer strides or
+//                            faster sampling (labs: 5 at 10 Hz)
+//          avgOvershoot      how far above or below the average a
+//                            magnitude must be to cross it, increase
+//                            to reject harder shaking (labs: 25)
+// Outputs: none
+void StepCount_Init(struct stepcounter *c, uint32_t alpha, uint32_t localCountTarget, uint32_t avgOvershoot);
+
+//********StepCount_Add*************
+// Add one magnitude of the acceleration
+// Inputs:  c            step counter
+//          magnitude    sqrt(x^2 + y^2 + z^2), 0 to 65535
+// Outputs: 1 if the magnitude completes a step, 0 if not
+int StepCount_Add(struct stepcounter *c, uint32_t magnitude);
+
+//********StepCount_AddBlock*************
+// Add a batch of magnitudes of the acceleration
+// Inputs:  c            step counter
+//          magnitude    n magnitudes, in the order measured
+//          n            number of magnitudes
+//          events       if not 0, the index in magnitude of each
+//                       step is written here, room for n
+// Outputs: number of steps in the batch
+uint32_t StepCount_AddBlock(struct stepcounter *c, const uint16_t *magnitude, uint32_t n, uint16_t *events);